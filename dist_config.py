@@ -1,7 +1,7 @@
 import os
 
 package = 'libt3widget'
-excludesrc = '/(Makefile|TODO.*|SciTE.*|run\.sh|test\.c)$'
+excludesrc = '/(Makefile|TODO.*|SciTE.*|run\.sh|test\.c|bench/.*)$'
 auxsources= [ 'src/widget_api.h' ]
 extrabuilddirs = [ 'doc' ]
 auxfiles = [ 'doc/doxygen.conf', 'doc/DoxygenLayout.xml', 'doc/main_doc.h' ]
@@ -23,7 +23,7 @@ def get_replacements(mkdist):
 		},
 		{
 			'tag': '<OBJECTS>',
-			'replacement': " ".join(mkdist.sources_to_objects(mkdist.exclude_by_regex(mkdist.sources, '^src/x11.cc'), '\.cc$', '.lo')),
+			'replacement': " ".join(mkdist.sources_to_objects(mkdist.exclude_by_regex(mkdist.sources, '^src/(x11\.cc|bench/)'), '\.cc$', '.lo')),
 			'files': [ 'Makefile.in' ]
 		},
 		{
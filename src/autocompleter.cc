@@ -13,8 +13,528 @@
 */
 #include "t3widget/autocompleter.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "t3widget/contentlist.h"
+#include "t3widget/internal.h"
+#include "t3widget/key.h"
+#include "t3widget/main.h"
+#include "t3widget/signals.h"
+#include "t3widget/string_view.h"
+#include "t3widget/textbuffer.h"
+#include "t3widget/textline.h"
+#include "t3widget/util.h"
+
 namespace t3widget {
 
 autocompleter_t::~autocompleter_t() {}
 
+//===================================== text_snapshot_t ============================================
+
+struct text_snapshot_t::implementation_t {
+  text_pos_t size;
+  text_pos_t first_line;
+  std::vector<std::string> lines;
+  text_coordinate_t cursor;
+};
+
+text_snapshot_t::text_snapshot_t(const text_buffer_t *text, text_pos_t context_lines)
+    : impl(new implementation_t) {
+  impl->size = text->size();
+  impl->cursor = text->get_cursor();
+  impl->first_line = std::max<text_pos_t>(0, impl->cursor.line - context_lines);
+  text_pos_t end_line = std::min(impl->size, impl->cursor.line + context_lines + 1);
+  impl->lines.reserve(end_line - impl->first_line);
+  for (text_pos_t i = impl->first_line; i < end_line; ++i) {
+    impl->lines.push_back(text->get_line_data(i).get_data());
+  }
+}
+
+text_snapshot_t::~text_snapshot_t() {}
+
+text_pos_t text_snapshot_t::size() const { return impl->size; }
+
+text_pos_t text_snapshot_t::get_first_line() const { return impl->first_line; }
+
+text_pos_t text_snapshot_t::get_end_line() const { return impl->first_line + impl->lines.size(); }
+
+const std::string &text_snapshot_t::get_line_data(text_pos_t line) const {
+  return impl->lines[line - impl->first_line];
+}
+
+text_coordinate_t text_snapshot_t::get_cursor() const { return impl->cursor; }
+
+//===================================== async_autocompleter_t ======================================
+
+/** State of a request of an async_autocompleter_t, shared between the thread computing the
+    completions and the async_autocompleter_t. */
+struct T3_WIDGET_LOCAL autocomplete_request_t {
+  std::mutex lock;
+  /** The computed completions. Protected by #lock. */
+  autocomplete_result_t result;
+  /** Whether #result is available. Protected by #lock. */
+  bool finished = false;
+  std::atomic<bool> cancelled{false};
+};
+
+/** Compute the completions for @p request in the background. */
+static void autocomplete_thread(async_autocompleter_t::job_t job,
+                                std::shared_ptr<autocomplete_request_t> request) {
+  autocomplete_result_t result = job(request->cancelled);
+  {
+    std::lock_guard<std::mutex> guard(request->lock);
+    if (request->cancelled) {
+      return;
+    }
+    request->result = std::move(result);
+    request->finished = true;
+  }
+  // Have the main loop call async_autocompleter_t::implementation_t::deliver.
+  signal_update();
+}
+
+struct async_autocompleter_t::implementation_t {
+  /** The request being computed in the background, if any. */
+  std::shared_ptr<autocomplete_request_t> request;
+  callback_t callback;
+  /** The text buffer and cursor position of #request. */
+  const text_buffer_t *text = nullptr;
+  text_coordinate_t cursor;
+  /** Connections to the update_notification signal and to the text buffer, while #request is
+      pending. */
+  connection_t update_notification_connection, rewrap_connection;
+  /** The completions last passed to a callback or returned by build_autocomplete_list. */
+  autocomplete_result_t result;
+
+  bool cancel() {
+    if (request == nullptr) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> guard(request->lock);
+      request->cancelled = true;
+    }
+    request.reset();
+    callback = nullptr;
+    update_notification_connection.disconnect();
+    rewrap_connection.disconnect();
+    return true;
+  }
+
+  /** Called from the main loop to pass the completions to the callback, once available. */
+  void deliver() {
+    autocomplete_result_t new_result;
+    {
+      std::lock_guard<std::mutex> guard(request->lock);
+      if (!request->finished) {
+        return;
+      }
+      new_result = std::move(request->result);
+    }
+    callback_t deliver_callback = std::move(callback);
+    bool moved = text->get_cursor() != cursor;
+    cancel();
+    if (moved) {
+      // The completions are for a different position.
+      return;
+    }
+    result = std::move(new_result);
+    deliver_callback(result.completions.get(), result.position);
+  }
+};
+
+async_autocompleter_t::async_autocompleter_t() : impl(new implementation_t) {}
+
+async_autocompleter_t::~async_autocompleter_t() { impl->cancel(); }
+
+string_list_base_t *async_autocompleter_t::build_autocomplete_list(const text_buffer_t *text,
+                                                                   text_pos_t *position) {
+  std::atomic<bool> cancelled{false};
+  cancel_autocomplete();
+  impl->result = prepare_autocomplete(text)(cancelled);
+  *position = impl->result.position;
+  return impl->result.completions.get();
+}
+
+void async_autocompleter_t::autocomplete(text_buffer_t *text, size_t idx) {
+  if (impl->result.completions != nullptr && idx < impl->result.completions->size()) {
+    apply_completion(text, *impl->result.completions, idx);
+  }
+}
+
+void async_autocompleter_t::request_autocomplete(const text_buffer_t *text, callback_t callback) {
+  cancel_autocomplete();
+
+  job_t job = prepare_autocomplete(text);
+  impl->request = std::make_shared<autocomplete_request_t>();
+  impl->callback = std::move(callback);
+  impl->text = text;
+  impl->cursor = text->get_cursor();
+  impl->update_notification_connection =
+      connect_update_notification([this] { impl->deliver(); });
+  /* Connecting to the signal does not modify the text buffer, but the signal connection function
+     is not const. */
+  impl->rewrap_connection = const_cast<text_buffer_t *>(text)->connect_rewrap_required(
+      [this](rewrap_type_t, text_pos_t, text_pos_t) { cancel_autocomplete(); });
+
+  try {
+    std::thread(autocomplete_thread, job, impl->request).detach();
+  } catch (std::system_error &) {
+    // If no thread can be started, compute the completions now. They are still delivered later.
+    autocomplete_thread(std::move(job), impl->request);
+  }
+}
+
+bool async_autocompleter_t::cancel_autocomplete() { return impl->cancel(); }
+
+//===================================== word_autocompleter_t =======================================
+
+/** Minimum number of unused words before the index is compacted. */
+static const size_t min_unused_words_compact = 1024;
+
+/** Determine whether the character starting at @p pos in @p str is part of a word. The length of
+    the character in bytes is stored in @p length. */
+static bool is_word_char(const std::string &str, size_t pos, size_t *length) {
+  unsigned char c = str[pos];
+  // Most text is ASCII, for which the Unicode tables can be skipped.
+  if (c < 0x80) {
+    *length = 1;
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+  }
+  size_t end = pos + 1;
+  while (end < str.size() && (static_cast<unsigned char>(str[end]) & 0xc0) == 0x80) {
+    ++end;
+  }
+  *length = end - pos;
+  return get_class(str, pos) == CLASS_ALNUM;
+}
+
+struct word_autocompleter_t::implementation_t {
+  struct word_t {
+    /** The text of the word, which is the key in #ids, or @c nullptr if the id is unused. */
+    const std::string *text;
+    /** Number of occurences of the word in the text. */
+    uint32_t count;
+  };
+
+  /** Map from the words in the index to their ids. */
+  std::unordered_map<std::string, uint32_t> ids;
+  /** The words in the index, indexed by id. Words that no longer occur in the text have a count of
+      zero, and are only removed when the index is compacted. */
+  std::vector<word_t> words;
+  /** Ids which can be reused for new words. */
+  std::vector<uint32_t> free_ids;
+  /** Number of words with a count of zero. */
+  size_t unused_words = 0;
+  /** Ids of the words sorted on their text. Words added since the last query are in #unsorted. */
+  std::vector<uint32_t> sorted, unsorted;
+  /** For each line in the text, the ids of the words in the line, preceded by their number, or
+      @c nullptr if the line has no words. This is required to update the counts when the line
+      changes. */
+  std::vector<std::unique_ptr<uint32_t[]>> lines;
+
+  /** The text buffer being tracked. */
+  const text_buffer_t *text = nullptr;
+  connection_t rewrap_connection;
+  /** Whether the index must be built from scratch before it can be used. */
+  bool rebuild_required = true;
+
+  size_t min_word_length = 3;
+  size_t max_suggestions = 100;
+  /** The suggestions returned by the last call to build_autocomplete_list. */
+  std::unique_ptr<string_list_t> suggestions;
+  /** The length of the part of the word before the cursor at the last call to
+      build_autocomplete_list. */
+  size_t prefix_length = 0;
+
+  /** Buffers reused for scanning lines, to prevent allocating memory for each line. */
+  std::string word_buffer;
+  std::vector<uint32_t> line_ids;
+
+  const std::string &word_text(uint32_t id) const { return *words[id].text; }
+
+  uint32_t add_word(const char *data, size_t length) {
+    word_buffer.assign(data, length);
+    auto iter = ids.find(word_buffer);
+    if (iter != ids.end()) {
+      word_t &word = words[iter->second];
+      if (word.count++ == 0) {
+        --unused_words;
+      }
+      return iter->second;
+    }
+
+    uint32_t id;
+    if (free_ids.empty()) {
+      id = words.size();
+      words.emplace_back();
+    } else {
+      id = free_ids.back();
+      free_ids.pop_back();
+    }
+    iter = ids.emplace(word_buffer, id).first;
+    words[id].text = &iter->first;
+    words[id].count = 1;
+    unsorted.push_back(id);
+    return id;
+  }
+
+  void remove_word(uint32_t id) {
+    if (--words[id].count == 0) {
+      ++unused_words;
+    }
+  }
+
+  /** Add the words in line @p idx to the index, returning their ids for storing in #lines. */
+  std::unique_ptr<uint32_t[]> index_line(text_pos_t idx) {
+    const std::string &data = text->get_line_data(idx).get_data();
+    size_t char_length;
+
+    line_ids.clear();
+    for (size_t pos = 0; pos < data.size();) {
+      if (!is_word_char(data, pos, &char_length)) {
+        pos += char_length;
+        continue;
+      }
+      size_t start = pos;
+      do {
+        pos += char_length;
+      } while (pos < data.size() && is_word_char(data, pos, &char_length));
+      if (pos - start >= min_word_length) {
+        line_ids.push_back(add_word(data.data() + start, pos - start));
+      }
+    }
+
+    if (line_ids.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<uint32_t[]> result(new uint32_t[line_ids.size() + 1]);
+    result[0] = line_ids.size();
+    std::copy(line_ids.begin(), line_ids.end(), result.get() + 1);
+    return result;
+  }
+
+  void unindex_line(const std::unique_ptr<uint32_t[]> &line) {
+    if (line == nullptr) {
+      return;
+    }
+    for (uint32_t i = 1; i <= line[0]; ++i) {
+      remove_word(line[i]);
+    }
+  }
+
+  void rebuild() {
+    ids.clear();
+    words.clear();
+    free_ids.clear();
+    unused_words = 0;
+    sorted.clear();
+    unsorted.clear();
+    lines.clear();
+
+    text_pos_t size = text->size();
+    lines.reserve(size);
+    for (text_pos_t i = 0; i < size; ++i) {
+      lines.push_back(index_line(i));
+    }
+    rebuild_required = false;
+  }
+
+  /** Update the index after lines in the text changed. */
+  void rewrap(rewrap_type_t type, text_pos_t a, text_pos_t b) {
+    if (rebuild_required) {
+      return;
+    }
+
+    text_pos_t size = lines.size();
+    switch (type) {
+      case rewrap_type_t::REWRAP_LINE:
+      case rewrap_type_t::REWRAP_LINE_LOCAL:
+        if (a < 0 || a >= size) {
+          break;
+        }
+        unindex_line(lines[a]);
+        lines[a] = index_line(a);
+        return;
+      case rewrap_type_t::INSERT_LINES: {
+        if (a < 0 || a > size || b < a) {
+          break;
+        }
+        std::vector<std::unique_ptr<uint32_t[]>> new_lines;
+        new_lines.reserve(b - a);
+        for (text_pos_t i = a; i < b; ++i) {
+          new_lines.push_back(index_line(i));
+        }
+        lines.insert(lines.begin() + a, std::make_move_iterator(new_lines.begin()),
+                     std::make_move_iterator(new_lines.end()));
+        return;
+      }
+      case rewrap_type_t::DELETE_LINES:
+        if (a < 0 || b > size || b < a) {
+          break;
+        }
+        for (text_pos_t i = a; i < b; ++i) {
+          unindex_line(lines[i]);
+        }
+        lines.erase(lines.begin() + a, lines.begin() + b);
+        return;
+      default:
+        break;
+    }
+    // The text was replaced, or the changes are inconsistent with the index.
+    rebuild_required = true;
+  }
+
+  /** Remove the unused words from the index, and add the new words to #sorted. */
+  void update_sorted() {
+    if (unused_words >= min_unused_words_compact && unused_words > words.size() / 2) {
+      for (uint32_t id = 0; id < words.size(); ++id) {
+        if (words[id].text != nullptr && words[id].count == 0) {
+          ids.erase(*words[id].text);
+          words[id].text = nullptr;
+          free_ids.push_back(id);
+        }
+      }
+      auto is_unused = [this](uint32_t id) { return words[id].text == nullptr; };
+      sorted.erase(std::remove_if(sorted.begin(), sorted.end(), is_unused), sorted.end());
+      unsorted.erase(std::remove_if(unsorted.begin(), unsorted.end(), is_unused), unsorted.end());
+      unused_words = 0;
+    }
+
+    if (unsorted.empty()) {
+      return;
+    }
+    auto compare = [this](uint32_t first, uint32_t second) {
+      return word_text(first) < word_text(second);
+    };
+    size_t old_size = sorted.size();
+    std::sort(unsorted.begin(), unsorted.end(), compare);
+    sorted.insert(sorted.end(), unsorted.begin(), unsorted.end());
+    std::inplace_merge(sorted.begin(), sorted.begin() + old_size, sorted.end(), compare);
+    unsorted.clear();
+  }
+
+  void attach(const text_buffer_t *_text) {
+    rewrap_connection.disconnect();
+    text = _text;
+    rebuild_required = true;
+    /* Connecting to the signal does not modify the text buffer, but the signal connection
+       function is not const. */
+    rewrap_connection = const_cast<text_buffer_t *>(text)->connect_rewrap_required(
+        [this](rewrap_type_t type, text_pos_t a, text_pos_t b) { rewrap(type, a, b); });
+  }
+};
+
+word_autocompleter_t::word_autocompleter_t() : impl(new implementation_t) {}
+
+word_autocompleter_t::~word_autocompleter_t() { impl->rewrap_connection.disconnect(); }
+
+string_list_base_t *word_autocompleter_t::build_autocomplete_list(const text_buffer_t *text,
+                                                                  text_pos_t *position) {
+  if (text != impl->text) {
+    impl->attach(text);
+  }
+  if (impl->rebuild_required) {
+    impl->rebuild();
+  }
+  impl->update_sorted();
+
+  // Find the start of the word before the cursor.
+  text_coordinate_t cursor = text->get_cursor();
+  const std::string &data = text->get_line_data(cursor.line).get_data();
+  size_t start = cursor.pos;
+  while (start > 0) {
+    size_t char_start = start - 1;
+    size_t char_length;
+    while (char_start > 0 && (static_cast<unsigned char>(data[char_start]) & 0xc0) == 0x80) {
+      --char_start;
+    }
+    if (!is_word_char(data, char_start, &char_length)) {
+      break;
+    }
+    start = char_start;
+  }
+  if (start == static_cast<size_t>(cursor.pos)) {
+    return nullptr;
+  }
+  *position = start;
+  string_view prefix(data.data() + start, cursor.pos - start);
+  impl->prefix_length = prefix.size();
+
+  /* The words starting with the prefix are adjacent in the sorted index. Only those need to be
+     ranked on their number of occurences. */
+  auto iter = std::lower_bound(
+      impl->sorted.begin(), impl->sorted.end(), prefix,
+      [this](uint32_t id, string_view value) { return string_view(impl->word_text(id)) < value; });
+  std::vector<uint32_t> candidates;
+  for (; iter != impl->sorted.end(); ++iter) {
+    string_view word(impl->word_text(*iter));
+    if (!word.starts_with(prefix)) {
+      break;
+    }
+    if (impl->words[*iter].count > 0 && word.size() > prefix.size()) {
+      candidates.push_back(*iter);
+    }
+  }
+  if (candidates.empty()) {
+    return nullptr;
+  }
+
+  auto more_frequent = [this](uint32_t first, uint32_t second) {
+    if (impl->words[first].count != impl->words[second].count) {
+      return impl->words[first].count > impl->words[second].count;
+    }
+    return impl->word_text(first) < impl->word_text(second);
+  };
+  size_t count = std::min(candidates.size(), impl->max_suggestions);
+  std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                    more_frequent);
+
+  impl->suggestions.reset(new string_list_t);
+  for (size_t i = 0; i < count; ++i) {
+    impl->suggestions->push_back(impl->word_text(candidates[i]));
+  }
+  return impl->suggestions.get();
+}
+
+void word_autocompleter_t::autocomplete(text_buffer_t *text, size_t idx) {
+  if (impl->suggestions == nullptr || idx >= impl->suggestions->size()) {
+    return;
+  }
+  text->insert_block((*impl->suggestions)[idx].substr(impl->prefix_length));
+}
+
+void word_autocompleter_t::set_min_word_length(size_t length) {
+  impl->min_word_length = length;
+  impl->rebuild_required = true;
+}
+
+void word_autocompleter_t::set_max_suggestions(size_t max_suggestions) {
+  impl->max_suggestions = max_suggestions;
+}
+
+void word_autocompleter_t::reset() {
+  impl->rewrap_connection.disconnect();
+  impl->text = nullptr;
+  impl->rebuild_required = true;
+  impl->ids.clear();
+  impl->words.clear();
+  impl->free_ids.clear();
+  impl->unused_words = 0;
+  impl->sorted.clear();
+  impl->unsorted.clear();
+  impl->lines.clear();
+  impl->suggestions.reset();
+}
+
 }  // namespace t3widget
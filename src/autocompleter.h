@@ -14,7 +14,11 @@
 #ifndef T3_WIDGET_AUTOCOMPLETER_H
 #define T3_WIDGET_AUTOCOMPLETER_H
 
+#include <atomic>
 #include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
 #include <t3widget/contentlist.h>
 #include <t3widget/textbuffer.h>
 #include <t3widget/util.h>
@@ -44,6 +48,120 @@ class T3_WIDGET_API autocompleter_t {
   virtual void autocomplete(text_buffer_t *text, size_t idx) = 0;
 };
 
+/** Read-only copy of the lines around the cursor of a text buffer.
+    Unlike the text buffer itself, this can be used from another thread by an
+    async_autocompleter_t. */
+class T3_WIDGET_API text_snapshot_t {
+ public:
+  /** Copy the lines of @p text within @p context_lines lines of the cursor. */
+  text_snapshot_t(const text_buffer_t *text, text_pos_t context_lines);
+  ~text_snapshot_t();
+  /** Retrieve the number of lines of the text buffer. */
+  text_pos_t size() const;
+  /** Retrieve the index of the first line copied. */
+  text_pos_t get_first_line() const;
+  /** Retrieve the index of the line after the last line copied. */
+  text_pos_t get_end_line() const;
+  /** Retrieve the contents of line @p line, which must be in the range of copied lines. */
+  const std::string &get_line_data(text_pos_t line) const;
+  /** Retrieve the position of the cursor. */
+  text_coordinate_t get_cursor() const;
+
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
+};
+
+/** Result of the computation of the completions by an async_autocompleter_t. */
+struct T3_WIDGET_API autocomplete_result_t {
+  /** The suggested completions, or @c nullptr if there are none. */
+  std::unique_ptr<string_list_base_t> completions;
+  /** The starting position of the token being completed, see
+      autocompleter_t::build_autocomplete_list. */
+  text_pos_t position = 0;
+};
+
+/** Interface class for autocompleters which compute the completions on a separate thread.
+
+    An edit_window_t requests the completions using #request_autocomplete, such that a slow
+    autocompleter does not block typing. The request is cancelled when the text or the cursor
+    position changes before the completions are available.
+*/
+class T3_WIDGET_API async_autocompleter_t : public autocompleter_t {
+ public:
+  /** Function computing the completions. The argument is set to @c true when the request is
+      cancelled, after which the function should return as soon as possible. */
+  using job_t = std::function<autocomplete_result_t(const std::atomic<bool> &)>;
+  /** Function called with the completions and the starting position of the token. */
+  using callback_t = std::function<void(string_list_base_t *, text_pos_t)>;
+
+  async_autocompleter_t();
+  ~async_autocompleter_t() override;
+
+  /** Called to prepare the computation of the completions for the cursor position in @p text.
+      This is called from the thread running the #main_loop. The returned function is called on a
+      separate thread, and must therefore only use data which is not changed on the thread running
+      the #main_loop, such as a text_snapshot_t. A cancelled function may still be running when
+      the autocompleter is destroyed, so it must not refer to the autocompleter itself. It must not
+      throw exceptions. */
+  virtual job_t prepare_autocomplete(const text_buffer_t *text) = 0;
+  /** Called to request the modification of the text buffer, given the selection of suggestion
+      @p idx from @p completions, which were computed by a function returned from
+      #prepare_autocomplete. */
+  virtual void apply_completion(text_buffer_t *text, const string_list_base_t &completions,
+                                size_t idx) = 0;
+
+  /** Computes the completions on the calling thread. */
+  string_list_base_t *build_autocomplete_list(const text_buffer_t *text,
+                                              text_pos_t *position) override;
+  void autocomplete(text_buffer_t *text, size_t idx) override;
+
+  /** Start computing the completions for the cursor position in @p text in the background.
+      Any previous request is cancelled. When the completions are available, @p callback is called
+      from the #main_loop, unless the request was cancelled. The request is cancelled when the text
+      changes, or when the cursor has moved by the time the completions are available.
+      The completions passed to @p callback remain valid until the next request. */
+  void request_autocomplete(const text_buffer_t *text, callback_t callback);
+  /** Cancel the request started by #request_autocomplete, if any.
+      @return @c true if a request was still pending. */
+  bool cancel_autocomplete();
+
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
+};
+
+/** Autocompleter suggesting the words occurring in the text buffer.
+
+    The words in the text are kept in an index, which is updated from the change notifications of
+    the text buffer. Only the changed lines are scanned, such that editing remains cheap for very
+    large buffers. The index is built when the first completion is requested for a text buffer, and
+    is rebuilt when the text is replaced as a whole. Suggestions are the words starting with the
+    word before the cursor, most frequent first.
+
+    The index is kept for the text buffer last passed to #build_autocomplete_list. Call #reset
+    before that text buffer is destroyed, if the autocompleter outlives it.
+*/
+class T3_WIDGET_API word_autocompleter_t : public autocompleter_t {
+ public:
+  word_autocompleter_t();
+  ~word_autocompleter_t() override;
+  string_list_base_t *build_autocomplete_list(const text_buffer_t *text,
+                                              text_pos_t *position) override;
+  void autocomplete(text_buffer_t *text, size_t idx) override;
+
+  /** Set the minimum length in bytes of the words to index. The default is 3. */
+  void set_min_word_length(size_t length);
+  /** Set the maximum number of suggestions. The default is 100. */
+  void set_max_suggestions(size_t max_suggestions);
+  /** Discard the index, and stop tracking the text buffer. */
+  void reset();
+
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
+};
+
 }  // namespace t3widget
 
 #endif
@@ -0,0 +1,139 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cstdio>
+#include <t3window/utf8.h>
+
+#include "bench/datagen.h"
+
+namespace t3widget {
+namespace bench {
+
+static const char *const words[] = {
+    "int",    "return", "if",     "else",    "while", "value",  "result", "buffer", "size",
+    "index",  "line",   "window", "text",    "offset", "count", "update", "widget", "process",
+    "key",    "draw",   "needle", "cursor",  "wrap",  "paint",  "config", "state",  "handler",
+    "static", "const",  "void",   "nullptr", "for",   "true",   "false",  "std",    "string"};
+static const char *const separators[] = {" ", " ", " ", ", ", " = ", " + ", "(", ") ", "; ",
+                                         "->", "::", "."};
+static const char *const levels[] = {"DEBUG", "INFO", "INFO", "INFO", "WARNING", "ERROR"};
+
+const char *data_kind_name(data_kind_t kind) {
+  switch (kind) {
+    case data_kind_t::CODE:
+      return "code";
+    case data_kind_t::LOG:
+      return "log";
+    case data_kind_t::CJK:
+      return "cjk";
+    case data_kind_t::LONG_LINES:
+      return "long";
+  }
+  return "unknown";
+}
+
+std::string data_generator_t::generate(data_kind_t kind, int lines) {
+  std::string result;
+  for (int i = 0; i < lines; ++i) {
+    switch (kind) {
+      case data_kind_t::CODE:
+        append_code_line(&result);
+        break;
+      case data_kind_t::LOG:
+        append_log_line(&result, i);
+        break;
+      case data_kind_t::CJK:
+        append_cjk_line(&result);
+        break;
+      case data_kind_t::LONG_LINES:
+        append_long_line(&result);
+        break;
+    }
+    result += '\n';
+  }
+  return result;
+}
+
+void data_generator_t::append_word(std::string *result) {
+  *result += words[next(sizeof(words) / sizeof(words[0]))];
+}
+
+void data_generator_t::append_code_line(std::string *result) {
+  uint32_t indent = next(6);
+  if (next(4) == 0) {
+    result->append(indent, '\t');
+  } else {
+    result->append(indent * 2, ' ');
+  }
+  for (uint32_t length = next(14); length > 0; --length) {
+    append_word(result);
+    *result += separators[next(sizeof(separators) / sizeof(separators[0]))];
+  }
+}
+
+void data_generator_t::append_log_line(std::string *result, int line) {
+  char buffer[64];
+  // Time stamps increase monotonically, like in a real log file.
+  int seconds = line / 7;
+  // Draw the random numbers in a fixed order, as argument evaluation order is unspecified.
+  uint32_t milliseconds = next(1000);
+  const char *level = levels[next(sizeof(levels) / sizeof(levels[0]))];
+  snprintf(buffer, sizeof(buffer), "2018-03-%02d %02d:%02d:%02d.%03u [%s] ",
+           1 + seconds / 86400 % 28, seconds / 3600 % 24, seconds / 60 % 60, seconds % 60,
+           milliseconds, level);
+  *result += buffer;
+  append_word(result);
+  *result += ": ";
+  for (uint32_t length = 3 + next(8); length > 0; --length) {
+    append_word(result);
+    if (next(3) == 0) {
+      snprintf(buffer, sizeof(buffer), "=%u", next(100000));
+      *result += buffer;
+    }
+    *result += ' ';
+  }
+}
+
+void data_generator_t::append_cjk_line(std::string *result) {
+  char buffer[4];
+  for (uint32_t length = 5 + next(40); length > 0; --length) {
+    uint32_t choice = next(20);
+    uint32_t c;
+    if (choice < 12) {
+      c = 0x4e00 + next(0x9fa5 - 0x4e00);  // CJK unified ideographs
+    } else if (choice < 15) {
+      c = 0x3041 + next(0x3096 - 0x3041);  // Hiragana
+    } else if (choice < 16) {
+      c = 0xac00 + next(0xd7a3 - 0xac00);  // Hangul syllables
+    } else if (choice < 17) {
+      // Latin character with a combining accent.
+      *result += static_cast<char>('a' + next(26));
+      c = 0x300 + next(0x36f - 0x300);
+    } else {
+      append_word(result);
+      c = ' ';
+    }
+    result->append(buffer, t3_utf8_put(c, buffer));
+  }
+}
+
+void data_generator_t::append_long_line(std::string *result) {
+  size_t target = result->size() + 20000 + next(80000);
+  while (result->size() < target) {
+    append_word(result);
+    *result += separators[next(sizeof(separators) / sizeof(separators[0]))];
+  }
+}
+
+}  // namespace bench
+}  // namespace t3widget
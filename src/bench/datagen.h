@@ -0,0 +1,64 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_BENCH_DATAGEN_H
+#define T3_WIDGET_BENCH_DATAGEN_H
+
+#include <cstdint>
+#include <string>
+
+namespace t3widget {
+namespace bench {
+
+/** The kinds of text that can be generated. */
+enum class data_kind_t {
+  CODE,      /**< Indented source code with short identifiers and punctuation. */
+  LOG,       /**< Log file lines with time stamps, levels and key/value pairs. */
+  CJK,       /**< Mostly double width CJK text, with some ASCII and combining characters. */
+  LONG_LINES /**< A small number of very long lines. */
+};
+
+/** Get the name of a data_kind_t, for use in benchmark names. */
+const char *data_kind_name(data_kind_t kind);
+
+/** Deterministic pseudo random text generator.
+
+    The output depends only on the seed and the sequence of calls, not on the platform, such that
+    benchmark results for different library versions are computed on the same data.
+*/
+class data_generator_t {
+ public:
+  explicit data_generator_t(uint32_t seed = 1) : state_(seed) {}
+
+  /** Generate @p lines lines of text of the given kind, each terminated by a newline. */
+  std::string generate(data_kind_t kind, int lines);
+
+  /** Get a pseudo random number in the range [0, @p range). */
+  uint32_t next(uint32_t range) {
+    state_ = state_ * 1664525 + 1013904223;
+    return static_cast<uint32_t>((static_cast<uint64_t>(state_ >> 8) * range) >> 24);
+  }
+
+ private:
+  void append_code_line(std::string *result);
+  void append_log_line(std::string *result, int line);
+  void append_cjk_line(std::string *result);
+  void append_long_line(std::string *result);
+  void append_word(std::string *result);
+
+  uint32_t state_;
+};
+
+}  // namespace bench
+}  // namespace t3widget
+#endif
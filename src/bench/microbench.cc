@@ -0,0 +1,458 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmarks for the core data structures. As most of the code measured here is not
+// exported from the shared library, this program is linked with the library sources directly.
+// Build and run with "make bench". Pass a substring of the benchmark names to only run the
+// matching benchmarks, and -j to write the results as JSON.
+
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "bench/datagen.h"
+#include "t3widget/findcontext.h"
+#include "t3widget/modified_xxhash.h"
+#include "t3widget/textbuffer.h"
+#include "t3widget/textline.h"
+#include "t3widget/tinystring.h"
+#include "t3widget/wrapinfo.h"
+
+namespace t3widget {
+namespace bench {
+
+/** State passed to a benchmark function. The clock runs when the function is called. Setup work
+    can be excluded from the measurement by bracketing it with #pause and #resume. Functions that
+    set up data should call #pause before returning, to exclude the clean up as well. */
+class bench_state_t {
+ public:
+  explicit bench_state_t(int64_t iterations) : iterations_(iterations) {}
+
+  int64_t iterations() const { return iterations_; }
+  void pause() {
+    if (running_) {
+      elapsed_ += std::chrono::steady_clock::now() - start_;
+      running_ = false;
+    }
+  }
+  void resume() {
+    if (!running_) {
+      running_ = true;
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  double elapsed_ns() const { return std::chrono::duration<double, std::nano>(elapsed_).count(); }
+
+ private:
+  int64_t iterations_;
+  bool running_ = false;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::duration elapsed_{0};
+};
+
+struct benchmark_t {
+  std::string name;
+  /** Number of bytes processed per iteration, or 0 if throughput is not meaningful. */
+  size_t bytes_per_iteration;
+  std::function<void(bench_state_t &)> function;
+};
+
+/** Used to prevent the compiler from optimizing away results. */
+static volatile size_t sink;
+
+static std::unique_ptr<text_buffer_t> make_buffer(const std::string &contents) {
+  std::unique_ptr<text_buffer_t> result(new text_buffer_t());
+  result->append_text(contents);
+  return result;
+}
+
+static std::vector<std::string> split_lines(const std::string &contents) {
+  std::vector<std::string> result;
+  size_t start = 0;
+  for (size_t end; (end = contents.find('\n', start)) != std::string::npos; start = end + 1) {
+    result.push_back(contents.substr(start, end - start));
+  }
+  return result;
+}
+
+static const data_kind_t all_kinds[] = {data_kind_t::CODE, data_kind_t::LOG, data_kind_t::CJK,
+                                        data_kind_t::LONG_LINES};
+
+static int lines_for_kind(data_kind_t kind) {
+  return kind == data_kind_t::LONG_LINES ? 20 : 20000;
+}
+
+static void add_text_buffer_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  const std::string code = data_generator_t(1).generate(data_kind_t::CODE, 20000);
+
+  benchmarks->push_back({"text_buffer/insert_char", 0, [code](bench_state_t &state) {
+                           state.pause();
+                           std::unique_ptr<text_buffer_t> text = make_buffer(code);
+                           text->set_cursor(text_coordinate_t(text->size() / 2, 0));
+                           state.resume();
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             text->insert_char('a' + i % 26);
+                           }
+                           state.pause();
+                         }});
+
+  benchmarks->push_back({"text_buffer/break_line", 0, [code](bench_state_t &state) {
+                           state.pause();
+                           std::unique_ptr<text_buffer_t> text = make_buffer(code);
+                           state.resume();
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             text_pos_t line = (i * 7919) % text->size();
+                             text->set_cursor(text_coordinate_t(
+                                 line, std::min<text_pos_t>(10, text->get_line_size(line))));
+                             text->break_line();
+                           }
+                           state.pause();
+                         }});
+
+  benchmarks->push_back({"text_buffer/merge", 0, [](bench_state_t &state) {
+                           state.pause();
+                           std::unique_ptr<text_buffer_t> text = make_buffer(
+                               data_generator_t(1).generate(
+                                   data_kind_t::CODE,
+                                   static_cast<int>(std::max<int64_t>(2 * state.iterations() + 2,
+                                                                      1000))));
+                           state.resume();
+                           // Merge pairs of lines, to avoid building a single huge line.
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             text->set_cursor(text_coordinate_t(i + 1, 0));
+                             text->merge(true);
+                           }
+                           state.pause();
+                         }});
+
+  benchmarks->push_back({"text_buffer/block_delete_insert", 0, [code](bench_state_t &state) {
+                           state.pause();
+                           std::unique_ptr<text_buffer_t> text = make_buffer(code);
+                           state.resume();
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             text_coordinate_t start((i * 7919) % (text->size() - 100), 0);
+                             text_coordinate_t end(start.line + 50, 0);
+                             std::unique_ptr<std::string> block = text->convert_block(start, end);
+                             text->delete_block(start, end);
+                             text->set_cursor(start);
+                             text->insert_block(*block);
+                           }
+                           state.pause();
+                         }});
+
+  benchmarks->push_back({"text_buffer/undo_redo", 0, [code](bench_state_t &state) {
+                           state.pause();
+                           std::unique_ptr<text_buffer_t> text = make_buffer(code);
+                           const int depth = 1000;
+                           for (int i = 0; i < depth; ++i) {
+                             text->set_cursor(text_coordinate_t((i * 7919) % text->size(), 0));
+                             text->insert_block("inserted\ntext ");
+                           }
+                           state.resume();
+                           // Walk up and down the undo history, one step per iteration.
+                           int position = depth;
+                           bool undoing = true;
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             if (undoing) {
+                               text->apply_undo();
+                               undoing = --position > 0;
+                             } else {
+                               text->apply_redo();
+                               undoing = ++position == depth;
+                             }
+                           }
+                           state.pause();
+                         }});
+}
+
+static void add_wrap_info_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  for (data_kind_t kind : all_kinds) {
+    std::shared_ptr<std::string> contents = std::make_shared<std::string>(
+        data_generator_t(2).generate(kind, lines_for_kind(kind)));
+
+    benchmarks->push_back(
+        {std::string("wrap_info/rewrap/") + data_kind_name(kind), contents->size(),
+         [contents](bench_state_t &state) {
+           state.pause();
+           std::unique_ptr<text_buffer_t> text = make_buffer(*contents);
+           wrap_info_t wrap_info(80);
+           wrap_info.set_text_buffer(text.get());
+           state.resume();
+           for (int64_t i = 0; i < state.iterations(); ++i) {
+             // Alternate the width, as setting the same width is a no-op.
+             wrap_info.set_wrap_width(i & 1 ? 80 : 79);
+           }
+           state.pause();
+         }});
+
+    benchmarks->push_back(
+        {std::string("wrap_info/navigate/") + data_kind_name(kind), 0,
+         [contents](bench_state_t &state) {
+           state.pause();
+           std::unique_ptr<text_buffer_t> text = make_buffer(*contents);
+           wrap_info_t wrap_info(80);
+           wrap_info.set_text_buffer(text.get());
+           text_coordinate_t coord(0, 0);
+           state.resume();
+           for (int64_t i = 0; i < state.iterations(); ++i) {
+             // Page down, and move back a few lines, as when scrolling through the text.
+             if (!wrap_info.add_lines(coord, 50)) {
+               coord = text_coordinate_t(0, 0);
+             }
+             wrap_info.sub_lines(coord, 3);
+             sink = sink + wrap_info.calculate_screen_pos(coord);
+           }
+           state.pause();
+         }});
+  }
+}
+
+static void add_finder_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  struct finder_case_t {
+    const char *name;
+    const char *needle;
+    int flags;
+  };
+  static const finder_case_t cases[] = {
+      {"plain", "needle", 0},
+      {"icase", "NeEdLe", find_flags_t::ICASE},
+      {"regex", "wid[a-z]+t|[0-9]{4,}", find_flags_t::REGEX},
+  };
+
+  for (data_kind_t kind : all_kinds) {
+    std::shared_ptr<std::string> contents = std::make_shared<std::string>(
+        data_generator_t(3).generate(kind, lines_for_kind(kind)));
+    for (const finder_case_t &c : cases) {
+      benchmarks->push_back(
+          {std::string("finder/") + c.name + "/" + data_kind_name(kind), contents->size(),
+           [contents, c](bench_state_t &state) {
+             state.pause();
+             std::unique_ptr<text_buffer_t> text = make_buffer(*contents);
+             std::string error;
+             std::unique_ptr<finder_t> finder = finder_t::create(c.needle, c.flags, &error);
+             if (finder == nullptr) {
+               fprintf(stderr, "Could not create finder: %s\n", error.c_str());
+               exit(EXIT_FAILURE);
+             }
+             state.resume();
+             // Each iteration finds all matches in the text.
+             for (int64_t i = 0; i < state.iterations(); ++i) {
+               find_result_t result;
+               text->set_cursor(text_coordinate_t(0, 0));
+               while (text->find(finder.get(), &result)) {
+                 text->set_cursor(result.end);
+                 sink = sink + 1;
+               }
+             }
+             state.pause();
+           }});
+    }
+  }
+}
+
+static void add_text_line_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  for (data_kind_t kind : all_kinds) {
+    std::string contents = data_generator_t(4).generate(kind, lines_for_kind(kind));
+    std::shared_ptr<std::vector<std::unique_ptr<text_line_t>>> lines =
+        std::make_shared<std::vector<std::unique_ptr<text_line_t>>>();
+    for (const std::string &line : split_lines(contents)) {
+      lines->emplace_back(new text_line_t(line));
+    }
+
+    benchmarks->push_back({std::string("text_line/screen_width/") + data_kind_name(kind),
+                           contents.size(), [lines](bench_state_t &state) {
+                             for (int64_t i = 0; i < state.iterations(); ++i) {
+                               for (const std::unique_ptr<text_line_t> &line : *lines) {
+                                 sink = sink + line->calculate_screen_width(0, line->size(), 8);
+                               }
+                             }
+                           }});
+
+    benchmarks->push_back({std::string("text_line/break_pos/") + data_kind_name(kind),
+                           contents.size(), [lines](bench_state_t &state) {
+                             for (int64_t i = 0; i < state.iterations(); ++i) {
+                               for (const std::unique_ptr<text_line_t> &line : *lines) {
+                                 text_line_t::break_pos_t pos = {0, 0};
+                                 do {
+                                   pos = line->find_next_break_pos(pos.pos, 80, 8);
+                                 } while (pos.pos > 0);
+                               }
+                             }
+                           }});
+  }
+}
+
+static void add_tiny_string_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  benchmarks->push_back({"tiny_string/construct_short", 0, [](bench_state_t &state) {
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             tiny_string_t str("cursor");
+                             sink = sink + str.size();
+                           }
+                         }});
+  benchmarks->push_back({"tiny_string/construct_long", 0, [](bench_state_t &state) {
+                           std::string source(200, 'x');
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             tiny_string_t str(source);
+                             sink = sink + str.size();
+                           }
+                         }});
+  benchmarks->push_back({"tiny_string/append", 0, [](bench_state_t &state) {
+                           tiny_string_t str;
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             if (str.size() >= 256) {
+                               str.assign(string_view());
+                             }
+                             str += static_cast<char>('a' + i % 26);
+                           }
+                           sink = sink + str.size();
+                         }});
+  benchmarks->push_back({"tiny_string/insert_erase", 0, [](bench_state_t &state) {
+                           tiny_string_t str("the quick brown fox jumps over the lazy dog");
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             str.insert(i % str.size(), string_view("abc"));
+                             str.replace(i % (str.size() - 3), 3, string_view());
+                           }
+                           sink = sink + str.size();
+                         }});
+  benchmarks->push_back({"tiny_string/compare_find", 0, [](bench_state_t &state) {
+                           tiny_string_t a("widget_update_contents_for_line");
+                           tiny_string_t b("widget_update_contents_for_lime");
+                           for (int64_t i = 0; i < state.iterations(); ++i) {
+                             sink = sink + a.compare(b) + a.find(string_view("for"));
+                           }
+                         }});
+}
+
+static void add_hash_benchmarks(std::vector<benchmark_t> *benchmarks) {
+  for (size_t size : {16, 256, 4096}) {
+    std::shared_ptr<std::string> data = std::make_shared<std::string>(
+        data_generator_t(5).generate(data_kind_t::LONG_LINES, 1).substr(0, size));
+    benchmarks->push_back({"xxhash/" + std::to_string(size), size, [data](bench_state_t &state) {
+                             for (int64_t i = 0; i < state.iterations(); ++i) {
+                               sink = sink + ModifiedXXHash(data->data(), data->size(), i);
+                             }
+                           }});
+  }
+}
+
+struct result_t {
+  std::string name;
+  int64_t iterations;
+  double ns_per_iteration;
+  double mb_per_second;
+};
+
+/** Run a benchmark with an increasing number of iterations, until it runs long enough to give a
+    stable result. */
+static result_t run_benchmark(const benchmark_t &benchmark, double min_time_ns) {
+  int64_t iterations = 1;
+  while (true) {
+    bench_state_t state(iterations);
+    state.resume();
+    benchmark.function(state);
+    state.pause();
+    double elapsed = state.elapsed_ns();
+    if (elapsed >= min_time_ns || iterations >= (int64_t(1) << 40)) {
+      double ns = elapsed / iterations;
+      return {benchmark.name, iterations, ns,
+              benchmark.bytes_per_iteration == 0 ? 0.0 : benchmark.bytes_per_iteration * 1e3 / ns};
+    }
+    // Aim for 1.5 times the minimum time, but do not grow too fast on unreliable measurements.
+    double factor = elapsed <= 0 ? 100 : std::min(100.0, 1.5 * min_time_ns / elapsed);
+    iterations = std::max(iterations + 1, static_cast<int64_t>(iterations * factor));
+  }
+}
+
+}  // namespace bench
+}  // namespace t3widget
+
+using namespace t3widget;
+using namespace t3widget::bench;
+
+int main(int argc, char *argv[]) {
+  bool json = false;
+  double min_time_ns = 2e8;
+  int c;
+
+  while ((c = getopt(argc, argv, "hjt:")) != -1) {
+    switch (c) {
+      case 'h':
+        printf("Usage: microbench [<options>] [<filter>...]\n");
+        printf("  -j         Write the results as JSON\n");
+        printf("  -t <ms>    Minimum run time per benchmark in milliseconds (default 200)\n");
+        return EXIT_SUCCESS;
+      case 'j':
+        json = true;
+        break;
+      case 't':
+        min_time_ns = atof(optarg) * 1e6;
+        break;
+      default:
+        return EXIT_FAILURE;
+    }
+  }
+
+  setlocale(LC_ALL, "C.UTF-8");
+
+  std::vector<benchmark_t> benchmarks;
+  add_text_buffer_benchmarks(&benchmarks);
+  add_wrap_info_benchmarks(&benchmarks);
+  add_finder_benchmarks(&benchmarks);
+  add_text_line_benchmarks(&benchmarks);
+  add_tiny_string_benchmarks(&benchmarks);
+  add_hash_benchmarks(&benchmarks);
+
+  std::vector<result_t> results;
+  for (const benchmark_t &benchmark : benchmarks) {
+    bool selected = optind == argc;
+    for (int i = optind; i < argc && !selected; ++i) {
+      selected = benchmark.name.find(argv[i]) != std::string::npos;
+    }
+    if (!selected) {
+      continue;
+    }
+    result_t result = run_benchmark(benchmark, min_time_ns);
+    if (!json) {
+      printf("%-36s %12.1f ns/iter", result.name.c_str(), result.ns_per_iteration);
+      if (result.mb_per_second > 0) {
+        printf(" %10.1f MB/s", result.mb_per_second);
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+    results.push_back(result);
+  }
+
+  if (json) {
+    printf("{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+      printf("    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_iteration\": %.2f, "
+             "\"mb_per_second\": %.2f}%s\n",
+             results[i].name.c_str(), static_cast<long long>(results[i].iterations),
+             results[i].ns_per_iteration, results[i].mb_per_second,
+             i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+  }
+  return EXIT_SUCCESS;
+}
@@ -38,6 +38,7 @@ using lt_dlhandle = void *;
 #include "t3widget/extclipboard.h"
 #include "t3widget/main.h"
 #include "t3widget/signals.h"
+#include "t3widget/trace.h"
 
 namespace t3widget {
 
@@ -55,6 +56,7 @@ static connection_t init_connected = connect_on_init(init_external_clipboard);
     See lock_clipboard for details.
 */
 std::shared_ptr<std::string> get_clipboard() {
+  trace_scope_t trace("get_clipboard");
   if (extclipboard_calls != nullptr) {
     return extclipboard_calls->get_selection(true);
   }
@@ -67,6 +69,7 @@ std::shared_ptr<std::string> get_clipboard() {
     See lock_clipboard for details.
 */
 std::shared_ptr<std::string> get_primary() {
+  trace_scope_t trace("get_primary");
   if (extclipboard_calls != nullptr) {
     return extclipboard_calls->get_selection(false);
   }
@@ -74,6 +77,7 @@ std::shared_ptr<std::string> get_primary() {
 }
 
 void set_clipboard(std::unique_ptr<std::string> str) {
+  trace_scope_t trace("set_clipboard");
   if (str != nullptr && str->size() == 0) {
     str.reset();
   }
@@ -86,6 +90,7 @@ void set_clipboard(std::unique_ptr<std::string> str) {
 }
 
 void set_primary(std::unique_ptr<std::string> str) {
+  trace_scope_t trace("set_primary");
   if (str != nullptr && str->size() == 0) {
     str.reset();
   }
@@ -114,25 +119,26 @@ static void init_external_clipboard(bool init) {
     }
 
     if ((extclipboard_mod = lt_dlopen(X11_MOD_NAME)) == nullptr) {
-      lprintf("Could not open external clipboard module (X11): %s\n", X11_MOD_NAME);
+      llog(LOG_WARNING, CLIPBOARD, "Could not open external clipboard module (X11): %s\n",
+           X11_MOD_NAME);
       return;
     }
 
     if ((extclipboard_calls = reinterpret_cast<extclipboard_interface_t *>(
              lt_dlsym(extclipboard_mod, "_t3_widget_extclipboard_calls"))) == nullptr) {
-      lprintf("External clipboard module does not export interface symbol\n");
+      llog(LOG_WARNING, CLIPBOARD, "External clipboard module does not export interface symbol\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_mod = nullptr;
       return;
     }
     if (extclipboard_calls->version != EXTCLIPBOARD_VERSION) {
-      lprintf("External clipboard module has incompatible version\n");
+      llog(LOG_WARNING, CLIPBOARD, "External clipboard module has incompatible version\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_mod = nullptr;
       return;
     }
     if (!extclipboard_calls->init()) {
-      lprintf("Failed to initialize external clipboard module\n");
+      llog(LOG_WARNING, CLIPBOARD, "Failed to initialize external clipboard module\n");
       lt_dlclose(extclipboard_mod);
       extclipboard_calls = nullptr;
     }
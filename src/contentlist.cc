@@ -12,79 +12,85 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <deque>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <functional>
+#include <iterator>
 #include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <unistd.h>
 #include <utility>
 #include <vector>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #include "t3widget/contentlist.h"
 #include "t3widget/internal.h"
 #include "t3widget/signals.h"
 #include "t3widget/util.h"
+#include "t3window/terminal.h"
 #include "widget_api.h"
 
 namespace t3widget {
 
 //===================================== string_list_iterator_t =====================================
 
-class const_string_list_iterator_t::adapter_base_t {
- public:
-  virtual ~adapter_base_t() = default;
-  virtual void operator++() = 0;
-  virtual const std::string &operator*() const = 0;
-  virtual bool operator==(const adapter_base_t &other) const = 0;
-  virtual std::unique_ptr<adapter_base_t> clone() const = 0;
-};
-
-const_string_list_iterator_t::const_string_list_iterator_t(std::unique_ptr<adapter_base_t> impl)
-    : impl_(std::move(impl)) {}
-const_string_list_iterator_t::const_string_list_iterator_t(
-    const const_string_list_iterator_t &other)
-    : impl_(other.impl_->clone()) {}
-const_string_list_iterator_t::const_string_list_iterator_t(const_string_list_iterator_t &&other)
-    : impl_(std::move(other.impl_)) {}
-
-const_string_list_iterator_t::~const_string_list_iterator_t() {}
-
-const_string_list_iterator_t &const_string_list_iterator_t::operator=(
-    const const_string_list_iterator_t &other) {
-  impl_ = other.impl_->clone();
-  return *this;
-}
-
-const_string_list_iterator_t &const_string_list_iterator_t::operator=(
-    const_string_list_iterator_t &&other) {
-  impl_ = std::move(other.impl_);
-  return *this;
+void const_string_list_iterator_t::fill_batch() const {
+  batch_start_ = idx_;
+  batch_size_ = list_->get_items(idx_, BATCH_CAPACITY, batch_);
 }
 
-const_string_list_iterator_t &const_string_list_iterator_t::operator++() {
-  ++*impl_;
-  return *this;
-}
+//===================================== string_list_base_t =========================================
 
-const_string_list_iterator_t const_string_list_iterator_t::operator++(int) {
-  const_string_list_iterator_t result = *this;
-  ++*impl_;
-  return result;
+size_t string_list_base_t::get_items(size_t start, size_t count, const std::string **items) const {
+  size_t list_size = size();
+  if (start >= list_size) {
+    return 0;
+  }
+  count = std::min(count, list_size - start);
+  for (size_t i = 0; i < count; ++i) {
+    items[i] = &(*this)[start + i];
+  }
+  return count;
 }
 
-const std::string &const_string_list_iterator_t::operator*() const { return **impl_; }
-const std::string *const_string_list_iterator_t::operator->() const { return &**impl_; }
+//===================================== file_list_base_t ===========================================
 
-bool const_string_list_iterator_t::operator==(const const_string_list_iterator_t &other) const {
-  return *impl_ == *other.impl_;
-}
+size_t file_list_base_t::get_display_widths(size_t start, size_t count, int *widths) const {
+  const std::string *items[64];
+  const size_t max_items = sizeof(items) / sizeof(items[0]);
+  size_t done = 0;
 
-bool const_string_list_iterator_t::operator!=(const const_string_list_iterator_t &other) const {
-  return !(*impl_ == *other.impl_);
+  while (done < count) {
+    size_t retrieved = get_items(start + done, std::min(count - done, max_items), items);
+    if (retrieved == 0) {
+      break;
+    }
+    for (size_t i = 0; i < retrieved; ++i) {
+      widths[done + i] = t3_term_strncwidth(items[i]->data(), items[i]->size());
+    }
+    done += retrieved;
+  }
+  return done;
 }
 
 //===================================== string_list_t ==============================================
@@ -93,27 +99,6 @@ struct string_list_t::implementation_t {
   signal_t<> content_changed;
 };
 
-class string_list_t::iterator_adapter_t : public const_string_list_iterator_t::adapter_base_t {
- public:
-  explicit iterator_adapter_t(std::vector<std::string>::const_iterator iter)
-      : iter_(std::move(iter)) {}
-  void operator++() override { ++iter_; }
-  const std::string &operator*() const override { return *iter_; }
-  bool operator==(const adapter_base_t &other) const override {
-    const iterator_adapter_t *other_ptr = dynamic_cast<const iterator_adapter_t *>(&other);
-    if (!other_ptr) {
-      return false;
-    }
-    return iter_ == other_ptr->iter_;
-  }
-  std::unique_ptr<adapter_base_t> clone() const override {
-    return t3widget::make_unique<iterator_adapter_t>(iter_);
-  }
-
- private:
-  std::vector<std::string>::const_iterator iter_;
-};
-
 string_list_t::string_list_t() : impl(new implementation_t) {}
 string_list_t::~string_list_t() {}
 
@@ -121,21 +106,22 @@ size_t string_list_t::size() const { return impl->strings.size(); }
 
 const std::string &string_list_t::operator[](size_t idx) const { return impl->strings[idx]; }
 
+size_t string_list_t::get_items(size_t start, size_t count, const std::string **items) const {
+  if (start >= impl->strings.size()) {
+    return 0;
+  }
+  count = std::min(count, impl->strings.size() - start);
+  for (size_t i = 0; i < count; ++i) {
+    items[i] = &impl->strings[start + i];
+  }
+  return count;
+}
+
 void string_list_t::push_back(std::string str) {
   impl->strings.push_back(str);
   impl->content_changed();
 }
 
-const_string_list_iterator_t string_list_t::begin() const {
-  return const_string_list_iterator_t(
-      t3widget::make_unique<iterator_adapter_t>(impl->strings.begin()));
-}
-
-const_string_list_iterator_t string_list_t::end() const {
-  return const_string_list_iterator_t(
-      t3widget::make_unique<iterator_adapter_t>(impl->strings.end()));
-}
-
 _T3_WIDGET_IMPL_SIGNAL(string_list_t, content_changed)
 
 //===================================== file_name_entry_t ==========================================
@@ -146,58 +132,566 @@ class T3_WIDGET_LOCAL file_name_entry_t {
       utf8_name,    /**< The name of the file converted to UTF-8 (or empty if the same as #name). */
       /** Pointer to member to the name to use for dispay purposes. */
       file_name_entry_t::*display_name;
+  /** Key for sorting the entries with a plain comparison, see #make_sort_key. Cleared once the
+      entry is in its final position. */
+  std::string sort_key;
   bool is_dir; /**< Boolean indicating whether this name represents a directory. */
+  /** Width in terminal cells of the display name, or -1 if not computed yet. */
+  mutable int display_width;
   /** Make a new file_name_entry_t. Implemented specifically to allow use in
       std::vector<file_name_entry_t>. */
-  file_name_entry_t() : is_dir(false) { display_name = &file_name_entry_t::name; }
+  file_name_entry_t() : display_name(&file_name_entry_t::name), is_dir(false), display_width(-1) {}
 
   /** Make a new file_name_entry_t. */
   file_name_entry_t(std::string _name, std::string _utf8_name, bool _is_dir)
-      : name(_name), utf8_name(_utf8_name), is_dir(_is_dir) {
+      : name(std::move(_name)),
+        utf8_name(std::move(_utf8_name)),
+        is_dir(_is_dir),
+        display_width(-1) {
     display_name = utf8_name.empty() ? &file_name_entry_t::name : &file_name_entry_t::utf8_name;
+    make_sort_key();
   }
 
-  /** Construct a copy of an existing file_name_entry_t. */
-  file_name_entry_t(const file_name_entry_t &other) { *this = other; }
+  /** Get the character indicating the group the entry belongs to, for sorting. The groups are, in
+      order: the parent directory, hidden directories, directories, hidden files and files. */
+  char group() const {
+    if (is_dir) {
+      return name == ".." ? '0' : name[0] == '.' ? '1' : '2';
+    }
+    return name[0] == '.' ? '3' : '4';
+  }
 
-  file_name_entry_t& operator=(const file_name_entry_t &other) {
-    name = other.name;
-    utf8_name = other.utf8_name;
-    is_dir = other.is_dir;
-    display_name = other.display_name;
-    return *this;
+  /** Fill #utf8_name by converting #name from the codeset of the locale, and compute
+      #display_width. */
+  void convert_name() {
+    utf8_name = convert_lang_codeset(name, true);
+    if (utf8_name == name) {
+      utf8_name.clear();
+    }
+    display_name = utf8_name.empty() ? &file_name_entry_t::name : &file_name_entry_t::utf8_name;
+    display_width = -1;
+    get_display_width();
+  }
+
+  /** Get the width in terminal cells of the display name, computing it if necessary. */
+  int get_display_width() const {
+    if (display_width < 0) {
+      const std::string &display = this->*display_name;
+      display_width = t3_term_strncwidth(display.data(), display.size());
+    }
+    return display_width;
+  }
+
+ private:
+  /** Compute #sort_key. The key consists of the #group, followed by the name transformed by
+      strxfrm, such that comparing the keys gives the same result as strcoll on the names. This
+      sorts them as the user expects, provided the locale is set correctly. */
+  void make_sort_key() {
+    size_t length = strxfrm(nullptr, name.c_str(), 0);
+    sort_key.resize(length + 2);
+    sort_key[0] = group();
+    strxfrm(&sort_key[1], name.c_str(), length + 1);
+    sort_key.resize(length + 1);
   }
 };
 
-static bool compare_entries(file_name_entry_t first, file_name_entry_t second) {
-  if (first.is_dir && !second.is_dir) {
-    return true;
+static bool compare_entries(const file_name_entry_t &first, const file_name_entry_t &second) {
+  if (!first.sort_key.empty() && !second.sort_key.empty()) {
+    return first.sort_key < second.sort_key;
+  }
+  // The sort keys are released once the entries are sorted, so compare the names directly.
+  char first_group = first.group(), second_group = second.group();
+  if (first_group != second_group) {
+    return first_group < second_group;
   }
+  return strcoll(first.name.c_str(), second.name.c_str()) < 0;
+}
+
+/** Find the entry named @p name in the sorted vector @p files, looking only in the groups for
+    entries of the type indicated by @p is_dir. Returns @c files->end() if it is not present. */
+static std::vector<file_name_entry_t>::iterator find_entry(std::vector<file_name_entry_t> *files,
+                                                           const std::string &name, bool is_dir) {
+  file_name_entry_t key(name, std::string(), is_dir);
+  auto iter = std::lower_bound(files->begin(), files->end(), key, compare_entries);
+  return iter != files->end() && iter->name == name ? iter : files->end();
+}
 
-  if (!first.is_dir && second.is_dir) {
+/** Insert @p entry in the sorted vector @p files, replacing an entry with the same name. */
+static void insert_entry(std::vector<file_name_entry_t> *files, file_name_entry_t entry) {
+  // If the type changed, the old entry is in a different group.
+  auto old = find_entry(files, entry.name, !entry.is_dir);
+  if (old != files->end()) {
+    files->erase(old);
+  }
+  auto iter = std::lower_bound(files->begin(), files->end(), entry, compare_entries);
+  if (iter != files->end() && iter->name == entry.name) {
+    *iter = std::move(entry);
+    return;
+  }
+  files->insert(iter, std::move(entry));
+}
+
+/** Remove the entry named @p name from the sorted vector @p files, if present. */
+static void remove_entry(std::vector<file_name_entry_t> *files, const std::string &name,
+                         bool is_dir) {
+  auto iter = find_entry(files, name, is_dir);
+  if (iter == files->end()) {
+    // Symbolic links to directories are not reported as directories by inotify.
+    iter = find_entry(files, name, !is_dir);
+  }
+  if (iter != files->end()) {
+    files->erase(iter);
+  }
+}
+
+//===================================== directory reading ==========================================
+
+#if defined(__linux__) && defined(SYS_getdents64)
+/** Layout of the header of the records returned by the getdents64 system call. The header is
+    followed by the nul-terminated name. */
+struct linux_dirent64_t {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+};
+static const size_t dirent64_name_offset = 19;
+#endif
+
+/** Determine whether the entry @p name in the directory @p dir_fd is a directory.
+    The type reported by the file system is used if possible, to avoid calling stat. Symbolic
+    links are followed. */
+static bool entry_is_dir(int dir_fd, const char *name, unsigned char type) {
+  struct stat file_info;
+
+  if (type != DT_UNKNOWN && type != DT_LNK) {
+    return type == DT_DIR;
+  }
+  if (fstatat(dir_fd, name, &file_info, 0) < 0) {
+    // This would be weird, but still we have to do something
     return false;
   }
+  return !!S_ISDIR(file_info.st_mode);
+}
 
-  if (first.is_dir && first.name.compare("..") == 0) {
-    return true;
+/** Call @p callback for each entry in the directory @p dir_fd, except for . and .. .
+    Reading stops when @p callback returns @c false. The file descriptor is closed afterwards.
+    @return 0 on success, or an @c errno value if reading the directory failed. */
+static int read_directory(int dir_fd, const std::function<bool(const char *, bool)> &callback) {
+  int error = 0;
+#if defined(__linux__) && defined(SYS_getdents64)
+  /* Reading the entries in large blocks reduces the number of round trips, which is what makes
+     listing directories on network file systems slow. */
+  alignas(linux_dirent64_t) char buffer[65536];
+  long bytes_read;
+
+  while ((bytes_read = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer))) > 0) {
+    for (long pos = 0; pos < bytes_read;) {
+      const linux_dirent64_t *entry = reinterpret_cast<const linux_dirent64_t *>(buffer + pos);
+      const char *name = buffer + pos + dirent64_name_offset;
+      pos += entry->d_reclen;
+      if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        continue;
+      }
+      if (!callback(name, entry_is_dir(dir_fd, name, entry->d_type))) {
+        close(dir_fd);
+        return 0;
+      }
+    }
+  }
+  if (bytes_read < 0) {
+    error = errno;
+  }
+  close(dir_fd);
+#else
+  struct dirent *entry;
+  DIR *dir = fdopendir(dir_fd);
+
+  if (dir == nullptr) {
+    error = errno;
+    close(dir_fd);
+    return error;
+  }
+  // Make sure errno is clear on EOF
+  errno = 0;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+#ifdef _DIRENT_HAVE_D_TYPE
+      unsigned char type = entry->d_type;
+#else
+      unsigned char type = DT_UNKNOWN;
+#endif
+      if (!callback(entry->d_name, entry_is_dir(dirfd(dir), entry->d_name, type))) {
+        break;
+      }
+    }
+    // Make sure errno is clear on EOF
+    errno = 0;
+  }
+  error = errno;
+  closedir(dir);
+#endif
+  return error;
+}
+
+static int open_directory(const std::string &dir_name) {
+  return open(dir_name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/** State of a directory being read in the background, shared between the reading thread and the
+    file_list_t. */
+struct T3_WIDGET_LOCAL directory_load_t {
+  std::mutex lock;
+  /** Batches of entries read, each sorted. Protected by #lock. */
+  std::vector<std::vector<file_name_entry_t>> batches;
+  /** Whether reading has finished. Protected by #lock. */
+  bool finished = false;
+  /** The error that ended reading, if any. Protected by #lock. */
+  int error = 0;
+  std::atomic<bool> cancelled{false};
+};
+
+/** Pass the entries in @p batch to the file_list_t. Returns @c false if the load was cancelled. */
+static bool publish_batch(directory_load_t *load, std::vector<file_name_entry_t> *batch,
+                          bool finished, int error) {
+  std::sort(batch->begin(), batch->end(), compare_entries);
+  {
+    std::lock_guard<std::mutex> guard(load->lock);
+    if (load->cancelled) {
+      return false;
+    }
+    if (!batch->empty()) {
+      load->batches.push_back(std::move(*batch));
+      batch->clear();
+    }
+    load->finished = finished;
+    load->error = error;
   }
+  // Have the main loop call file_list_t::implementation_t::merge_batches.
+  signal_update();
+  return true;
+}
+
+/** Read the entries of @p dir_fd in the background, publishing them in batches. */
+static void load_directory_thread(int dir_fd, std::shared_ptr<directory_load_t> load) {
+  using clock = std::chrono::steady_clock;
+  std::vector<file_name_entry_t> batch;
+  /* The first entries are published quickly, such that the user sees something. To keep the cost
+     of merging the batches down for large directories, the batch size is doubled each time. */
+  size_t batch_limit = 256;
+  clock::time_point last_publish = clock::now();
+
+  int error = read_directory(dir_fd, [&](const char *name, bool is_dir) {
+    batch.emplace_back(name, std::string(), is_dir);
+    if (batch.size() >= batch_limit ||
+        clock::now() - last_publish > std::chrono::milliseconds(50)) {
+      if (!publish_batch(load.get(), &batch, false, 0)) {
+        return false;
+      }
+      batch_limit *= 2;
+      last_publish = clock::now();
+    }
+    return !load->cancelled;
+  });
+  publish_batch(load.get(), &batch, true, error);
+}
+
+//===================================== directory cache ============================================
+/* Directory listings are cached, such that returning to a recently visited directory does not
+   require reading it again. The cached listings are kept up to date using inotify. The inotify
+   file descriptor is monitored by the key reading thread, which records the changes. These are
+   applied on the thread running the main loop, because converting the names requires the shared
+   codeset converter. */
+
+#ifdef __linux__
+/** A change applied to a cached listing. */
+struct T3_WIDGET_LOCAL cached_change_t {
+  /** The entry added, or the name and type of the entry removed. */
+  file_name_entry_t entry;
+  bool removed;
+  /** Generation of the listing after applying the change. */
+  uint64_t generation;
+};
+
+struct T3_WIDGET_LOCAL cached_directory_t {
+  /** The sorted entries, without the entry for the parent directory. */
+  std::vector<file_name_entry_t> files;
+  /** Changes reported by inotify which have not been applied to #files yet. */
+  std::vector<std::pair<std::string, uint32_t>> changes;
+  /** The most recent changes applied to #files, oldest first. These allow bringing copies of
+      the listing up to date without copying it again. */
+  std::deque<cached_change_t> applied;
+  /** Generation of #files before the first change in #applied was applied. */
+  uint64_t applied_start = 0;
+  int watch = -1;
+  /** Whether #files holds the complete listing, as opposed to the directory still being read. */
+  bool complete = false;
+  /** Value identifying the contents of #files, to detect changes. */
+  uint64_t generation = 0;
+  uint64_t last_used = 0;
+};
+
+static const size_t max_cached_directories = 16;
+static const size_t max_cached_entries = 1000000;
+/** Maximum number of unapplied changes, after which the listing is dropped instead. */
+static const size_t max_pending_changes = 10000;
+/** Maximum number of applied changes kept per listing. Copies of the listing which are further
+    behind are replaced by a new copy. */
+static const size_t max_applied_changes = 1000;
+static const uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+/* All of the following are protected by directory_cache_lock. */
+static std::mutex directory_cache_lock;
+static std::map<std::string, cached_directory_t> directory_cache;
+static std::map<int, std::string> directory_cache_watches;
+static int inotify_fd = -1;
+static uint64_t directory_cache_clock;
+
+static void remove_cached_directory(std::map<std::string, cached_directory_t>::iterator iter) {
+  if (iter->second.watch >= 0) {
+    inotify_rm_watch(inotify_fd, iter->second.watch);
+    directory_cache_watches.erase(iter->second.watch);
+  }
+  directory_cache.erase(iter);
+}
 
-  if (second.is_dir && second.name.compare("..") == 0) {
+/** Start watching @p dir_name for changes, before reading it. Returns whether the listing will
+    be cached. */
+static bool start_cached_directory(const std::string &dir_name) {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  if (inotify_fd < 0) {
     return false;
   }
+  if (directory_cache.count(dir_name) != 0) {
+    return true;
+  }
+  int watch = inotify_add_watch(inotify_fd, dir_name.c_str(), watch_mask);
+  if (watch < 0) {
+    return false;
+  }
+  if (directory_cache_watches.count(watch) != 0) {
+    /* The directory is already cached under a different name. The watch is shared, so it must not
+       be removed. */
+    return false;
+  }
+  directory_cache_watches[watch] = dir_name;
+  directory_cache[dir_name].watch = watch;
+  return true;
+}
+
+/** Apply @p change to the sorted vector @p files. */
+static void apply_cached_change(std::vector<file_name_entry_t> *files,
+                                const cached_change_t &change) {
+  if (change.removed) {
+    remove_entry(files, change.entry.name, change.entry.is_dir);
+  } else {
+    insert_entry(files, change.entry);
+  }
+}
 
-  if (first.name[0] == '.' && second.name[0] != '.') {
+/** Apply the changes recorded by the key reading thread to the listing of @p dir_name. */
+static void apply_cache_changes(const std::string &dir_name, cached_directory_t *cached) {
+  if (cached->changes.empty()) {
+    return;
+  }
+  for (const std::pair<std::string, uint32_t> &change : cached->changes) {
+    cached_change_t applied;
+    bool is_dir = (change.second & IN_ISDIR) != 0;
+    applied.removed = (change.second & (IN_DELETE | IN_MOVED_FROM)) != 0;
+    if (applied.removed) {
+      applied.entry = file_name_entry_t(change.first, std::string(), is_dir);
+    } else {
+      applied.entry = file_name_entry_t(change.first, std::string(),
+                                        is_dir || t3widget::is_dir(dir_name, change.first));
+      applied.entry.convert_name();
+    }
+    std::string().swap(applied.entry.sort_key);
+    applied.generation = ++directory_cache_clock;
+    apply_cached_change(&cached->files, applied);
+    cached->applied.push_back(std::move(applied));
+  }
+  while (cached->applied.size() > max_applied_changes) {
+    cached->applied_start = cached->applied.front().generation;
+    cached->applied.pop_front();
+  }
+  cached->changes.clear();
+  cached->generation = directory_cache_clock;
+}
+
+/** Bring @p files up to date with the cached listing of @p dir_name. @p files must hold the entry
+    for the parent directory unless @p dir_name is the root directory, followed by the cached
+    listing as it was at @p generation. Only the changes since then are applied, unless @p files
+    is too far behind, or @p generation is @c 0. In that case the listing is copied.
+    @return @c false if there is no complete listing of @p dir_name in the cache. */
+static bool get_cached_directory(const std::string &dir_name,
+                                 std::vector<file_name_entry_t> *files, uint64_t *generation) {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  auto iter = directory_cache.find(dir_name);
+  if (iter == directory_cache.end() || !iter->second.complete) {
+    return false;
+  }
+  cached_directory_t &cached = iter->second;
+  apply_cache_changes(dir_name, &cached);
+  cached.last_used = ++directory_cache_clock;
+  if (cached.generation == *generation) {
     return true;
   }
+  /* Generations are taken from a clock shared by all listings, so a generation from before the
+     applied changes can not identify a state of this listing. */
+  if (*generation >= cached.applied_start) {
+    auto change = std::upper_bound(
+        cached.applied.begin(), cached.applied.end(), *generation,
+        [](uint64_t value, const cached_change_t &entry) { return value < entry.generation; });
+    for (; change != cached.applied.end(); ++change) {
+      apply_cached_change(files, *change);
+    }
+  } else {
+    files->erase(files->begin() + (dir_name.compare("/") != 0), files->end());
+    files->insert(files->end(), cached.files.begin(), cached.files.end());
+  }
+  *generation = cached.generation;
+  return true;
+}
+
+/** Store the listing @p files of @p dir_name, which must be sorted and start with the entry for
+    the parent directory unless @p dir_name is the root directory.
+    @return @c false if the listing is not cached, e.g. because the directory changed in a way
+        that can not be tracked while it was being read. */
+static bool store_cached_directory(const std::string &dir_name,
+                                   const std::vector<file_name_entry_t> &files,
+                                   uint64_t *generation) {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  auto iter = directory_cache.find(dir_name);
+  if (iter == directory_cache.end()) {
+    return false;
+  }
+  cached_directory_t &cached = iter->second;
+  cached.files.assign(files.begin() + (dir_name.compare("/") != 0), files.end());
+  cached.complete = true;
+  cached.generation = ++directory_cache_clock;
+  cached.last_used = cached.generation;
+  cached.applied.clear();
+  cached.applied_start = cached.generation;
+  *generation = cached.generation;
+  /* Entries created while reading may or may not have been read, but inserting them again is
+     harmless. So apply the changes after storing the listing. */
+  apply_cache_changes(dir_name, &cached);
+
+  // Evict the least recently used listings, but never the one just stored.
+  while (true) {
+    size_t total_entries = 0;
+    auto oldest = directory_cache.end();
+    for (auto candidate = directory_cache.begin(); candidate != directory_cache.end();
+         ++candidate) {
+      total_entries += candidate->second.files.size();
+      if (candidate != iter && candidate->second.complete &&
+          (oldest == directory_cache.end() ||
+           candidate->second.last_used < oldest->second.last_used)) {
+        oldest = candidate;
+      }
+    }
+    if (oldest == directory_cache.end() || (directory_cache.size() <= max_cached_directories &&
+                                            total_entries <= max_cached_entries)) {
+      break;
+    }
+    remove_cached_directory(oldest);
+  }
+  return true;
+}
+
+/** Drop the incomplete listing of @p dir_name, because reading it was cancelled. */
+static void abandon_cached_directory(const std::string &dir_name) {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  auto iter = directory_cache.find(dir_name);
+  if (iter != directory_cache.end() && !iter->second.complete) {
+    remove_cached_directory(iter);
+  }
+}
+
+void init_directory_cache() {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  if (inotify_fd < 0) {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  }
+}
+
+void cleanup_directory_cache() {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  directory_cache.clear();
+  directory_cache_watches.clear();
+  if (inotify_fd >= 0) {
+    // Closing the file descriptor removes all watches.
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
+}
 
-  if (first.name[0] != '.' && second.name[0] == '.') {
+void fd_set_directory_cache_fd(fd_set *readset, int *max_fd) {
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  if (inotify_fd >= 0) {
+    FD_SET(inotify_fd, readset);
+    *max_fd = std::max(*max_fd, inotify_fd);
+  }
+}
+
+bool check_directory_cache_fd(fd_set *readset) {
+  alignas(struct inotify_event) char buffer[16384];
+  ssize_t bytes_read;
+  bool changed = false;
+
+  std::lock_guard<std::mutex> guard(directory_cache_lock);
+  if (inotify_fd < 0 || !FD_ISSET(inotify_fd, readset)) {
     return false;
   }
 
-  /* Use strcoll on the FS names. This will sort them as the user expects,
-     provided the locale is set correctly. */
-  return strcoll(first.name.c_str(), second.name.c_str()) < 0;
+  while ((bytes_read = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t pos = 0; pos < bytes_read;) {
+      const struct inotify_event *event =
+          reinterpret_cast<const struct inotify_event *>(buffer + pos);
+      pos += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Changes were lost, so none of the listings can be trusted anymore.
+        while (!directory_cache.empty()) {
+          remove_cached_directory(directory_cache.begin());
+        }
+        changed = true;
+        continue;
+      }
+
+      auto watch = directory_cache_watches.find(event->wd);
+      if (watch == directory_cache_watches.end()) {
+        continue;
+      }
+      auto iter = directory_cache.find(watch->second);
+      changed = true;
+      if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT)) ||
+          iter->second.changes.size() >= max_pending_changes) {
+        remove_cached_directory(iter);
+      } else if (event->len > 0) {
+        iter->second.changes.emplace_back(event->name, event->mask);
+      }
+    }
+  }
+  return changed;
+}
+#else
+static bool start_cached_directory(const std::string &) { return false; }
+static bool get_cached_directory(const std::string &, std::vector<file_name_entry_t> *,
+                                 uint64_t *) {
+  return false;
+}
+static bool store_cached_directory(const std::string &, const std::vector<file_name_entry_t> &,
+                                   uint64_t *) {
+  return false;
 }
+static void abandon_cached_directory(const std::string &) {}
+void init_directory_cache() {}
+void cleanup_directory_cache() {}
+void fd_set_directory_cache_fd(fd_set *, int *) {}
+bool check_directory_cache_fd(fd_set *) { return false; }
+#endif
 
 //===================================== file_list_t ===========================================
 
@@ -205,27 +699,144 @@ struct file_list_t::implementation_t {
   /** Vector holding a list of all the files in a directory. */
   std::vector<file_name_entry_t> files;
   signal_t<> content_changed;
-};
+  /** State of the directory being loaded in the background, if any. */
+  std::shared_ptr<directory_load_t> load;
+  /** Name of the directory being loaded in the background, or of which the listing is kept up to
+      date from the directory cache. Empty if neither applies. */
+  std::string dir_name;
+  /** Whether the listing of #dir_name is (being) stored in the directory cache. */
+  bool cached = false;
+  /** Generation of the cached listing that #files is a copy of, or @c 0 if none. */
+  uint64_t cache_generation = 0;
+  /** Connection to the update_notification signal, while loading in the background or while
+      tracking the directory cache. */
+  connection_t update_notification_connection;
+  /** The error that ended reading the directory on the last load, or 0 if none. */
+  int load_error = 0;
+
+  ~implementation_t() { cancel_load(); }
+
+  void cancel_load() {
+    if (load != nullptr) {
+      load->cancelled = true;
+      load.reset();
+      if (cached) {
+        abandon_cached_directory(dir_name);
+      }
+    }
+    cached = false;
+    dir_name.clear();
+    update_notification_connection.disconnect();
+  }
 
-class file_list_t::iterator_adapter_t : public const_string_list_iterator_t::adapter_base_t {
- public:
-  explicit iterator_adapter_t(std::vector<file_name_entry_t>::const_iterator iter)
-      : iter_(std::move(iter)) {}
-  void operator++() override { ++iter_; }
-  const std::string &operator*() const override { return (*iter_).*iter_->display_name; }
-  bool operator==(const adapter_base_t &other) const override {
-    const iterator_adapter_t *other_ptr = dynamic_cast<const iterator_adapter_t *>(&other);
-    if (!other_ptr) {
-      return false;
+  /** Clear the list, leaving only the entry for the parent directory if applicable. */
+  void reset(const std::string &_dir_name) {
+    files.clear();
+    if (_dir_name.compare("/") != 0) {
+      files.push_back(file_name_entry_t("..", "..", true));
     }
-    return iter_ == other_ptr->iter_;
   }
-  std::unique_ptr<adapter_base_t> clone() const override {
-    return t3widget::make_unique<iterator_adapter_t>(iter_);
+
+  int start_load(const std::string &_dir_name) {
+    int dir_fd;
+
+    if ((dir_fd = open_directory(_dir_name)) < 0) {
+      return errno;
+    }
+
+    cancel_load();
+    reset(_dir_name);
+    dir_name = _dir_name;
+    load_error = 0;
+    update_notification_connection = connect_update_notification([this] { update(); });
+
+    cache_generation = 0;
+    if (get_cached_directory(dir_name, &files, &cache_generation)) {
+      cached = true;
+      close(dir_fd);
+      content_changed();
+      return 0;
+    }
+
+    /* The directory must be watched before reading it, to ensure no changes are missed. If it can
+       not be cached, the directory does not have to be tracked after it has been read. */
+    cached = start_cached_directory(dir_name);
+    load = std::make_shared<directory_load_t>();
+    try {
+      std::thread(load_directory_thread, dir_fd, load).detach();
+    } catch (std::system_error &) {
+      // If no thread can be started, simply read the directory now.
+      load_directory_thread(dir_fd, load);
+    }
+    content_changed();
+    return 0;
   }
 
- private:
-  std::vector<file_name_entry_t>::const_iterator iter_;
+  /** Called from the main loop when the background load or the directory cache has new data. */
+  void update() {
+    if (load != nullptr) {
+      merge_batches();
+    } else if (!dir_name.empty()) {
+      uint64_t old_generation = cache_generation;
+      if (!get_cached_directory(dir_name, &files, &cache_generation)) {
+        // The listing was dropped from the cache, so it must be read again.
+        std::string reload_dir = dir_name;
+        if (start_load(reload_dir) != 0) {
+          cancel_load();
+        }
+      } else if (cache_generation != old_generation) {
+        content_changed();
+      }
+    }
+  }
+
+  /** Merge the batches read by the background thread into #files. */
+  void merge_batches() {
+    std::vector<std::vector<file_name_entry_t>> batches;
+    bool finished;
+    int error;
+    {
+      std::lock_guard<std::mutex> guard(load->lock);
+      batches.swap(load->batches);
+      finished = load->finished;
+      error = load->error;
+    }
+
+    for (std::vector<file_name_entry_t> &batch : batches) {
+      size_t old_size = files.size();
+      for (file_name_entry_t &entry : batch) {
+        entry.convert_name();
+      }
+      files.insert(files.end(), std::make_move_iterator(batch.begin()),
+                   std::make_move_iterator(batch.end()));
+      std::inplace_merge(files.begin(), files.begin() + old_size, files.end(), compare_entries);
+    }
+    if (finished) {
+      load.reset();
+      release_sort_keys();
+      load_error = error;
+      if (load_error != 0 && cached) {
+        // The listing is incomplete, so it must not be cached.
+        abandon_cached_directory(dir_name);
+        cached = false;
+      }
+      if (!cached || !store_cached_directory(dir_name, files, &cache_generation)) {
+        cancel_load();
+      } else {
+        // Pick up any changes made while the directory was being read.
+        update();
+      }
+    }
+    if (!batches.empty() || finished) {
+      content_changed();
+    }
+  }
+
+  void release_sort_keys() {
+    for (file_name_entry_t &entry : files) {
+      std::string().swap(entry.sort_key);
+    }
+  }
 };
 
 file_list_t::file_list_t() : impl(new implementation_t) {}
@@ -237,77 +848,484 @@ const std::string &file_list_t::operator[](size_t idx) const {
   return impl->files[idx].*(impl->files[idx].display_name);
 }
 
+size_t file_list_t::get_items(size_t start, size_t count, const std::string **items) const {
+  if (start >= impl->files.size()) {
+    return 0;
+  }
+  count = std::min(count, impl->files.size() - start);
+  for (size_t i = 0; i < count; ++i) {
+    const file_name_entry_t &entry = impl->files[start + i];
+    items[i] = &(entry.*entry.display_name);
+  }
+  return count;
+}
+
+size_t file_list_t::get_display_widths(size_t start, size_t count, int *widths) const {
+  if (start >= impl->files.size()) {
+    return 0;
+  }
+  count = std::min(count, impl->files.size() - start);
+  for (size_t i = 0; i < count; ++i) {
+    widths[i] = impl->files[start + i].get_display_width();
+  }
+  return count;
+}
+
 const std::string &file_list_t::get_fs_name(size_t idx) const { return impl->files[idx].name; }
 
 bool file_list_t::is_dir(size_t idx) const { return impl->files[idx].is_dir; }
 
 int file_list_t::load_directory(const std::string &dir_name) {
-  struct dirent *entry;
-  DIR *dir;
   call_on_return_t cleanup([&] { impl->content_changed(); });
+  int dir_fd;
 
-  impl->files.clear();
-  if (dir_name.compare("/") != 0) {
-    impl->files.push_back(file_name_entry_t("..", "..", true));
-  }
+  impl->cancel_load();
+  impl->reset(dir_name);
+  impl->load_error = 0;
 
-  if ((dir = opendir(dir_name.c_str())) == nullptr) {
+  if ((dir_fd = open_directory(dir_name)) < 0) {
     return errno;
   }
 
-  // Make sure errno is clear on EOF
-  errno = 0;
-  while ((entry = readdir(dir)) != nullptr) {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-      continue;
-    }
-
-    std::string utf8_name = convert_lang_codeset(entry->d_name, true);
-    if (strcmp(entry->d_name, utf8_name.c_str()) == 0) {
-      utf8_name.clear();
-    }
-    impl->files.push_back(
-        file_name_entry_t(entry->d_name, utf8_name, t3widget::is_dir(dir_name, entry->d_name)));
-
-    // Make sure errno is clear on EOF
-    errno = 0;
+  size_t first = impl->files.size();
+  int error = read_directory(dir_fd, [&](const char *name, bool is_dir) {
+    impl->files.emplace_back(name, std::string(), is_dir);
+    return true;
+  });
+  for (size_t i = first; i < impl->files.size(); ++i) {
+    impl->files[i].convert_name();
   }
-
   sort(impl->files.begin(), impl->files.end(), compare_entries);
+  impl->release_sort_keys();
+  impl->load_error = error;
+  return error;
+}
 
-  if (errno != 0) {
-    int error = errno;
-    closedir(dir);
-    return error;
-  }
-  closedir(dir);
-
-  return 0;
+int file_list_t::load_directory_async(const std::string &dir_name) {
+  return impl->start_load(dir_name);
 }
 
+void file_list_t::cancel_load() { impl->cancel_load(); }
+
+bool file_list_t::is_loading() const { return impl->load != nullptr; }
+
+int file_list_t::get_load_error() const { return impl->load_error; }
+
 file_list_t &file_list_t::operator=(const file_list_t &other) {
   if (&other == this) {
     return *this;
   }
 
+  impl->cancel_load();
   impl->files.resize(other.impl->files.size());
   copy(other.impl->files.begin(), other.impl->files.end(), impl->files.begin());
   impl->content_changed();
   return *this;
 }
 
-const_string_list_iterator_t file_list_t::begin() const {
-  return const_string_list_iterator_t(
-      t3widget::make_unique<iterator_adapter_t>(impl->files.begin()));
+_T3_WIDGET_IMPL_SIGNAL(file_list_t, content_changed)
+
+//===================================== file_index_t ===============================================
+
+/** Maximum number of threads used to walk a directory tree. */
+static const size_t max_index_threads = 4;
+/** Maximum number of paths in a file_index_t. */
+static const size_t max_index_paths = 1000000;
+/** Maximum total size of the paths in a file_index_t, such that offsets fit in 32 bits. */
+static const size_t max_index_bytes = 256 * 1024 * 1024;
+/** Number of paths after which a thread walking a directory tree publishes the paths found. */
+static const size_t index_batch_size = 4096;
+
+/** A path in a file_index_t. The path itself is stored in a shared buffer. */
+struct T3_WIDGET_LOCAL indexed_path_t {
+  uint32_t offset;      /**< Offset of the path in the buffer. */
+  uint32_t length;      /**< Length of the path. */
+  uint32_t name_offset; /**< Offset of the last path component in the path. */
+  bool is_dir;
+};
+
+/** Paths found by a thread walking a directory tree, with offsets relative to #paths. */
+struct T3_WIDGET_LOCAL index_batch_t {
+  std::string paths;
+  std::vector<indexed_path_t> entries;
+};
+
+/** State of a directory tree being walked in the background, shared between the walking threads
+    and the file_index_t. */
+struct T3_WIDGET_LOCAL index_walk_t {
+  /** File descriptor of the root of the tree. Directories are opened relative to it. */
+  int root_fd;
+  int max_depth;
+  std::vector<std::string> ignore_patterns;
+
+  std::mutex lock;
+  /** Signalled when directories are added to #pending, or when the walk is done. */
+  std::condition_variable work_available;
+  /** Directories still to be read, as path relative to the root and depth. Protected by #lock. */
+  std::vector<std::pair<std::string, int>> pending;
+  /** Number of threads reading a directory. Protected by #lock. */
+  size_t busy_threads = 0;
+  /** Number of threads that have not finished yet. Protected by #lock. */
+  size_t running_threads = 0;
+  /** Batches of paths found. Protected by #lock. */
+  std::vector<index_batch_t> batches;
+  /** Whether all threads have finished. Protected by #lock. */
+  bool finished = false;
+  /** Number of paths and bytes claimed by the threads, to enforce the size limits. */
+  std::atomic<size_t> claimed_paths{0}, claimed_bytes{0};
+  std::atomic<bool> cancelled{false};
+
+  index_walk_t(int _root_fd, int _max_depth, std::vector<std::string> _ignore_patterns)
+      : root_fd(_root_fd), max_depth(_max_depth), ignore_patterns(std::move(_ignore_patterns)) {}
+  ~index_walk_t() { close(root_fd); }
+
+  bool is_ignored(const char *name) const {
+    for (const std::string &pattern : ignore_patterns) {
+      if (fnmatch(pattern.c_str(), name, 0) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/** Read the directory @p dir_path of the tree being walked, adding its entries to @p batch and
+    the directories to descend into to @p subdirs. */
+static void index_directory(index_walk_t *walk, const std::string &dir_path, int depth,
+                            index_batch_t *batch, std::vector<std::string> *subdirs) {
+  /* Only the last component can be a symbolic link, as the other components were opened the same
+     way. Thus O_NOFOLLOW is sufficient to prevent following symbolic links, and the loops they may
+     cause. */
+  int dir_fd = openat(walk->root_fd, dir_path.empty() ? "." : dir_path.c_str(),
+                      O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+  if (dir_fd < 0) {
+    return;
+  }
+
+  read_directory(dir_fd, [&](const char *name, bool is_dir) {
+    if (walk->is_ignored(name)) {
+      return !walk->cancelled;
+    }
+    size_t name_length = strlen(name);
+    size_t length = dir_path.empty() ? name_length : dir_path.size() + 1 + name_length;
+    if (walk->claimed_paths.fetch_add(1) >= max_index_paths ||
+        walk->claimed_bytes.fetch_add(length) + length > max_index_bytes) {
+      walk->cancelled = true;
+      return false;
+    }
+
+    indexed_path_t entry;
+    entry.offset = batch->paths.size();
+    entry.length = length;
+    entry.name_offset = length - name_length;
+    entry.is_dir = is_dir;
+    if (!dir_path.empty()) {
+      batch->paths += dir_path;
+      batch->paths += '/';
+    }
+    batch->paths.append(name, name_length);
+    batch->entries.push_back(entry);
+
+    if (is_dir && depth + 1 < walk->max_depth) {
+      subdirs->emplace_back(batch->paths, entry.offset, length);
+    }
+    return !walk->cancelled;
+  });
 }
-const_string_list_iterator_t file_list_t::end() const {
-  return const_string_list_iterator_t(t3widget::make_unique<iterator_adapter_t>(impl->files.end()));
+
+/** Thread function walking a directory tree. Each thread takes directories from the pending list
+    until no directories are left and no other thread is reading a directory. */
+static void index_walk_thread(std::shared_ptr<index_walk_t> walk) {
+  using clock = std::chrono::steady_clock;
+  index_batch_t batch;
+  std::vector<std::string> subdirs;
+  clock::time_point last_publish = clock::now();
+  std::unique_lock<std::mutex> guard(walk->lock);
+
+  while (true) {
+    walk->work_available.wait(guard, [&walk] {
+      return walk->cancelled || !walk->pending.empty() || walk->busy_threads == 0;
+    });
+    if (walk->cancelled || walk->pending.empty()) {
+      break;
+    }
+    std::pair<std::string, int> dir = std::move(walk->pending.back());
+    walk->pending.pop_back();
+    ++walk->busy_threads;
+    guard.unlock();
+
+    index_directory(walk.get(), dir.first, dir.second, &batch, &subdirs);
+
+    guard.lock();
+    --walk->busy_threads;
+    for (std::string &subdir : subdirs) {
+      walk->pending.emplace_back(std::move(subdir), dir.second + 1);
+    }
+    if (!subdirs.empty() || walk->busy_threads == 0) {
+      walk->work_available.notify_all();
+    }
+    subdirs.clear();
+    if (batch.entries.size() >= index_batch_size ||
+        (!batch.entries.empty() && clock::now() - last_publish > std::chrono::milliseconds(50))) {
+      walk->batches.push_back(std::move(batch));
+      batch = index_batch_t();
+      last_publish = clock::now();
+      // Have the main loop call file_index_t::implementation_t::merge_batches.
+      signal_update();
+    }
+  }
+
+  if (!batch.entries.empty()) {
+    walk->batches.push_back(std::move(batch));
+  }
+  if (--walk->running_threads == 0) {
+    walk->finished = true;
+  }
+  walk->work_available.notify_all();
+  guard.unlock();
+  signal_update();
 }
 
-_T3_WIDGET_IMPL_SIGNAL(file_list_t, content_changed)
+struct file_index_t::implementation_t {
+  /** Buffer holding all paths, referenced by #paths. */
+  std::string buffer;
+  std::vector<indexed_path_t> paths;
+  /** Indices in #paths, sorted on the path and on the last path component respectively. */
+  std::vector<uint32_t> by_path, by_name;
+  /** The paths matching #query. */
+  std::vector<file_name_entry_t> results;
+  std::string query;
+  size_t max_results = 256;
+  int max_depth = 8;
+  std::vector<std::string> ignore_patterns;
+  /** State of the tree being walked in the background, if any. */
+  std::shared_ptr<index_walk_t> walk;
+  /** Connection to the update_notification signal, while walking the tree. */
+  connection_t update_notification_connection;
+  signal_t<> content_changed;
+
+  ~implementation_t() { cancel(); }
+
+  string_view path(uint32_t idx) const {
+    return string_view(buffer.data() + paths[idx].offset, paths[idx].length);
+  }
+  string_view name(uint32_t idx) const {
+    return path(idx).substr(paths[idx].name_offset);
+  }
+
+  void cancel() {
+    if (walk != nullptr) {
+      {
+        std::lock_guard<std::mutex> guard(walk->lock);
+        walk->cancelled = true;
+      }
+      walk->work_available.notify_all();
+      walk.reset();
+    }
+    update_notification_connection.disconnect();
+  }
+
+  /** Merge the batches found by the background threads into the index. */
+  void merge_batches() {
+    std::vector<index_batch_t> batches;
+    bool finished;
+    {
+      std::lock_guard<std::mutex> guard(walk->lock);
+      batches.swap(walk->batches);
+      finished = walk->finished;
+    }
+
+    size_t old_size = paths.size();
+    for (index_batch_t &batch : batches) {
+      uint32_t base = buffer.size();
+      buffer += batch.paths;
+      for (indexed_path_t &entry : batch.entries) {
+        entry.offset += base;
+        paths.push_back(entry);
+      }
+    }
+    if (paths.size() != old_size) {
+      /* Sorting only the new paths and merging them with the sorted old paths is much cheaper than
+         sorting everything again. */
+      auto add_sorted = [this, old_size](std::vector<uint32_t> *index,
+                                         string_view (implementation_t::*key)(uint32_t) const) {
+        auto compare = [this, key](uint32_t first, uint32_t second) {
+          return (this->*key)(first) < (this->*key)(second);
+        };
+        for (size_t i = old_size; i < paths.size(); ++i) {
+          index->push_back(i);
+        }
+        std::sort(index->begin() + old_size, index->end(), compare);
+        std::inplace_merge(index->begin(), index->begin() + old_size, index->end(), compare);
+      };
+      add_sorted(&by_path, &implementation_t::path);
+      add_sorted(&by_name, &implementation_t::name);
+    }
+
+    if (finished) {
+      walk.reset();
+      update_notification_connection.disconnect();
+    }
+    if (paths.size() != old_size && !query.empty()) {
+      run_query();
+      content_changed();
+    } else if (finished) {
+      // Listeners may show whether the index is still being built.
+      content_changed();
+    }
+  }
+
+  /** Append the paths from @p index for which @p key starts with #query to #results. Paths for
+      which @p skip returns @c true are left out. */
+  template <typename F>
+  void add_results(const std::vector<uint32_t> &index,
+                   string_view (implementation_t::*key)(uint32_t) const, const F &skip) {
+    string_view prefix(query);
+    auto iter = std::lower_bound(index.begin(), index.end(), prefix,
+                                 [this, key](uint32_t idx, string_view value) {
+                                   return (this->*key)(idx) < value;
+                                 });
+    for (; iter != index.end() && results.size() < max_results; ++iter) {
+      if (!(this->*key)(*iter).starts_with(prefix)) {
+        break;
+      }
+      if (skip(*iter)) {
+        continue;
+      }
+      string_view found = path(*iter);
+      results.emplace_back();
+      file_name_entry_t &entry = results.back();
+      entry.name.assign(found.data(), found.size());
+      entry.is_dir = paths[*iter].is_dir;
+      entry.convert_name();
+    }
+  }
+
+  void run_query() {
+    results.clear();
+    if (query.empty()) {
+      return;
+    }
+    add_results(by_path, &implementation_t::path, [](uint32_t) { return false; });
+    string_view prefix(query);
+    // Paths starting with the prefix have already been added.
+    add_results(by_name, &implementation_t::name,
+                [this, &prefix](uint32_t idx) { return path(idx).starts_with(prefix); });
+  }
+};
+
+file_index_t::file_index_t() : impl(new implementation_t) {}
+file_index_t::~file_index_t() {}
+
+size_t file_index_t::size() const { return impl->results.size(); }
+
+const std::string &file_index_t::operator[](size_t idx) const {
+  return impl->results[idx].*(impl->results[idx].display_name);
+}
+
+size_t file_index_t::get_items(size_t start, size_t count, const std::string **items) const {
+  if (start >= impl->results.size()) {
+    return 0;
+  }
+  count = std::min(count, impl->results.size() - start);
+  for (size_t i = 0; i < count; ++i) {
+    const file_name_entry_t &entry = impl->results[start + i];
+    items[i] = &(entry.*entry.display_name);
+  }
+  return count;
+}
+
+const std::string &file_index_t::get_fs_name(size_t idx) const { return impl->results[idx].name; }
+
+bool file_index_t::is_dir(size_t idx) const { return impl->results[idx].is_dir; }
+
+size_t file_index_t::get_display_widths(size_t start, size_t count, int *widths) const {
+  if (start >= impl->results.size()) {
+    return 0;
+  }
+  count = std::min(count, impl->results.size() - start);
+  for (size_t i = 0; i < count; ++i) {
+    widths[i] = impl->results[start + i].get_display_width();
+  }
+  return count;
+}
+
+int file_index_t::start(const std::string &dir_name) {
+  int dir_fd;
+
+  if ((dir_fd = open_directory(dir_name)) < 0) {
+    return errno;
+  }
+
+  impl->cancel();
+  impl->buffer.clear();
+  impl->paths.clear();
+  impl->by_path.clear();
+  impl->by_name.clear();
+  impl->results.clear();
+
+  impl->walk = std::make_shared<index_walk_t>(dir_fd, impl->max_depth, impl->ignore_patterns);
+  impl->walk->pending.emplace_back(std::string(), 0);
+  impl->update_notification_connection =
+      connect_update_notification([this] { impl->merge_batches(); });
+
+  size_t threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                                     max_index_threads);
+  {
+    std::lock_guard<std::mutex> guard(impl->walk->lock);
+    impl->walk->running_threads = threads;
+  }
+  size_t started = 0;
+  try {
+    for (; started < threads; ++started) {
+      std::thread(index_walk_thread, impl->walk).detach();
+    }
+  } catch (std::system_error &) {
+    if (started == 0) {
+      // If no thread can be started, walk the tree now.
+      impl->walk->running_threads = 1;
+      index_walk_thread(impl->walk);
+    } else {
+      std::lock_guard<std::mutex> guard(impl->walk->lock);
+      impl->walk->running_threads -= threads - started;
+      if (impl->walk->running_threads == 0) {
+        impl->walk->finished = true;
+      }
+    }
+  }
+  impl->content_changed();
+  return 0;
+}
+
+void file_index_t::cancel() { impl->cancel(); }
+
+bool file_index_t::is_indexing() const { return impl->walk != nullptr; }
+
+size_t file_index_t::get_indexed_count() const { return impl->paths.size(); }
+
+void file_index_t::set_max_depth(int max_depth) { impl->max_depth = max_depth; }
+
+void file_index_t::set_ignore_patterns(std::vector<std::string> patterns) {
+  impl->ignore_patterns = std::move(patterns);
+}
+
+void file_index_t::set_max_results(size_t max_results) { impl->max_results = max_results; }
+
+void file_index_t::set_query(string_view prefix) {
+  impl->query.assign(prefix.data(), prefix.size());
+  impl->run_query();
+  impl->content_changed();
+}
+
+_T3_WIDGET_IMPL_SIGNAL(file_index_t, content_changed)
 
 //===================================== filtered_list_internal_t ===================================
 
+/** Minimum number of items to test before the filter is applied using multiple threads. */
+static const size_t parallel_filter_threshold = 32768;
+/** Maximum number of threads used to apply a filter. */
+static const size_t max_filter_threads = 8;
+
 /** Partial implementation of the filtered list. */
 template <typename L, typename B>
 class T3_WIDGET_API filtered_list_internal_t : public B {
@@ -322,27 +1340,164 @@ class T3_WIDGET_API filtered_list_internal_t : public B {
   connection_t base_content_changed_connection;
   signal_t<> content_changed;
 
+  /** Scoring function, if the list is ordered by score. If set, #test retains the items for
+      which it returns a score. */
+  optional<std::function<optint(const string_list_base_t &, size_t)>> score;
+  /** Maximum number of items retained by the scoring function, or @c 0 for no limit. */
+  size_t max_scored_items = 0;
+  /** Indices of all items to which the scoring function assigned a score, in base list order.
+      Unlike #items, this is not limited to the #max_scored_items best scoring items, which
+      makes it suitable for narrowing the filter. */
+  std::vector<size_t> scored_items;
+
+  /** Whether the filter may be applied using multiple threads. */
+  bool parallel_filter = false;
+
+  /** Call @p process for the indices @c candidates[0] to @c candidates[count - 1], or for the
+      indices @c 0 to @c count - 1 if @p candidates is @c nullptr, and collect the values it adds
+      to the vector passed to it in @p result, in order. */
+  template <typename T, typename F>
+  void process_candidates(const size_t *candidates, size_t count, const F &process,
+                          std::vector<T> *result) {
+    auto process_range = [&](size_t begin, size_t end, std::vector<T> *matches) {
+      for (size_t i = begin; i < end; ++i) {
+        process(candidates == nullptr ? i : candidates[i], matches);
+      }
+    };
+
+    size_t threads = 1;
+    if (parallel_filter && count >= parallel_filter_threshold) {
+      threads = std::min<size_t>(std::thread::hardware_concurrency(), max_filter_threads);
+    }
+
+    result->clear();
+    if (threads <= 1) {
+      process_range(0, count, result);
+      return;
+    }
+
+    /* Each thread handles a consecutive part of the candidates, such that concatenating the
+       partial results retains the order of the base list. */
+    std::vector<std::vector<T>> partial(threads);
+    std::vector<std::thread> workers;
+    size_t started = 1;
+    try {
+      for (; started < threads; ++started) {
+        workers.emplace_back(process_range, count * started / threads,
+                             count * (started + 1) / threads, &partial[started]);
+      }
+    } catch (std::system_error &) {
+      // Threads that could not be created are handled below by the calling thread.
+    }
+    process_range(0, count / threads, &partial[0]);
+    for (size_t i = started; i < threads; ++i) {
+      process_range(count * i / threads, count * (i + 1) / threads, &partial[i]);
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+
+    size_t total = 0;
+    for (const std::vector<T> &part : partial) {
+      total += part.size();
+    }
+    result->reserve(total);
+    for (const std::vector<T> &part : partial) {
+      result->insert(result->end(), part.begin(), part.end());
+    }
+  }
+
+  /** Apply the filter to the candidates (see #process_candidates), and store the matching
+      indices in #items. */
+  void run_filter(const size_t *candidates, size_t count) {
+    const std::function<bool(const string_list_base_t &, size_t)> &filter = test.value();
+    std::vector<size_t> result;
+    process_candidates(candidates, count,
+                       [&](size_t idx, std::vector<size_t> *matches) {
+                         if (filter(*base, idx)) {
+                           matches->push_back(idx);
+                         }
+                       },
+                       &result);
+    items.swap(result);
+  }
+
+  /** Apply the scoring function to the candidates (see #process_candidates), and store the
+      indices of the best scoring items in #items. */
+  void run_scored_filter(const size_t *candidates, size_t count) {
+    typedef std::pair<int, size_t> scored_item_t;
+    const std::function<optint(const string_list_base_t &, size_t)> &scorer = score.value();
+    std::vector<scored_item_t> scored;
+    process_candidates(candidates, count,
+                       [&](size_t idx, std::vector<scored_item_t> *matches) {
+                         optint item_score = scorer(*base, idx);
+                         if (item_score.is_valid()) {
+                           matches->emplace_back(item_score.value(), idx);
+                         }
+                       },
+                       &scored);
+
+    std::vector<size_t> matching;
+    matching.reserve(scored.size());
+    for (const scored_item_t &item : scored) {
+      matching.push_back(item.second);
+    }
+    scored_items.swap(matching);
+
+    auto better = [](const scored_item_t &a, const scored_item_t &b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    if (max_scored_items != 0 && scored.size() > max_scored_items) {
+      std::partial_sort(scored.begin(), scored.begin() + max_scored_items, scored.end(), better);
+      scored.resize(max_scored_items);
+    } else {
+      std::sort(scored.begin(), scored.end(), better);
+    }
+
+    items.clear();
+    items.reserve(scored.size());
+    for (const scored_item_t &item : scored) {
+      items.push_back(item.second);
+    }
+  }
+
+  /** Retrieve the indices of the items matching the current filter in base list order, for
+      narrowing the filter. Only valid if a filter is set. */
+  std::vector<size_t> take_matching_items() {
+    std::vector<size_t> result;
+    result.swap(score.is_valid() ? scored_items : items);
+    return result;
+  }
+
   /** Update the filtered list.
           Called automatically when the base list changes, through the use of the
       @c content_changed signal.
   */
   void update_list() {
     if (!test.is_valid()) {
+      // Without a filter, this list shows the base list as is.
+      content_changed();
       return;
     }
 
-    items.clear();
-
-    const size_t base_size = base->size();
-    for (size_t i = 0; i < base_size; i++) {
-      if (test.value()(*base, i)) {
-        items.push_back(i);
-      }
+    if (score.is_valid()) {
+      run_scored_filter(nullptr, base->size());
+    } else {
+      run_filter(nullptr, base->size());
     }
-    items.reserve(items.size());
     content_changed();
   }
 
+  /** Install @p _score as the scoring function, and set #test accordingly. */
+  void install_score(std::function<optint(const string_list_base_t &, size_t)> _score,
+                     size_t max_items) {
+    score = std::move(_score);
+    max_scored_items = max_items;
+    test = [this](const string_list_base_t &list, size_t idx) {
+      return score.value()(list, idx).is_valid();
+    };
+  }
+
  public:
   /** Make a new filtered_list_internal_t, wrapping an existing list.
       The filtered_list_internal_t does not take ownership of the list_t. */
@@ -352,11 +1507,45 @@ class T3_WIDGET_API filtered_list_internal_t : public B {
   }
   ~filtered_list_internal_t() override { base_content_changed_connection.disconnect(); }
   void set_filter(std::function<bool(const string_list_base_t &, size_t)> _test) override {
+    score.reset();
+    scored_items.clear();
     test = _test;
     update_list();
   }
+  void narrow_filter(std::function<bool(const string_list_base_t &, size_t)> _test) override {
+    if (!test.is_valid()) {
+      set_filter(std::move(_test));
+      return;
+    }
+    /* The items are kept up to date with the base list, so only the items matching the
+       previous filter can match the new filter. */
+    std::vector<size_t> candidates = take_matching_items();
+    score.reset();
+    test = std::move(_test);
+    run_filter(candidates.data(), candidates.size());
+    content_changed();
+  }
+  void set_scored_filter(std::function<optint(const string_list_base_t &, size_t)> _score,
+                         size_t max_items) override {
+    install_score(std::move(_score), max_items);
+    update_list();
+  }
+  void narrow_scored_filter(std::function<optint(const string_list_base_t &, size_t)> _score,
+                            size_t max_items) override {
+    if (!test.is_valid()) {
+      set_scored_filter(std::move(_score), max_items);
+      return;
+    }
+    std::vector<size_t> candidates = take_matching_items();
+    install_score(std::move(_score), max_items);
+    run_scored_filter(candidates.data(), candidates.size());
+    content_changed();
+  }
+  void set_parallel_filter(bool enable) override { parallel_filter = enable; }
   void reset_filter() override {
     items.clear();
+    scored_items.clear();
+    score.reset();
     test.reset();
     content_changed();
   }
@@ -369,35 +1558,18 @@ class T3_WIDGET_API filtered_list_internal_t : public B {
     return content_changed.connect(cb);
   }
 
-  class iterator_adapter_t : public const_string_list_iterator_t::adapter_base_t {
-   public:
-    iterator_adapter_t(std::vector<size_t>::const_iterator iter, L *base)
-        : iter_(std::move(iter)), base_(base) {}
-    void operator++() override { ++iter_; }
-    const std::string &operator*() const override { return (*base_)[*iter_]; }
-    bool operator==(const adapter_base_t &other) const override {
-      const iterator_adapter_t *other_ptr = dynamic_cast<const iterator_adapter_t *>(&other);
-      if (!other_ptr) {
-        return false;
-      }
-      return iter_ == other_ptr->iter_;
+  size_t get_items(size_t start, size_t count, const std::string **result) const override {
+    if (!test.is_valid()) {
+      return base->get_items(start, count, result);
     }
-    std::unique_ptr<adapter_base_t> clone() const override {
-      return t3widget::make_unique<iterator_adapter_t>(iter_, base_);
+    if (start >= items.size()) {
+      return 0;
     }
-
-   private:
-    std::vector<size_t>::const_iterator iter_;
-    L *base_;
-  };
-
-  const_string_list_iterator_t begin() const override {
-    return const_string_list_iterator_t(
-        t3widget::make_unique<iterator_adapter_t>(items.begin(), base));
-  }
-  const_string_list_iterator_t end() const override {
-    return const_string_list_iterator_t(
-        t3widget::make_unique<iterator_adapter_t>(items.end(), base));
+    count = std::min(count, items.size() - start);
+    for (size_t i = 0; i < count; ++i) {
+      result[i] = &(*base)[items[start + i]];
+    }
+    return count;
   }
 };
 
@@ -426,6 +1598,19 @@ class filtered_file_list_t
   bool is_dir(size_t idx) const override {
     return base->is_dir(test.is_valid() ? items[idx] : idx);
   }
+  size_t get_display_widths(size_t start, size_t count, int *widths) const override {
+    if (!test.is_valid()) {
+      return base->get_display_widths(start, count, widths);
+    }
+    if (start >= items.size()) {
+      return 0;
+    }
+    count = std::min(count, items.size() - start);
+    for (size_t i = 0; i < count; ++i) {
+      base->get_display_widths(items[start + i], 1, &widths[i]);
+    }
+    return count;
+  }
 };
 
 std::unique_ptr<filtered_string_list_base_t> new_filtered_string_list(string_list_base_t *list) {
@@ -468,4 +1653,207 @@ bool glob_filter(const std::string *str, bool show_hidden, const string_list_bas
   return true;
 }
 
+//===================================== fuzzy_pattern_t ============================================
+
+/* The scoring follows the approach of fzf: each matched character scores a fixed amount, plus a
+   bonus depending on where it is in the string, while gaps between matched characters are
+   penalized. The bonus of the first character of the pattern is doubled. */
+static const int fuzzy_score_match = 16;
+static const int fuzzy_penalty_gap_start = 3;
+static const int fuzzy_penalty_gap_extension = 1;
+static const int fuzzy_bonus_start = 10;
+static const int fuzzy_bonus_path = 9;
+static const int fuzzy_bonus_boundary = 8;
+static const int fuzzy_bonus_camel_case = 7;
+static const int fuzzy_bonus_consecutive = 4;
+
+enum fuzzy_char_class_t {
+  CHAR_WHITE,
+  CHAR_PATH,
+  CHAR_DELIMITER,
+  CHAR_LOWER,
+  CHAR_UPPER,
+  CHAR_DIGIT
+};
+
+static fuzzy_char_class_t fuzzy_char_class(unsigned char c) {
+  if (c >= 'a' && c <= 'z') {
+    return CHAR_LOWER;
+  } else if (c >= 'A' && c <= 'Z') {
+    return CHAR_UPPER;
+  } else if (c >= '0' && c <= '9') {
+    return CHAR_DIGIT;
+  } else if (c == ' ' || c == '\t') {
+    return CHAR_WHITE;
+  } else if (c == '/' || c == '\\') {
+    return CHAR_PATH;
+  } else if (c >= 0x80) {
+    // Bytes of non-ASCII characters are treated as letters.
+    return CHAR_LOWER;
+  }
+  return CHAR_DELIMITER;
+}
+
+/** Determine the bonus for matching a character at position @p pos in @p str. */
+static int fuzzy_bonus(const char *str, size_t pos) {
+  fuzzy_char_class_t prev = pos == 0 ? CHAR_WHITE : fuzzy_char_class(str[pos - 1]);
+  fuzzy_char_class_t current = fuzzy_char_class(str[pos]);
+
+  if (current == CHAR_WHITE || current == CHAR_PATH || current == CHAR_DELIMITER) {
+    return fuzzy_bonus_boundary;
+  }
+  switch (prev) {
+    case CHAR_WHITE:
+      return fuzzy_bonus_start;
+    case CHAR_PATH:
+      return fuzzy_bonus_path;
+    case CHAR_DELIMITER:
+      return fuzzy_bonus_boundary;
+    case CHAR_LOWER:
+      return current == CHAR_UPPER || current == CHAR_DIGIT ? fuzzy_bonus_camel_case : 0;
+    default:
+      return 0;
+  }
+}
+
+struct fuzzy_pattern_t::implementation_t {
+  /** The pattern, converted to lower case if matching is case insensitive. */
+  std::string pattern;
+  /** The start offsets of the (UTF-8) characters in #pattern, followed by its size. */
+  std::vector<size_t> char_starts;
+  bool case_sensitive = false;
+
+  /** Check whether the character at offset @p char_start in #pattern matches @p str at @p pos.
+   */
+  bool matches_at(const char *str, size_t pos, size_t char_start, size_t char_size) const {
+    if (char_size == 1 && !case_sensitive) {
+      unsigned char c = str[pos];
+      return static_cast<unsigned char>(pattern[char_start]) ==
+             ((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+    }
+    return memcmp(str + pos, pattern.data() + char_start, char_size) == 0;
+  }
+
+  /** Find the first position at or after @p pos where the character at offset @p char_start in
+      #pattern occurs in @p str, or @c std::string::npos if it does not occur. */
+  size_t find(const char *str, size_t size, size_t pos, size_t char_start,
+              size_t char_size) const {
+    const char first = pattern[char_start];
+    /* The bulk of the matching work is done here, by memchr which is heavily optimized. */
+    if (char_size == 1) {
+      const char *found = static_cast<const char *>(memchr(str + pos, first, size - pos));
+      size_t limit = found == nullptr ? size : found - str;
+      if (!case_sensitive && first >= 'a' && first <= 'z') {
+        const char *upper =
+            static_cast<const char *>(memchr(str + pos, first - 'a' + 'A', limit - pos));
+        if (upper != nullptr) {
+          return upper - str;
+        }
+      }
+      return found == nullptr ? std::string::npos : limit;
+    }
+
+    while (pos + char_size <= size) {
+      const char *found =
+          static_cast<const char *>(memchr(str + pos, first, size - pos - char_size + 1));
+      if (found == nullptr) {
+        break;
+      }
+      pos = found - str;
+      if (matches_at(str, pos, char_start, char_size)) {
+        return pos;
+      }
+      ++pos;
+    }
+    return std::string::npos;
+  }
+};
+
+fuzzy_pattern_t::fuzzy_pattern_t() : impl(new implementation_t) { impl->char_starts.push_back(0); }
+fuzzy_pattern_t::fuzzy_pattern_t(string_view pattern) : impl(new implementation_t) {
+  set_pattern(pattern);
+}
+fuzzy_pattern_t::~fuzzy_pattern_t() {}
+
+void fuzzy_pattern_t::set_pattern(string_view pattern) {
+  impl->case_sensitive = std::any_of(pattern.begin(), pattern.end(),
+                                     [](char c) { return c >= 'A' && c <= 'Z'; });
+  impl->pattern.assign(pattern.data(), pattern.size());
+  impl->char_starts.clear();
+  for (size_t i = 0; i < impl->pattern.size(); ++i) {
+    char &c = impl->pattern[i];
+    if (!impl->case_sensitive && c >= 'A' && c <= 'Z') {
+      c = c - 'A' + 'a';
+    }
+    // UTF-8 continuation bytes are part of the preceding character.
+    if ((c & 0xc0) != 0x80) {
+      impl->char_starts.push_back(i);
+    }
+  }
+  impl->char_starts.push_back(impl->pattern.size());
+}
+
+optint fuzzy_pattern_t::match(string_view str) const {
+  const std::vector<size_t> &char_starts = impl->char_starts;
+  const size_t chars = char_starts.size() - 1;
+  const char *data = str.data();
+  size_t pos = 0;
+
+  if (chars == 0) {
+    return 0;
+  }
+
+  /* First find the earliest end of a match, by matching each character as early as possible. */
+  for (size_t i = 0; i < chars; ++i) {
+    size_t char_size = char_starts[i + 1] - char_starts[i];
+    pos = impl->find(data, str.size(), pos, char_starts[i], char_size);
+    if (pos == std::string::npos) {
+      return None;
+    }
+    pos += char_size;
+  }
+
+  /* Then match backwards from the end of the match, to find the shortest match ending there.
+     The score is computed while doing so. */
+  int score = 0;
+  size_t next = pos;
+  for (size_t i = chars; i-- > 0;) {
+    size_t char_size = char_starts[i + 1] - char_starts[i];
+    pos = next - char_size;
+    while (!impl->matches_at(data, pos, char_starts[i], char_size)) {
+      --pos;
+    }
+
+    int bonus = fuzzy_bonus(data, pos);
+    if (i + 1 < chars) {
+      size_t gap = next - (pos + char_size);
+      if (gap == 0) {
+        bonus = std::max(bonus, fuzzy_bonus_consecutive);
+      } else {
+        score -= fuzzy_penalty_gap_start + static_cast<int>(gap - 1) * fuzzy_penalty_gap_extension;
+      }
+    }
+    score += fuzzy_score_match + (i == 0 ? 2 * bonus : bonus);
+    next = pos;
+  }
+  return score;
+}
+
+optint fuzzy_filter(const fuzzy_pattern_t *pattern, const string_list_base_t &list, size_t idx) {
+  return pattern->match(list[idx]);
+}
+
+optint fuzzy_file_filter(const fuzzy_pattern_t *pattern, bool show_hidden,
+                         const string_list_base_t &list, size_t idx) {
+  const std::string &item_name = list[idx];
+
+  if (item_name.compare("..") == 0) {
+    return INT_MAX;
+  }
+  if (!show_hidden && item_name[0] == '.') {
+    return None;
+  }
+  return pattern->match(item_name);
+}
+
 }  // namespace t3widget
@@ -21,41 +21,66 @@
 #include <t3widget/string_view.h>
 #include <t3widget/util.h>
 #include <t3widget/widget_api.h>
+#include <utility>
 #include <vector>
 
 struct transcript_t;
 
 namespace t3widget {
 
+class string_list_base_t;
+
+/** Iterator over the elements of a string_list_base_t.
+
+    Elements are retrieved in batches using string_list_base_t::get_items, such that iterating
+    does not allocate memory and only requires a virtual function call once per batch. Like
+    indices, iterators are invalidated by changes to the list.
+*/
 class T3_WIDGET_API const_string_list_iterator_t {
  public:
-  class T3_WIDGET_LOCAL adapter_base_t;
-
   using difference_type = std::ptrdiff_t;
   using value_type = const std::string;
   using pointer = const std::string *;
   using reference = const std::string &;
   using iterator_category = std::forward_iterator_tag;
 
-  const_string_list_iterator_t(std::unique_ptr<adapter_base_t> impl);
-  const_string_list_iterator_t(const const_string_list_iterator_t &other);
-  const_string_list_iterator_t(const_string_list_iterator_t &&other);
-
-  ~const_string_list_iterator_t();
+  const_string_list_iterator_t(const string_list_base_t *list, size_t idx)
+      : list_(list), idx_(idx), batch_start_(idx), batch_size_(0), batch_() {}
+
+  const_string_list_iterator_t &operator++() {
+    ++idx_;
+    return *this;
+  }
+  const_string_list_iterator_t operator++(int) {
+    const_string_list_iterator_t result = *this;
+    ++idx_;
+    return result;
+  }
+
+  const std::string &operator*() const {
+    size_t offset = idx_ - batch_start_;
+    if (offset >= batch_size_) {
+      fill_batch();
+      offset = 0;
+    }
+    return *batch_[offset];
+  }
+  const std::string *operator->() const { return &**this; }
+  bool operator==(const const_string_list_iterator_t &other) const {
+    return idx_ == other.idx_ && list_ == other.list_;
+  }
+  bool operator!=(const const_string_list_iterator_t &other) const { return !(*this == other); }
 
-  const_string_list_iterator_t &operator=(const const_string_list_iterator_t &other);
-  const_string_list_iterator_t &operator=(const_string_list_iterator_t &&other);
-
-  const_string_list_iterator_t &operator++();
-  const_string_list_iterator_t operator++(int);
+ private:
+  enum { BATCH_CAPACITY = 32 };
 
-  const std::string &operator*() const;
-  const std::string *operator->() const;
-  bool operator==(const const_string_list_iterator_t &other) const;
-  bool operator!=(const const_string_list_iterator_t &other) const;
+  /** Retrieve the batch of elements starting at #idx_. */
+  void fill_batch() const;
 
- private:
-  std::unique_ptr<adapter_base_t> impl_;
+  const string_list_base_t *list_;
+  size_t idx_;
+  mutable size_t batch_start_, batch_size_;
+  mutable const std::string *batch_[BATCH_CAPACITY];
 };
 
 /** Abstract base class for string and file lists and filtered lists. */
@@ -67,10 +92,17 @@ class T3_WIDGET_API string_list_base_t {
   /** Retrieve element @p idx. */
   virtual const std::string &operator[](size_t idx) const = 0;
 
+  /** Retrieve pointers to at most @p count elements, starting at index @p start.
+      This allows bulk access to the list with a single virtual function call. The default
+      implementation uses @c operator[].
+      @return The number of pointers stored in @p items, which is only less than @p count if the
+          end of the list is reached. */
+  virtual size_t get_items(size_t start, size_t count, const std::string **items) const;
+
   virtual connection_t connect_content_changed(std::function<void()> cb) = 0;
 
-  virtual const_string_list_iterator_t begin() const = 0;
-  virtual const_string_list_iterator_t end() const = 0;
+  const_string_list_iterator_t begin() const { return const_string_list_iterator_t(this, 0); }
+  const_string_list_iterator_t end() const { return const_string_list_iterator_t(this, size()); }
 };
 
 /** Abstract base class for file lists. */
@@ -84,6 +116,12 @@ class T3_WIDGET_API file_list_base_t : virtual public string_list_base_t {
   virtual const std::string &get_fs_name(size_t idx) const = 0;
   /** Retrieve whether the file at index @p idx in the list is a directory. */
   virtual bool is_dir(size_t idx) const = 0;
+  /** Retrieve the widths in terminal cells of at most @p count elements, starting at index
+      @p start. The default implementation computes the widths on each call, while file_list_t
+      computes them once when the entries are added.
+      @return The number of widths stored in @p widths, which is only less than @p count if the
+          end of the list is reached. */
+  virtual size_t get_display_widths(size_t start, size_t count, int *widths) const;
 };
 
 /** Abstract base class for filtered string and file lists. */
@@ -93,6 +131,30 @@ class T3_WIDGET_API filtered_string_list_base_t : public virtual string_list_bas
       The filter should return @c true if the item at the index indicated in the second parameter
       should be retained in the list. */
   virtual void set_filter(std::function<bool(const string_list_base_t &, size_t)>) = 0;
+  /** Set a filter that retains only items retained by the current filter.
+      Only the items in the filtered list are tested, which is much cheaper than #set_filter
+      when the filter is made more strict, e.g. when a search prefix is extended by a character.
+      If no filter is set, this is equivalent to #set_filter. */
+  virtual void narrow_filter(std::function<bool(const string_list_base_t &, size_t)> filter) {
+    set_filter(std::move(filter));
+  }
+  /** Allow the filter to be applied using multiple threads for large lists.
+      This must only be enabled if both the filter and @c operator[] of the base list can safely
+      be called from multiple threads concurrently. Disabled by default. */
+  virtual void set_parallel_filter(bool enable) { (void)enable; }
+  /** Set a scoring filter, which orders the list by descending score.
+      The callback should return the score of the item at the index indicated in the second
+      parameter, or #None if the item should not be retained. Items with equal scores retain their
+      order in the base list. If @p max_items is not @c 0, only the @p max_items best scoring items
+      are retained. */
+  virtual void set_scored_filter(std::function<optint(const string_list_base_t &, size_t)> score,
+                                 size_t max_items) = 0;
+  /** Set a scoring filter that retains only items retained by the current filter.
+      This is the scoring equivalent of #narrow_filter. */
+  virtual void narrow_scored_filter(
+      std::function<optint(const string_list_base_t &, size_t)> score, size_t max_items) {
+    set_scored_filter(std::move(score), max_items);
+  }
   /** Reset the filter. */
   virtual void reset_filter() = 0;
 };
@@ -111,17 +173,13 @@ class T3_WIDGET_API string_list_t : public string_list_base_t {
   size_t size() const override;
   void push_back(std::string str);
   const std::string &operator[](size_t idx) const override;
+  size_t get_items(size_t start, size_t count, const std::string **items) const override;
 
   connection_t connect_content_changed(std::function<void()> cb) override;
 
-  const_string_list_iterator_t begin() const override;
-  const_string_list_iterator_t end() const override;
-
  private:
   struct T3_WIDGET_LOCAL implementation_t;
   pimpl_t<implementation_t> impl;
-
-  class T3_WIDGET_LOCAL iterator_adapter_t;
 };
 
 /** Implementation of the file_list_base_t interface. */
@@ -131,23 +189,101 @@ class T3_WIDGET_API file_list_t : public file_list_base_t {
   ~file_list_t() override;
   size_t size() const override;
   const std::string &operator[](size_t idx) const override;
+  size_t get_items(size_t start, size_t count, const std::string **items) const override;
   const std::string &get_fs_name(size_t idx) const override;
   bool is_dir(size_t idx) const override;
-  /** Load the contents of @p dir_name into this list. */
+  size_t get_display_widths(size_t start, size_t count, int *widths) const override;
+  /** Load the contents of @p dir_name into this list.
+      Any background load in progress is cancelled. */
   int load_directory(const std::string &dir_name);
+  /** Start loading the contents of @p dir_name into this list in the background.
+      @return 0 if the directory could be opened, or an @c errno value otherwise. In the latter
+          case, the list is not changed.
+
+      The list is first reduced to the entry for the parent directory. The entries are read on a
+      separate thread, and are merged into the list in batches from the #main_loop, emitting the
+      @c content_changed signal each time. Any previous background load is cancelled. The
+      notification of new batches uses #signal_update.
+
+      Listings of recently loaded directories are cached, in which case the list is filled
+      immediately. While the directory is shown, changes to it are tracked and applied to the
+      list from the #main_loop. Caching is only available on systems supporting inotify. */
+  int load_directory_async(const std::string &dir_name);
+  /** Cancel the background load started by #load_directory_async, if any.
+      Entries already merged into the list remain. */
+  void cancel_load();
+  /** Retrieve whether a background load is still in progress. */
+  bool is_loading() const;
+  /** Retrieve the error that ended reading the directory on the last load, or 0 if there was
+      none. The list then holds the entries read before the error. For a background load, the
+      error is available when the final @c content_changed signal is emitted. */
+  int get_load_error() const;
   /** Compare this list with @p other. */
   file_list_t &operator=(const file_list_t &other);
 
   connection_t connect_content_changed(std::function<void()> cb) override;
 
-  const_string_list_iterator_t begin() const override;
-  const_string_list_iterator_t end() const override;
-
  private:
   struct T3_WIDGET_LOCAL implementation_t;
   pimpl_t<implementation_t> impl;
+};
+
+/** Index of the paths in a directory tree, for completing names in subdirectories.
+
+    The tree is walked in the background by several threads, and the paths found are merged into
+    the index from the #main_loop, similar to file_list_t::load_directory_async. The paths are
+    stored in a single buffer, with sorted indices on the path and on the last path component.
+    This allows looking up the paths starting with a prefix in logarithmic time.
+
+    As a list, the index contains the paths matching the prefix set with #set_query, relative to
+    the root of the tree. First the paths starting with the prefix are listed, followed by the
+    paths of which the last component starts with the prefix. The list is empty if the prefix is
+    empty. When used for autocompletion by a text_field_t, the prefix is set from the text.
+
+    The @c content_changed signal is emitted when new paths change the list, and when indexing
+    finishes.
+*/
+class T3_WIDGET_API file_index_t : public file_list_base_t {
+ public:
+  file_index_t();
+  ~file_index_t() override;
+  size_t size() const override;
+  const std::string &operator[](size_t idx) const override;
+  size_t get_items(size_t start, size_t count, const std::string **items) const override;
+  const std::string &get_fs_name(size_t idx) const override;
+  bool is_dir(size_t idx) const override;
+  size_t get_display_widths(size_t start, size_t count, int *widths) const override;
+
+  /** Start indexing the tree rooted at @p dir_name in the background.
+      @return 0 if the directory could be opened, or an @c errno value otherwise. In the latter
+          case, the index is not changed.
+
+      Any previous index is discarded. Symbolic links to directories are listed, but not
+      followed. Indexing stops when the index holds too many paths. */
+  int start(const std::string &dir_name);
+  /** Stop indexing. Paths already merged into the index remain. */
+  void cancel();
+  /** Retrieve whether the tree is still being indexed. */
+  bool is_indexing() const;
+  /** Retrieve the number of paths in the index. */
+  size_t get_indexed_count() const;
+  /** Set the number of directory levels below the root to index.
+      The default is 8. Takes effect on the next call to #start. */
+  void set_max_depth(int max_depth);
+  /** Set the patterns of names to exclude from the index.
+      The patterns are matched against the individual path components using @c fnmatch. Excluded
+      directories are not descended into. Takes effect on the next call to #start. */
+  void set_ignore_patterns(std::vector<std::string> patterns);
+  /** Set the maximum number of paths listed for a query. The default is 256. */
+  void set_max_results(size_t max_results);
+  /** Set the prefix to look up, and update the list accordingly. */
+  void set_query(string_view prefix);
+
+  connection_t connect_content_changed(std::function<void()> cb) override;
 
-  class T3_WIDGET_LOCAL iterator_adapter_t;
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
 };
 
 std::unique_ptr<filtered_string_list_base_t> new_filtered_string_list(string_list_base_t *list);
@@ -164,5 +300,40 @@ T3_WIDGET_API bool string_compare_filter(const std::string *str, const string_li
 T3_WIDGET_API bool glob_filter(const std::string *str, bool show_hidden,
                                const string_list_base_t &list, size_t idx);
 
+/** Pattern for fuzzy matching of strings.
+
+    A string matches if it contains all characters of the pattern in the same order, but not
+    necessarily adjacent. Matches are scored such that adjacent characters and characters at the
+    start of words and path components score higher. Matching is case insensitive, unless the
+    pattern contains upper case characters.
+*/
+class T3_WIDGET_API fuzzy_pattern_t {
+ public:
+  fuzzy_pattern_t();
+  explicit fuzzy_pattern_t(string_view pattern);
+  ~fuzzy_pattern_t();
+  /** Set the pattern to match. Both the pattern and the matched strings are UTF-8. */
+  void set_pattern(string_view pattern);
+  /** Retrieve the score of @p str, or #None if it does not match.
+      An empty pattern matches all strings with score @c 0. This function may be called from
+      multiple threads concurrently. */
+  optint match(string_view str) const;
+
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
+};
+
+/** Scoring filter function using fuzzy matching, for use with set_scored_filter. */
+/* This uses a pointer and not a reference for pattern, because it is intended to be used with
+   bind_front. */
+T3_WIDGET_API optint fuzzy_filter(const fuzzy_pattern_t *pattern, const string_list_base_t &list,
+                                  size_t idx);
+/** Scoring filter function using fuzzy matching on a file list.
+    Hidden files are only retained if @p show_hidden is @c true. The entry for the parent
+    directory is always retained, and is ordered first. */
+T3_WIDGET_API optint fuzzy_file_filter(const fuzzy_pattern_t *pattern, bool show_hidden,
+                                       const string_list_base_t &list, size_t idx);
+
 }  // namespace t3widget
 #endif
@@ -184,10 +184,10 @@ void dialog_t::set_active_popup(popup_t *popup) {
 
 void dialog_t::update_dialogs() {
   for (dialog_t *active_dialog : dialog_t::active_dialogs) {
-    active_dialog->update_contents();
+    active_dialog->profiled_update_contents();
   }
   if (active_popup) {
-    active_popup->update_contents();
+    active_popup->profiled_update_contents();
   }
 }
 
@@ -37,6 +37,7 @@ typedef std::list<dialog_t *> dialogs_t;
 class T3_WIDGET_API dialog_t : public dialog_base_t {
  private:
   friend void iterate();
+  friend class headless_terminal_t;
   friend bool mouse_target_t::handle_mouse_event(mouse_event_t event);
   // main_window_base_t should be allowed to call dialog_t(), but no others should
   friend class main_window_base_t;
@@ -116,6 +116,7 @@ void dialog_base_t::update_contents() {
     int i, x;
 
     impl->redraw = false;
+    record_redraw(static_cast<long>(window.get_height()) * window.get_width());
     window.set_default_attrs(attributes.dialog);
 
     /* Just clear the whole thing and redraw */
@@ -138,7 +139,7 @@ void dialog_base_t::update_contents() {
   }
 
   for (std::unique_ptr<widget_t> &widget : impl->widgets) {
-    widget->update_contents();
+    widget->profiled_update_contents();
   }
 }
 
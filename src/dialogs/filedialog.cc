@@ -48,6 +48,9 @@ static key_t nul = 0;
 struct file_dialog_t::implementation_t {
   file_list_t names;
   std::unique_ptr<filtered_file_list_base_t> view;
+  /** Index of the subdirectories of #current_dir, used for completion if #recursive_completion is
+      set. */
+  file_index_t index;
   std::string current_dir, lang_codeset_filter;
 
   int name_offset;
@@ -59,10 +62,16 @@ struct file_dialog_t::implementation_t {
   checkbox_t *show_hidden_box;
   smart_label_t *show_hidden_label;
   bool option_widget_set;
+  bool recursive_completion;
   connection_t cancel_button_up_connection, ok_button_up_connection;
   signal_t<const std::string &> file_selected;
 
-  implementation_t() : view(new_filtered_file_list(&names)), option_widget_set(false) {}
+  implementation_t()
+      : view(new_filtered_file_list(&names)),
+        option_widget_set(false),
+        recursive_completion(false) {
+    index.set_ignore_patterns({".git", ".hg", ".svn", "CVS"});
+  }
 };
 /* FIXME: TODO:
         - path-name cleansing ( /foo/../bar -> /bar, ////usr -> /usr etc.)
@@ -94,6 +103,19 @@ file_dialog_t::file_dialog_t(int height, int width, optional<std::string> _title
   impl->file_pane->set_text_field(impl->file_line);
   impl->file_pane->connect_activate([this](const std::string &file) { ok_callback(file); });
   impl->file_pane->set_file_list(impl->view.get());
+  // Reading a directory in the background may fail after it was opened successfully.
+  impl->names.connect_content_changed([this] {
+    if (impl->names.is_loading() || impl->names.get_load_error() == 0) {
+      return;
+    }
+    std::string message = _("Couldn't read directory '");
+    message += impl->current_dir;
+    message += "': ";
+    message += strerror(impl->names.get_load_error());
+    message_dialog->set_message(message);
+    message_dialog->center_over(this);
+    message_dialog->show();
+  });
 
   impl->show_hidden_box = emplace_back<checkbox_t>(false);
   impl->show_hidden_box->set_anchor(impl->file_pane_frame,
@@ -188,14 +210,23 @@ int file_dialog_t::set_from_file(string_view file) {
   impl->current_dir = get_directory(file);
   sanitize_dir(&impl->current_dir);
 
-  result = impl->names.load_directory(impl->current_dir);
+  if ((result = impl->names.load_directory_async(impl->current_dir)) != 0) {
+    /* The directory can not be read, which the synchronous load will also find out quickly. This
+       leaves only the entry for the parent directory in the list. */
+    impl->names.load_directory(impl->current_dir);
+  }
 
   idx = file.rfind('/');
   if (idx != string_view::npos) {
     file.remove_prefix(idx + 1);
   }
 
-  impl->file_line->set_autocomplete(&impl->names);
+  if (impl->recursive_completion) {
+    impl->index.start(impl->current_dir);
+    impl->file_line->set_autocomplete(&impl->index);
+  } else {
+    impl->file_line->set_autocomplete(&impl->names);
+  }
   impl->file_line->set_text(file);
   refresh_view();
   return result;
@@ -234,7 +265,6 @@ void file_dialog_t::ok_callback(const std::string &file) {
 }
 
 void file_dialog_t::change_dir(const std::string &dir) {
-  file_list_t new_names;
   std::string new_dir, file_string;
   int error;
 
@@ -262,8 +292,10 @@ void file_dialog_t::change_dir(const std::string &dir) {
 
   sanitize_dir(&new_dir);
 
-  /* Check whether we can load the dir. If not, show message and don't change state. */
-  if ((error = new_names.load_directory(new_dir)) != 0) {
+  /* Check whether we can load the dir. If not, show message and don't change state. The
+     directory is read in the background, such that large or slow directories do not block the
+     user interface. */
+  if ((error = impl->names.load_directory_async(new_dir)) != 0) {
     std::string message = _("Couldn't change to directory '");
     message += dir.c_str();
     message += "': ";
@@ -274,13 +306,28 @@ void file_dialog_t::change_dir(const std::string &dir) {
     return;
   }
 
-  impl->names = new_names;
   impl->current_dir = new_dir;
+  if (impl->recursive_completion) {
+    impl->index.start(new_dir);
+  }
   impl->view->set_filter(
       bind_front(glob_filter, &get_filter(), impl->show_hidden_box->get_state()));
   impl->file_pane->reset();
 }
 
+void file_dialog_t::set_recursive_completion(bool enable) {
+  impl->recursive_completion = enable;
+  if (enable) {
+    if (!impl->current_dir.empty()) {
+      impl->index.start(impl->current_dir);
+    }
+    impl->file_line->set_autocomplete(&impl->index);
+  } else {
+    impl->index.cancel();
+    impl->file_line->set_autocomplete(&impl->names);
+  }
+}
+
 void file_dialog_t::refresh_view() {
   impl->lang_codeset_filter = convert_lang_codeset(get_filter(), false);
   if (impl->lang_codeset_filter.size() == 0) {
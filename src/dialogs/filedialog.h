@@ -45,6 +45,11 @@ class T3_WIDGET_API file_dialog_t : public dialog_t {
       @returns 0 on success or the value of @c errno on error. */
   virtual int set_from_file(string_view file);
   void refresh_view();
+  /** Set whether the names in subdirectories are offered for completion as well.
+      If enabled, the directory tree is indexed in the background each time the directory is
+      changed, and the text typed is completed with the matching relative paths. The depth of the
+      tree indexed is limited, and version control directories are excluded. */
+  void set_recursive_completion(bool enable);
   void set_options_widget(std::unique_ptr<widget_t> options);
   virtual void reset();
 
@@ -25,7 +25,8 @@
 namespace t3widget {
 
 /* Class which allows storing two separate strings in a single tiny_string_t. This is used by the
-   undo system to store the information for OVERWRITE actions.
+   undo system to store the information for OVERWRITE actions. Use const_double_string_adapter_t
+   to read the strings from stored undo information.
    The layout of the data is as follows:
    - A UTF-8 encoded length of the first string.
    - The first string.
@@ -76,6 +77,29 @@ class double_string_adapter_t {
   size_t first_start_;
 };
 
+/* Read-only version of double_string_adapter_t. */
+class const_double_string_adapter_t {
+ public:
+  const_double_string_adapter_t(string_view str) : str_(str) {
+    if (str_.empty()) {
+      first_size_ = 0;
+      first_start_ = 0;
+    } else {
+      size_t utf8_size = str_.size();
+      first_size_ = t3_utf8_get(str_.data(), &utf8_size);
+      first_start_ = utf8_size;
+    }
+  }
+
+  string_view first() const { return str_.substr(first_start_, first_size_); }
+  string_view second() const { return str_.substr(first_start_ + first_size_); }
+
+ private:
+  string_view str_;
+  size_t first_size_;
+  size_t first_start_;
+};
+
 }  // namespace t3widget
 
 #endif  // T3_WIDGET_DOUBLE_STRING_ADAPTER_H
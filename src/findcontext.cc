@@ -14,6 +14,7 @@
 
 #define PCRE2_CODE_UNIT_WIDTH 8
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <memory>
@@ -24,6 +25,7 @@
 #endif
 #include <string>
 #include <unicase.h>
+#include <vector>
 
 #include "t3widget/findcontext.h"
 #include "t3widget/internal.h"
@@ -105,6 +107,7 @@ class T3_WIDGET_LOCAL regex_finder_t : public finder_base_t {
 
   /** Try to find the previously set @c needle in a string. */
   bool match(const std::string &haystack, find_result_t *result, bool reverse) override;
+  bool match_lines(const line_source_t &lines, find_result_t *result, bool reverse) override;
   /** Retrieve the replacement string. */
   std::string get_replacement(const std::string &) const override;
 
@@ -118,6 +121,43 @@ class T3_WIDGET_LOCAL regex_finder_t : public finder_base_t {
   };
   using unique_pcre_match_data_ptr =
       std::unique_ptr<pcre2_match_data_8, pcre_match_data_free_deleter>;
+#ifndef PCRE_COMPAT
+  struct pcre_match_context_free_deleter {
+    void operator()(pcre2_match_context_8 *p) { pcre2_match_context_free_8(p); }
+  };
+  using unique_pcre_match_context_ptr =
+      std::unique_ptr<pcre2_match_context_8, pcre_match_context_free_deleter>;
+  struct pcre_jit_stack_free_deleter {
+    void operator()(pcre2_jit_stack_8 *p) { pcre2_jit_stack_free_8(p); }
+  };
+  using unique_pcre_jit_stack_ptr = std::unique_ptr<pcre2_jit_stack_8, pcre_jit_stack_free_deleter>;
+#endif
+
+  /** Run a single match attempt of the compiled regex, using the JIT compiled code if available. */
+  int exec(const std::string &haystack, PCRE2_SIZE length, PCRE2_SIZE start, uint32_t pcre_flags,
+           pcre2_match_data_8 *match_data);
+  /** Find the match with the right-most start position in the range [@p start, @p limit).
+      The subject is truncated at @p end. Matches are searched for in windows of exponentially
+      increasing size, working back from @p limit, such that finding a match close to @p limit does
+      not require scanning the whole line. */
+  bool match_last(const std::string &haystack, PCRE2_SIZE start, PCRE2_SIZE limit, PCRE2_SIZE end,
+                  uint32_t pcre_flags);
+
+  /** Append line @p idx to #window_. Returns whether the line is the last line in the range. */
+  bool extend_window(const line_source_t &lines, text_pos_t idx, text_coordinate_t end);
+  /** Remove all lines before the line containing @p offset from #window_.
+      @return The number of bytes removed from the start of #window_. */
+  PCRE2_SIZE trim_window(PCRE2_SIZE offset);
+  /** Convert an offset in #window_ to a text coordinate. */
+  text_coordinate_t window_coordinate(PCRE2_SIZE offset) const;
+  /** Find the first match starting at or after @p start, which starts no later than line
+      @p last_start_line and ends no later than @p end. On success, #match_data_ contains offsets
+      into #window_. */
+  bool match_window(const line_source_t &lines, text_coordinate_t start, text_coordinate_t end,
+                    text_pos_t last_start_line, bool may_not_match_start);
+  /** Find the match with the right-most start in the range [@p start, @p end]. */
+  bool match_window_last(const line_source_t &lines, text_coordinate_t start,
+                         text_coordinate_t end, bool may_not_match_end);
 
   /* PCRE context and data */
   /** Pointer to a compiled regex. */
@@ -126,6 +166,27 @@ class T3_WIDGET_LOCAL regex_finder_t : public finder_base_t {
   unique_pcre_match_data_ptr match_data_;
   /** Structure to hold sub-matches information when searching in reverse. */
   unique_pcre_match_data_ptr local_match_data_;
+#ifndef PCRE_COMPAT
+  /** Match context, re-used for all matches. Holds the JIT stack if JIT compilation succeeded. */
+  unique_pcre_match_context_ptr match_context_;
+  /** Stack used by the JIT compiled code. Allocated once, and grown by PCRE as required. */
+  unique_pcre_jit_stack_ptr jit_stack_;
+#endif
+  /** Boolean indicating whether the regex was successfully JIT compiled. */
+  bool jit_compiled_ = false;
+
+  /** Concatenation of the lines currently considered for a multi-line match, each but the last
+      followed by a newline. */
+  std::string window_;
+  /** Offsets in #window_ of the starts of the lines it contains. */
+  std::vector<PCRE2_SIZE> window_line_starts_;
+  /** Line number of the first line in #window_. */
+  text_pos_t window_first_line_ = 0;
+  /** Boolean indicating whether the last line in #window_ was truncated at the end of the range. */
+  bool window_truncated_ = false;
+  /** Boolean indicating whether #match_data_ holds offsets into #window_, rather than into the
+      haystack passed to #match. */
+  bool multi_line_match_ = false;
 
   /** The number of sub-matches captured. */
   int captures_;
@@ -134,10 +195,61 @@ class T3_WIDGET_LOCAL regex_finder_t : public finder_base_t {
 //================================= finder_t implementation ========================================
 finder_t::~finder_t() {}
 
+finder_t::line_source_t::~line_source_t() {}
+
+/** Clamp the range [@p start, @p end] to the text provided by @p lines.
+    @return @c false if the range is empty. */
+static bool clamp_range(const finder_t::line_source_t &lines, text_coordinate_t *start,
+                        text_coordinate_t *end) {
+  if (lines.size() == 0) {
+    return false;
+  }
+  if (start->line < 0) {
+    *start = text_coordinate_t(0, -1);
+  }
+  if (end->line >= lines.size()) {
+    *end = text_coordinate_t(lines.size() - 1, -1);
+  }
+  if (start->line > end->line) {
+    return false;
+  }
+  const text_pos_t start_line_size = static_cast<text_pos_t>(lines.get_line(start->line).size());
+  if (start->pos > start_line_size) {
+    start->pos = start_line_size;
+  }
+  if (end->pos > static_cast<text_pos_t>(lines.get_line(end->line).size())) {
+    end->pos = -1;
+  }
+  return !(start->line == end->line && end->pos >= 0 && start->pos > end->pos);
+}
+
+bool finder_t::match_lines(const line_source_t &lines, find_result_t *result, bool reverse) {
+  text_coordinate_t start = result->start;
+  text_coordinate_t end = result->end;
+
+  if (!clamp_range(lines, &start, &end)) {
+    return false;
+  }
+
+  for (text_pos_t i = 0; i <= end.line - start.line; ++i) {
+    text_pos_t idx = reverse ? end.line - i : start.line + i;
+    result->start.pos = idx == start.line ? start.pos : -1;
+    result->end.pos = idx == end.line ? end.pos : -1;
+    if (match(lines.get_line(idx), result, reverse)) {
+      result->start.line = result->end.line = idx;
+      return true;
+    }
+  }
+  return false;
+}
+
 std::unique_ptr<finder_t> finder_t::create(const std::string &needle, int flags,
                                            std::string *error_message,
                                            const std::string *replacement) {
   std::unique_ptr<finder_base_t> result;
+  if (!(flags & find_flags_t::REGEX)) {
+    flags &= ~find_flags_t::MULTI_LINE;
+  }
   if (flags & find_flags_t::REGEX) {
     result = t3widget::make_unique<regex_finder_t>(flags, replacement);
   } else {
@@ -331,6 +443,9 @@ bool regex_finder_t::set_needle(const std::string &needle, std::string *error_me
   if (flags_ & find_flags_t::ICASE) {
     pcre_flags |= PCRE2_CASELESS;
   }
+  if (flags_ & find_flags_t::MULTI_LINE) {
+    pcre_flags |= PCRE2_MULTILINE;
+  }
 
   regex_.reset(pcre2_compile_8(reinterpret_cast<PCRE2_SPTR8>(pattern.c_str()), pattern.size(),
                                pcre_flags, &error_code, &error_offset, nullptr));
@@ -354,10 +469,100 @@ bool regex_finder_t::set_needle(const std::string &needle, std::string *error_me
     *error_message = "Out of memory";
     return false;
   }
+#ifdef PCRE_COMPAT
+  /* The compatibility layer only studies the pattern, which is always safe to use with the
+     regular matching function. */
   pcre2_jit_compile_8(regex_.get(), PCRE2_JIT_COMPLETE);
+#else
+  /* JIT compilation may fail if the library was built without JIT support, or if the pattern
+     can not be JIT compiled. In that case we silently fall back to the interpreter. */
+  jit_compiled_ =
+      pcre2_jit_compile_8(regex_.get(), flags_ & find_flags_t::MULTI_LINE
+                                            ? PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_HARD
+                                            : PCRE2_JIT_COMPLETE) == 0;
+  if (jit_compiled_) {
+    match_context_.reset(pcre2_match_context_create_8(nullptr));
+    jit_stack_.reset(pcre2_jit_stack_create_8(32 * 1024, 1024 * 1024, nullptr));
+    if (match_context_ == nullptr || jit_stack_ == nullptr) {
+      /* Without a context or stack, the JIT code can still be used, but only with the small
+         default stack on the machine stack. */
+      match_context_.reset();
+      jit_stack_.reset();
+    } else {
+      pcre2_jit_stack_assign_8(match_context_.get(), nullptr, jit_stack_.get());
+    }
+  }
+#endif
   return true;
 }
 
+int regex_finder_t::exec(const std::string &haystack, PCRE2_SIZE length, PCRE2_SIZE start,
+                         uint32_t pcre_flags, pcre2_match_data_8 *match_data) {
+#ifndef PCRE_COMPAT
+  if (jit_compiled_) {
+    /* The JIT fast path skips the option and UTF validity checks, which are not needed because
+       the text in the buffer is always valid UTF-8. */
+    int result = pcre2_jit_match_8(regex_.get(), reinterpret_cast<PCRE2_SPTR8>(haystack.data()),
+                                   length, start, pcre_flags & ~PCRE2_NO_UTF_CHECK, match_data,
+                                   match_context_.get());
+    if (result != PCRE2_ERROR_JIT_STACKLIMIT) {
+      return result;
+    }
+    /* The JIT stack was exhausted. The interpreter uses the heap, with much larger limits. */
+    pcre_flags |= PCRE2_NO_JIT;
+  }
+  return pcre2_match_8(regex_.get(), reinterpret_cast<PCRE2_SPTR8>(haystack.data()), length, start,
+                       pcre_flags, match_data, match_context_.get());
+#else
+  return pcre2_match_8(regex_.get(), reinterpret_cast<PCRE2_SPTR8>(haystack.data()), length, start,
+                       pcre_flags, match_data, nullptr);
+#endif
+}
+
+bool regex_finder_t::match_last(const std::string &haystack, PCRE2_SIZE start, PCRE2_SIZE limit,
+                                PCRE2_SIZE end, uint32_t pcre_flags) {
+  PCRE2_SIZE window_size = 256;
+
+  while (limit > start) {
+    PCRE2_SIZE window_start = limit - start > window_size ? limit - window_size : start;
+    // Never start a match attempt in the middle of a UTF-8 character.
+    while (window_start > start && (haystack[window_start] & 0xc0) == 0x80) {
+      --window_start;
+    }
+
+    /* Collect the match with the right-most start in the window. Each subsequent attempt starts
+       one character after the start of the previous match, which means that overlapping matches
+       are considered as well. */
+    bool found_in_window = false;
+    PCRE2_SIZE pos = window_start;
+    while (pos < limit) {
+      int match_result = exec(haystack, end, pos, pcre_flags, local_match_data_.get());
+      if (match_result < 0) {
+        break;
+      }
+      const PCRE2_SIZE match_start = pcre2_get_ovector_pointer_8(local_match_data_.get())[0];
+      if (match_start >= limit) {
+        break;
+      }
+      std::swap(match_data_, local_match_data_);
+      captures_ = match_result;
+      found_in_window = true;
+
+      PCRE2_SIZE new_pos = text_line_t::adjust_position(haystack, match_start, 1);
+      if (new_pos == match_start) {
+        break;
+      }
+      pos = new_pos;
+    }
+    if (found_in_window) {
+      return true;
+    }
+    limit = window_start;
+    window_size *= 2;
+  }
+  return false;
+}
+
 bool regex_finder_t::match(const std::string &haystack, find_result_t *result, bool reverse) {
   int match_result;
 
@@ -367,6 +572,7 @@ bool regex_finder_t::match(const std::string &haystack, find_result_t *result, b
 
   int pcre_flags = PCRE2_NO_UTF_CHECK;
   found_ = false;
+  multi_line_match_ = false;
 
   PCRE2_SIZE start;
   PCRE2_SIZE end;
@@ -400,35 +606,12 @@ bool regex_finder_t::match(const std::string &haystack, find_result_t *result, b
         return false;
       }
     }
-    while (start <= end) {
-      match_result = pcre2_match_8(regex_.get(), reinterpret_cast<PCRE2_SPTR8>(haystack.data()),
-                                   end, start, pcre_flags, local_match_data_.get(), nullptr);
-      if (match_result < 0) {
-        break;
-      }
-      const PCRE2_SIZE *local_ovector = pcre2_get_ovector_pointer_8(local_match_data_.get());
-      const PCRE2_SIZE match_end = local_ovector[1];
-      const bool found_this_iteration = may_not_match_end ? local_ovector[0] != end : true;
-      found_ |= found_this_iteration;
-      if (found_this_iteration) {
-        std::swap(match_data_, local_match_data_);
-        captures_ = match_result;
-      }
-      if (start == match_end) {
-        PCRE2_SIZE new_start = text_line_t::adjust_position(haystack, start, 1);
-        if (new_start == start) {
-          break;
-        }
-        start = new_start;
-      } else {
-        start = text_pos_t(match_end);
-      }
-      pcre_flags |= PCRE2_NOTBOL;
-    }
+    /* A match starting exactly at the end point is only allowed if the caller indicated it may
+       match there. */
+    found_ = match_last(haystack, start, may_not_match_end ? end : end + 1, end, pcre_flags);
   } else {
     while (!found_ && start <= end) {
-      match_result = pcre2_match_8(regex_.get(), reinterpret_cast<PCRE2_SPTR8>(haystack.data()),
-                                   end, start, pcre_flags, match_data_.get(), nullptr);
+      match_result = exec(haystack, end, start, pcre_flags, match_data_.get());
       captures_ = match_result;
       if (match_result < 0) {
         break;
@@ -457,7 +640,230 @@ bool regex_finder_t::match(const std::string &haystack, find_result_t *result, b
   return true;
 }
 
+bool regex_finder_t::extend_window(const line_source_t &lines, text_pos_t idx,
+                                   text_coordinate_t end) {
+  const std::string &line = lines.get_line(idx);
+  window_line_starts_.push_back(window_.size());
+  if (idx == end.line) {
+    window_truncated_ = end.pos >= 0 && static_cast<size_t>(end.pos) < line.size();
+    window_.append(line, 0, window_truncated_ ? end.pos : line.size());
+    return true;
+  }
+  window_ += line;
+  window_ += '\n';
+  return false;
+}
+
+PCRE2_SIZE regex_finder_t::trim_window(PCRE2_SIZE offset) {
+  auto first_kept = std::upper_bound(window_line_starts_.begin(), window_line_starts_.end(), offset);
+  --first_kept;
+  const PCRE2_SIZE removed = *first_kept;
+  if (removed == 0) {
+    return 0;
+  }
+  window_first_line_ += first_kept - window_line_starts_.begin();
+  window_line_starts_.erase(window_line_starts_.begin(), first_kept);
+  for (PCRE2_SIZE &line_start : window_line_starts_) {
+    line_start -= removed;
+  }
+  window_.erase(0, removed);
+  return removed;
+}
+
+text_coordinate_t regex_finder_t::window_coordinate(PCRE2_SIZE offset) const {
+  if (offset == static_cast<PCRE2_SIZE>(window_.size()) && !window_.empty() && window_.back() == '\n' &&
+      !window_truncated_) {
+    // The end of a match which includes the newline of the last line in the window.
+    return text_coordinate_t(window_first_line_ + window_line_starts_.size(), 0);
+  }
+  auto line = std::upper_bound(window_line_starts_.begin(), window_line_starts_.end(), offset);
+  --line;
+  return text_coordinate_t(window_first_line_ + (line - window_line_starts_.begin()),
+                           offset - *line);
+}
+
+/* Matches that keep extending past the end of the window are cut off at this size, to prevent
+   patterns like [\s\S]* from pulling in the whole text. */
+static const size_t max_window_size = 1 << 20;
+
+bool regex_finder_t::match_window(const line_source_t &lines, text_coordinate_t start,
+                                  text_coordinate_t end, text_pos_t last_start_line,
+                                  bool may_not_match_start) {
+  window_.clear();
+  window_line_starts_.clear();
+  window_first_line_ = start.line;
+  window_truncated_ = false;
+  text_pos_t next_line = start.line;
+  bool complete = extend_window(lines, next_line++, end);
+  PCRE2_SIZE offset = std::max<text_pos_t>(0, start.pos);
+
+  while (true) {
+    uint32_t pcre_flags = PCRE2_NO_UTF_CHECK;
+    if (window_truncated_) {
+      pcre_flags |= PCRE2_NOTEOL;
+    }
+    const bool partial = !complete && window_.size() < max_window_size;
+    if (partial) {
+      /* If the match can only be determined by looking at the following lines, PCRE will report
+         a partial match. The window is then extended by one line, and the match retried. */
+      pcre_flags |= PCRE2_PARTIAL_HARD;
+    }
+
+    int match_result = exec(window_, window_.size(), offset, pcre_flags, match_data_.get());
+    const PCRE2_SIZE *ovector = pcre2_get_ovector_pointer_8(match_data_.get());
+    if (match_result >= 0) {
+      if (window_coordinate(ovector[0]).line > last_start_line) {
+        return false;
+      }
+      if (may_not_match_start && ovector[0] == offset && ovector[1] == offset) {
+        may_not_match_start = false;
+        PCRE2_SIZE new_offset = text_line_t::adjust_position(window_, offset, 1);
+        if (new_offset == offset) {
+          return false;
+        }
+        offset = new_offset;
+        continue;
+      }
+      captures_ = match_result;
+      return true;
+    } else if (match_result == PCRE2_ERROR_PARTIAL) {
+      if (window_coordinate(ovector[0]).line > last_start_line) {
+        return false;
+      }
+      /* No match can start before the start of the partial match, so lines before the line in
+         which it starts are no longer needed. */
+      offset = ovector[0];
+      PCRE2_SIZE removed = trim_window(offset);
+      if (removed > 0) {
+        offset -= removed;
+        may_not_match_start = false;
+      }
+      complete = extend_window(lines, next_line++, end);
+    } else if (match_result == PCRE2_ERROR_NOMATCH && !complete && next_line <= last_start_line) {
+      // Nothing starts in the current window: continue with a new window on the next line.
+      window_.clear();
+      window_line_starts_.clear();
+      window_first_line_ = next_line;
+      complete = extend_window(lines, next_line++, end);
+      offset = 0;
+      may_not_match_start = false;
+    } else {
+      return false;
+    }
+  }
+}
+
+bool regex_finder_t::match_window_last(const line_source_t &lines, text_coordinate_t start,
+                                       text_coordinate_t end, bool may_not_match_end) {
+  if (local_match_data_ == nullptr) {
+    local_match_data_.reset(pcre2_match_data_create_from_pattern_8(regex_.get(), nullptr));
+    if (local_match_data_ == nullptr) {
+      return false;
+    }
+  }
+
+  for (text_pos_t line = end.line; line >= start.line; --line) {
+    text_coordinate_t from(line, line == start.line ? std::max<text_pos_t>(0, start.pos) : 0);
+    /* Matching is restricted to matches starting on this line, which ensures that each line is
+       only considered once. On success, the window starts with this line. */
+    if (!match_window(lines, from, end, line, false)) {
+      continue;
+    }
+    text_coordinate_t last_start =
+        window_coordinate(pcre2_get_ovector_pointer_8(match_data_.get())[0]);
+    if (may_not_match_end && last_start == end) {
+      continue;
+    }
+
+    /* Collect the right-most start of a match starting on this line. Each subsequent attempt
+       starts one character after the start of the previous match, in the same window. The
+       last match found is kept in #match_data_. */
+    while (true) {
+      const PCRE2_SIZE line_end =
+          window_line_starts_.size() > 1 ? window_line_starts_[1] - 1 : window_.size();
+      if (static_cast<PCRE2_SIZE>(last_start.pos) >= line_end) {
+        break;
+      }
+      uint32_t pcre_flags = PCRE2_NO_UTF_CHECK;
+      if (window_truncated_) {
+        pcre_flags |= PCRE2_NOTEOL;
+      }
+      const text_pos_t window_last_line = window_first_line_ + window_line_starts_.size() - 1;
+      if (window_last_line < end.line && window_.size() < max_window_size) {
+        pcre_flags |= PCRE2_PARTIAL_HARD;
+      }
+      PCRE2_SIZE offset = text_line_t::adjust_position(window_, last_start.pos, 1);
+      int match_result = exec(window_, window_.size(), offset, pcre_flags, local_match_data_.get());
+      if (match_result == PCRE2_ERROR_PARTIAL) {
+        if (window_coordinate(pcre2_get_ovector_pointer_8(local_match_data_.get())[0]).line >
+            line) {
+          break;
+        }
+        /* Determining the match requires more lines. This rebuilds the window, so the match
+           found last has to be matched again if there is no further match. */
+        if (!match_window(lines, text_coordinate_t(line, offset), end, line, false)) {
+          return match_window(lines, last_start, end, line, false);
+        }
+        text_coordinate_t match_start =
+            window_coordinate(pcre2_get_ovector_pointer_8(match_data_.get())[0]);
+        if (may_not_match_end && match_start == end) {
+          return match_window(lines, last_start, end, line, false);
+        }
+        last_start = match_start;
+        continue;
+      }
+      if (match_result < 0) {
+        break;
+      }
+      text_coordinate_t match_start =
+          window_coordinate(pcre2_get_ovector_pointer_8(local_match_data_.get())[0]);
+      if (match_start.line > line || (may_not_match_end && match_start == end)) {
+        break;
+      }
+      std::swap(match_data_, local_match_data_);
+      captures_ = match_result;
+      last_start = match_start;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool regex_finder_t::match_lines(const line_source_t &lines, find_result_t *result,
+                                 bool reverse) {
+  if (!(flags_ & find_flags_t::MULTI_LINE)) {
+    return finder_t::match_lines(lines, result, reverse);
+  }
+
+  if (!(flags_ & find_flags_t::VALID)) {
+    return false;
+  }
+
+  text_coordinate_t start = result->start;
+  text_coordinate_t end = result->end;
+  if (!clamp_range(lines, &start, &end)) {
+    return false;
+  }
+
+  multi_line_match_ = true;
+  if (reverse) {
+    found_ = match_window_last(lines, start, end, end.pos >= 0);
+  } else {
+    found_ = match_window(lines, start, end, end.line, start.pos >= 0);
+  }
+  if (!found_) {
+    return false;
+  }
+  const PCRE2_SIZE *ovector = pcre2_get_ovector_pointer_8(match_data_.get());
+  result->start = window_coordinate(ovector[0]);
+  result->end = window_coordinate(ovector[1]);
+  return true;
+}
+
 std::string regex_finder_t::get_replacement(const std::string &haystack) const {
+  /* For multi-line matches, the captured sub-matches refer to the window rather than to a single
+     line. */
+  const std::string &subject = multi_line_match_ ? window_ : haystack;
   std::string retval(*replacement_);
   /* Replace the following strings with the matched items:
      EDA481 - EDA489. */
@@ -471,7 +877,7 @@ std::string regex_finder_t::get_replacement(const std::string &haystack) const {
     }
     int capture_nr = retval[pos + 2] & 0x7f;
     if (captures_ > capture_nr) {
-      retval.replace(pos, 3, haystack.data() + ovector[2 * capture_nr],
+      retval.replace(pos, 3, subject.data() + ovector[2 * capture_nr],
                      ovector[2 * capture_nr + 1] - ovector[2 * capture_nr]);
     } else {
       retval.erase(pos, 3);
@@ -23,8 +23,9 @@
 namespace t3widget {
 
 /** A struct holding the result of a find operation.
-    In the current situation, find operations work on a single line. Therefore
-    this struct does not contain line references.
+    For single line find operations (finder_t::match), the line numbers are not used. Multi-line
+    find operations (finder_t::match_lines) set the line numbers of both the start and end of the
+    match, which may differ.
 */
 struct T3_WIDGET_API find_result_t {
   text_coordinate_t start, end;
@@ -46,6 +47,31 @@ class T3_WIDGET_API finder_t {
       negative position. Note the the line numbers are ignored.
   */
   virtual bool match(const std::string &haystack, find_result_t *result, bool reverse) = 0;
+
+  /** Interface through which match_lines retrieves the lines of text to search. */
+  class T3_WIDGET_API line_source_t {
+   public:
+    virtual ~line_source_t();
+    /** Retrieve the number of lines in the text. */
+    virtual text_pos_t size() const = 0;
+    /** Retrieve a line of text. @p idx is guaranteed to be in the range [0, size()). */
+    virtual const std::string &get_line(text_pos_t idx) const = 0;
+  };
+
+  /** Try to find the previously set @c needle in a sequence of lines.
+
+      The search is limited to the range [@p result->start, @p result->end]. A negative @c pos
+      member indicates the start respectively the end of the line, while an @c end.line past the
+      last line indicates the end of the text. As with #match, an empty match at an explicitly
+      given start point (or, in reverse, any match starting at an explicitly given end point) is
+      not returned. When searching in reverse, the match with the right-most start is returned.
+
+      Only finders created with find_flags_t::MULTI_LINE will find matches spanning multiple
+      lines. Lines are requested from @p lines on demand, such that only the lines covered by a
+      (potential) match need to be held at the same time. The default implementation calls #match
+      on each line separately.
+  */
+  virtual bool match_lines(const line_source_t &lines, find_result_t *result, bool reverse);
   /** Retrieve the flags set when setting the search context. */
   virtual int get_flags() const = 0;
   /** Retrieve the replacement string. */
@@ -58,7 +84,8 @@ class T3_WIDGET_API finder_t {
       @return A new finder_t subclass instance or @c nullptr on failure.
 
       For regular expression searches, the replacement string may contain references of the form \\0
-      .. \\9. */
+      .. \\9. The find_flags_t::MULTI_LINE flag is only supported for regular expression searches,
+      and is ignored otherwise. */
   static std::unique_ptr<finder_t> create(const std::string &needle, int flags,
                                           std::string *error_message,
                                           const std::string *replacement = nullptr);
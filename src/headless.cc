@@ -0,0 +1,928 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <system_error>
+#include <t3window/terminal.h>
+#include <t3window/utf8.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "t3widget/dialogs/dialog.h"
+#include "t3widget/headless.h"
+#include "t3widget/internal.h"
+#include "t3widget/key.h"
+#include "t3widget/util.h"
+
+namespace t3widget {
+
+/** Prefix of the application program command string used to mark the end of an update. The
+    string is removed from the recorded output when it is encountered. */
+static const char sync_marker[] = "t3widget-sync ";
+
+/** Unicode equivalents of the DEC special graphics characters 0x5F through 0x7E. */
+static const char *const acs_map[] = {
+    " ", "◆", "▒", "␉", "␌", "␍", "␊", "°", "±", "␤", "␋", "┘", "┐", "┌", "└", "┼",
+    "⎺", "⎻", "─", "⎼", "⎽", "├", "┤", "┴", "┬", "│", "≤", "≥", "π", "≠", "£", "·"};
+
+struct headless_terminal_t::implementation_t {
+  /** A single character cell of the terminal. */
+  struct cell_t {
+    /** The UTF-8 text of the cell. Empty for the second cell of a double width character. */
+    std::string text;
+    t3_attr_t attr;
+    cell_t() : text(" "), attr(0) {}
+    explicit cell_t(t3_attr_t _attr) : text(" "), attr(_attr) {}
+  };
+  typedef std::vector<cell_t> line_t;
+
+  enum parse_state_t { GROUND, ESCAPE, ESCAPE_CHARSET, ESCAPE_IGNORE, CSI, STRING, STRING_ESCAPE };
+
+  int master_fd = -1, slave_fd = -1;
+  /** Pipe used to make the reader thread stop. */
+  int wakeup_pipe[2] = {-1, -1};
+  std::thread reader;
+
+  /** Protects all members below, which are accessed by the reader thread. */
+  mutable std::mutex lock;
+  std::condition_variable synced_cond;
+  unsigned sync_sent = 0, sync_received = 0;
+  bool reader_done = false;
+
+  std::string output;
+
+  int height, width;
+  std::vector<line_t> lines, saved_lines;
+  int cursor_line = 0, cursor_column = 0;
+  /** Set when a character was written in the last column, and the next character should be put
+      on the next line. */
+  bool wrap_pending = false;
+  bool cursor_visible = true;
+  bool alternate_screen = false;
+  int scroll_top = 0, scroll_bottom;
+  t3_attr_t attr = 0;
+  /** Whether G0 and G1 designate the DEC special graphics set, and whether G1 is selected. */
+  bool graphics_charset[2] = {false, false};
+  int active_charset = 0;
+  int saved_line = 0, saved_column = 0;
+  t3_attr_t saved_attr = 0;
+  std::string last_char;
+
+  parse_state_t state = GROUND;
+  /** Start of the current escape sequence in #output. */
+  size_t sequence_start = 0;
+  std::vector<int> params;
+  bool have_param = false;
+  char private_marker = 0;
+  char string_type = 0;
+  std::string string_data;
+  std::string utf8_buffer;
+  size_t utf8_expected = 0;
+
+  implementation_t(int _height, int _width)
+      : height(_height),
+        width(_width),
+        lines(_height, line_t(_width)),
+        scroll_bottom(_height - 1) {}
+
+  bool open_terminal();
+  void read_output();
+  void process(char c);
+  void process_control(char c);
+  void process_escape(char c);
+  void process_csi(char c);
+  void process_string_end();
+  void process_sgr();
+  void put_char(uint32_t c, const char *text, size_t size);
+
+  int param(size_t idx, int dflt) const {
+    return idx < params.size() && params[idx] > 0 ? params[idx] : dflt;
+  }
+  void set_cursor(int line, int column) {
+    cursor_line = std::max(0, std::min(line, height - 1));
+    cursor_column = std::max(0, std::min(column, width - 1));
+    wrap_pending = false;
+  }
+  cell_t blank() const { return cell_t(attr & T3_ATTR_BG_MASK); }
+  void erase(int line, int from, int to) {
+    from = std::max(0, from);
+    to = std::min(width, to);
+    for (int i = from; i < to; ++i) {
+      lines[line][i] = blank();
+    }
+  }
+  void scroll_up(int top, int count) {
+    count = std::min(count, scroll_bottom - top + 1);
+    if (count <= 0) {
+      return;
+    }
+    lines.erase(lines.begin() + top, lines.begin() + top + count);
+    lines.insert(lines.begin() + scroll_bottom - count + 1, count, line_t(width, blank()));
+  }
+  void scroll_down(int top, int count) {
+    count = std::min(count, scroll_bottom - top + 1);
+    if (count <= 0) {
+      return;
+    }
+    lines.erase(lines.begin() + scroll_bottom - count + 1, lines.begin() + scroll_bottom + 1);
+    lines.insert(lines.begin() + top, count, line_t(width, blank()));
+  }
+  void line_feed() {
+    wrap_pending = false;
+    if (cursor_line == scroll_bottom) {
+      scroll_up(scroll_top, 1);
+    } else if (cursor_line < height - 1) {
+      ++cursor_line;
+    }
+  }
+  void reverse_line_feed() {
+    wrap_pending = false;
+    if (cursor_line == scroll_top) {
+      scroll_down(scroll_top, 1);
+    } else if (cursor_line > 0) {
+      --cursor_line;
+    }
+  }
+  void set_size(int new_height, int new_width);
+};
+
+headless_terminal_t::headless_terminal_t(int height, int width)
+    : impl(new implementation_t(height, width)) {}
+
+headless_terminal_t::~headless_terminal_t() {
+  if (impl->reader.joinable()) {
+    char c = 0;
+    nosig_write(impl->wakeup_pipe[1], &c, 1);
+    impl->reader.join();
+  }
+  for (int fd : {impl->slave_fd, impl->master_fd, impl->wakeup_pipe[0], impl->wakeup_pipe[1]}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool headless_terminal_t::implementation_t::open_terminal() {
+  struct winsize size;
+  struct termios attrs;
+  const char *slave_name;
+
+  if ((master_fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master_fd) < 0 ||
+      unlockpt(master_fd) < 0 || (slave_name = ptsname(master_fd)) == nullptr ||
+      (slave_fd = open(slave_name, O_RDWR | O_NOCTTY)) < 0 || pipe(wakeup_pipe) < 0) {
+    return false;
+  }
+  fcntl(master_fd, F_SETFD, FD_CLOEXEC);
+  fcntl(slave_fd, F_SETFD, FD_CLOEXEC);
+
+  memset(&size, 0, sizeof(size));
+  size.ws_row = height;
+  size.ws_col = width;
+  if (ioctl(master_fd, TIOCSWINSZ, &size) < 0 || tcgetattr(slave_fd, &attrs) < 0) {
+    return false;
+  }
+  /* Start out with a raw terminal, such that the recorded output is exactly what was written and
+     input is never echoed back into it. */
+  cfmakeraw(&attrs);
+  return tcsetattr(slave_fd, TCSANOW, &attrs) == 0;
+}
+
+std::unique_ptr<headless_terminal_t> headless_terminal_t::create(int height, int width) {
+  std::unique_ptr<headless_terminal_t> result(
+      new headless_terminal_t(std::max(height, 1), std::max(width, 1)));
+  implementation_t *impl = result->impl.get();
+
+  if (!impl->open_terminal()) {
+    int saved_errno = errno;
+    result.reset();
+    errno = saved_errno;
+    return nullptr;
+  }
+
+  try {
+    impl->reader = std::thread(&implementation_t::read_output, impl);
+  } catch (std::system_error &e) {
+    result.reset();
+    errno = e.code().value();
+    return nullptr;
+  }
+  return result;
+}
+
+void headless_terminal_t::implementation_t::read_output() {
+  char buffer[4096];
+  struct pollfd fds[2];
+
+  fds[0].fd = master_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = wakeup_pipe[0];
+  fds[1].events = POLLIN;
+
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+    if (fds[0].revents == 0) {
+      continue;
+    }
+    ssize_t bytes_read = read(master_fd, buffer, sizeof(buffer));
+    if (bytes_read < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (bytes_read <= 0) {
+      break;
+    }
+
+    std::unique_lock<std::mutex> l(lock);
+    for (ssize_t i = 0; i < bytes_read; ++i) {
+      output.push_back(buffer[i]);
+      process(buffer[i]);
+    }
+  }
+
+  std::unique_lock<std::mutex> l(lock);
+  reader_done = true;
+  synced_cond.notify_all();
+}
+
+void headless_terminal_t::implementation_t::process(char c) {
+  unsigned char uc = static_cast<unsigned char>(c);
+
+  switch (state) {
+    case GROUND:
+      break;
+    case ESCAPE:
+      process_escape(c);
+      return;
+    case ESCAPE_CHARSET:
+      graphics_charset[string_type == '(' ? 0 : 1] = c == '0';
+      state = GROUND;
+      return;
+    case ESCAPE_IGNORE:
+      state = GROUND;
+      return;
+    case CSI:
+      if (c >= '0' && c <= '9') {
+        if (!have_param) {
+          params.push_back(0);
+          have_param = true;
+        }
+        params.back() = std::min(params.back() * 10 + (c - '0'), 65535);
+      } else if (c == ';' || c == ':') {
+        if (!have_param) {
+          params.push_back(0);
+        }
+        have_param = false;
+      } else if (c >= '<' && c <= '?' && params.empty() && !have_param) {
+        private_marker = c;
+      } else if (uc >= 0x40 && uc <= 0x7e) {
+        process_csi(c);
+        state = GROUND;
+      } else if (uc < 0x20) {
+        process_control(c);
+      }
+      // Intermediate bytes are ignored.
+      return;
+    case STRING:
+      if (c == '\033') {
+        state = STRING_ESCAPE;
+      } else if (c == '\a') {
+        process_string_end();
+        state = GROUND;
+      } else {
+        string_data.push_back(c);
+      }
+      return;
+    case STRING_ESCAPE:
+      if (c == '\\') {
+        process_string_end();
+        state = GROUND;
+      } else {
+        string_data.push_back('\033');
+        string_data.push_back(c);
+        state = STRING;
+      }
+      return;
+  }
+
+  if (uc < 0x20 || uc == 0x7f) {
+    utf8_buffer.clear();
+    process_control(c);
+    return;
+  }
+
+  if (utf8_buffer.empty()) {
+    if (uc < 0x80) {
+      put_char(uc, &c, 1);
+      return;
+    } else if ((uc & 0xe0) == 0xc0) {
+      utf8_expected = 2;
+    } else if ((uc & 0xf0) == 0xe0) {
+      utf8_expected = 3;
+    } else if ((uc & 0xf8) == 0xf0) {
+      utf8_expected = 4;
+    } else {
+      put_char(0xfffd, "\xef\xbf\xbd", 3);
+      return;
+    }
+    utf8_buffer.push_back(c);
+    return;
+  }
+
+  if ((uc & 0xc0) != 0x80) {
+    utf8_buffer.clear();
+    put_char(0xfffd, "\xef\xbf\xbd", 3);
+    process(c);
+    return;
+  }
+  utf8_buffer.push_back(c);
+  if (utf8_buffer.size() == utf8_expected) {
+    size_t size = utf8_buffer.size();
+    uint32_t value = t3_utf8_get(utf8_buffer.data(), &size);
+    put_char(value, utf8_buffer.data(), utf8_buffer.size());
+    utf8_buffer.clear();
+  }
+}
+
+void headless_terminal_t::implementation_t::process_control(char c) {
+  switch (c) {
+    case '\033':
+      sequence_start = output.size() - 1;
+      state = ESCAPE;
+      break;
+    case '\b':
+      if (cursor_column > 0) {
+        --cursor_column;
+      }
+      wrap_pending = false;
+      break;
+    case '\t':
+      set_cursor(cursor_line, (cursor_column / 8 + 1) * 8);
+      break;
+    case '\n':
+    case '\v':
+    case '\f':
+      line_feed();
+      break;
+    case '\r':
+      cursor_column = 0;
+      wrap_pending = false;
+      break;
+    case '\016':
+      active_charset = 1;
+      break;
+    case '\017':
+      active_charset = 0;
+      break;
+    default:
+      break;
+  }
+}
+
+void headless_terminal_t::implementation_t::process_escape(char c) {
+  state = GROUND;
+  switch (c) {
+    case '[':
+      params.clear();
+      have_param = false;
+      private_marker = 0;
+      state = CSI;
+      break;
+    case ']':
+    case 'P':
+    case '_':
+    case '^':
+    case 'X':
+      string_type = c;
+      string_data.clear();
+      state = STRING;
+      break;
+    case '(':
+    case ')':
+      string_type = c;
+      state = ESCAPE_CHARSET;
+      break;
+    case '*':
+    case '+':
+    case '#':
+    case '%':
+    case ' ':
+      state = ESCAPE_IGNORE;
+      break;
+    case '7':
+      saved_line = cursor_line;
+      saved_column = cursor_column;
+      saved_attr = attr;
+      break;
+    case '8':
+      set_cursor(saved_line, saved_column);
+      attr = saved_attr;
+      break;
+    case 'D':
+      line_feed();
+      break;
+    case 'E':
+      cursor_column = 0;
+      line_feed();
+      break;
+    case 'M':
+      reverse_line_feed();
+      break;
+    case 'c':
+      attr = 0;
+      for (line_t &line : lines) {
+        std::fill(line.begin(), line.end(), cell_t());
+      }
+      scroll_top = 0;
+      scroll_bottom = height - 1;
+      graphics_charset[0] = graphics_charset[1] = false;
+      active_charset = 0;
+      cursor_visible = true;
+      set_cursor(0, 0);
+      break;
+    default:
+      break;
+  }
+}
+
+void headless_terminal_t::implementation_t::process_csi(char c) {
+  if (have_param) {
+    have_param = false;
+  } else if (!params.empty()) {
+    params.push_back(0);
+  }
+
+  if (private_marker == '?') {
+    if (c != 'h' && c != 'l') {
+      return;
+    }
+    for (int mode : params) {
+      switch (mode) {
+        case 25:
+          cursor_visible = c == 'h';
+          break;
+        case 47:
+        case 1047:
+        case 1049:
+          if ((c == 'h') != alternate_screen) {
+            alternate_screen = c == 'h';
+            if (mode == 1049 && alternate_screen) {
+              saved_line = cursor_line;
+              saved_column = cursor_column;
+              saved_attr = attr;
+            }
+            if (alternate_screen) {
+              saved_lines = std::move(lines);
+              lines.assign(height, line_t(width));
+            } else if (!saved_lines.empty()) {
+              lines = std::move(saved_lines);
+              saved_lines.clear();
+            }
+            if (mode == 1049 && !alternate_screen) {
+              set_cursor(saved_line, saved_column);
+              attr = saved_attr;
+            }
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    return;
+  } else if (private_marker != 0) {
+    return;
+  }
+
+  switch (c) {
+    case '@': {
+      line_t &line = lines[cursor_line];
+      int count = std::min(param(0, 1), width - cursor_column);
+      line.insert(line.begin() + cursor_column, count, blank());
+      line.resize(width);
+      wrap_pending = false;
+      break;
+    }
+    case 'A':
+      set_cursor(cursor_line - param(0, 1), cursor_column);
+      break;
+    case 'B':
+    case 'e':
+      set_cursor(cursor_line + param(0, 1), cursor_column);
+      break;
+    case 'C':
+    case 'a':
+      set_cursor(cursor_line, cursor_column + param(0, 1));
+      break;
+    case 'D':
+      set_cursor(cursor_line, cursor_column - param(0, 1));
+      break;
+    case 'E':
+      set_cursor(cursor_line + param(0, 1), 0);
+      break;
+    case 'F':
+      set_cursor(cursor_line - param(0, 1), 0);
+      break;
+    case 'G':
+    case '`':
+      set_cursor(cursor_line, param(0, 1) - 1);
+      break;
+    case 'H':
+    case 'f':
+      set_cursor(param(0, 1) - 1, param(1, 1) - 1);
+      break;
+    case 'd':
+      set_cursor(param(0, 1) - 1, cursor_column);
+      break;
+    case 'J': {
+      int mode = param(0, 0);
+      if (mode == 0) {
+        erase(cursor_line, cursor_column, width);
+        for (int i = cursor_line + 1; i < height; ++i) {
+          erase(i, 0, width);
+        }
+      } else if (mode == 1) {
+        for (int i = 0; i < cursor_line; ++i) {
+          erase(i, 0, width);
+        }
+        erase(cursor_line, 0, cursor_column + 1);
+      } else {
+        for (int i = 0; i < height; ++i) {
+          erase(i, 0, width);
+        }
+      }
+      break;
+    }
+    case 'K': {
+      int mode = param(0, 0);
+      erase(cursor_line, mode == 0 ? cursor_column : 0, mode == 1 ? cursor_column + 1 : width);
+      break;
+    }
+    case 'L':
+      if (cursor_line >= scroll_top && cursor_line <= scroll_bottom) {
+        scroll_down(cursor_line, param(0, 1));
+      }
+      break;
+    case 'M':
+      if (cursor_line >= scroll_top && cursor_line <= scroll_bottom) {
+        scroll_up(cursor_line, param(0, 1));
+      }
+      break;
+    case 'P': {
+      line_t &line = lines[cursor_line];
+      int count = std::min(param(0, 1), width - cursor_column);
+      line.erase(line.begin() + cursor_column, line.begin() + cursor_column + count);
+      line.resize(width, blank());
+      wrap_pending = false;
+      break;
+    }
+    case 'S':
+      scroll_up(scroll_top, param(0, 1));
+      break;
+    case 'T':
+      scroll_down(scroll_top, param(0, 1));
+      break;
+    case 'X':
+      erase(cursor_line, cursor_column, cursor_column + param(0, 1));
+      break;
+    case 'b':
+      if (!last_char.empty()) {
+        std::string text = last_char;
+        size_t size = text.size();
+        uint32_t value = t3_utf8_get(text.data(), &size);
+        for (int i = param(0, 1); i > 0; --i) {
+          put_char(value, text.data(), text.size());
+        }
+      }
+      break;
+    case 'm':
+      process_sgr();
+      break;
+    case 'r': {
+      int top = param(0, 1) - 1;
+      int bottom = param(1, height) - 1;
+      if (top < bottom && bottom < height) {
+        scroll_top = top;
+        scroll_bottom = bottom;
+        set_cursor(0, 0);
+      }
+      break;
+    }
+    case 's':
+      saved_line = cursor_line;
+      saved_column = cursor_column;
+      break;
+    case 'u':
+      set_cursor(saved_line, saved_column);
+      break;
+    default:
+      break;
+  }
+}
+
+void headless_terminal_t::implementation_t::process_sgr() {
+  if (params.empty()) {
+    attr = 0;
+    return;
+  }
+  for (size_t i = 0; i < params.size(); ++i) {
+    int value = params[i];
+    switch (value) {
+      case 0:
+        attr = 0;
+        break;
+      case 1:
+        attr |= T3_ATTR_BOLD;
+        break;
+      case 2:
+        attr |= T3_ATTR_DIM;
+        break;
+      case 4:
+        attr |= T3_ATTR_UNDERLINE;
+        break;
+      case 5:
+        attr |= T3_ATTR_BLINK;
+        break;
+      case 7:
+        attr |= T3_ATTR_REVERSE;
+        break;
+      case 22:
+        attr &= ~(T3_ATTR_BOLD | T3_ATTR_DIM);
+        break;
+      case 24:
+        attr &= ~T3_ATTR_UNDERLINE;
+        break;
+      case 25:
+        attr &= ~T3_ATTR_BLINK;
+        break;
+      case 27:
+        attr &= ~T3_ATTR_REVERSE;
+        break;
+      case 39:
+        attr &= ~T3_ATTR_FG_MASK;
+        break;
+      case 49:
+        attr &= ~T3_ATTR_BG_MASK;
+        break;
+      case 38:
+      case 48:
+        if (param(i + 1, 0) == 5 && i + 2 < params.size()) {
+          int color = params[i + 2] & 255;
+          if (value == 38) {
+            attr = (attr & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(color);
+          } else {
+            attr = (attr & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(color);
+          }
+          i += 2;
+        } else if (param(i + 1, 0) == 2) {
+          // Direct colors can not be represented. Skip the color components.
+          i += 4;
+        }
+        break;
+      default:
+        if (value >= 30 && value <= 37) {
+          attr = (attr & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(value - 30);
+        } else if (value >= 40 && value <= 47) {
+          attr = (attr & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(value - 40);
+        } else if (value >= 90 && value <= 97) {
+          attr = (attr & ~T3_ATTR_FG_MASK) | T3_ATTR_FG(value - 90 + 8);
+        } else if (value >= 100 && value <= 107) {
+          attr = (attr & ~T3_ATTR_BG_MASK) | T3_ATTR_BG(value - 100 + 8);
+        }
+        break;
+    }
+  }
+}
+
+void headless_terminal_t::implementation_t::process_string_end() {
+  if (string_type != '_' || string_data.compare(0, sizeof(sync_marker) - 1, sync_marker) != 0) {
+    return;
+  }
+  // Remove the marker from the recorded output, as it was not written by the library.
+  output.resize(sequence_start);
+  sync_received = strtoul(string_data.c_str() + sizeof(sync_marker) - 1, nullptr, 10);
+  synced_cond.notify_all();
+}
+
+void headless_terminal_t::implementation_t::put_char(uint32_t c, const char *text, size_t size) {
+  t3_attr_t char_attr = attr;
+  if (graphics_charset[active_charset] && c >= 0x5f && c <= 0x7e) {
+    text = acs_map[c - 0x5f];
+    size = strlen(text);
+    char_attr |= T3_ATTR_ACS;
+  }
+
+  int char_width = t3_utf8_wcwidth(c);
+  if (char_width == 0) {
+    // Combining characters are added to the preceding cell.
+    int column = wrap_pending ? cursor_column : cursor_column - 1;
+    while (column > 0 && lines[cursor_line][column].text.empty()) {
+      --column;
+    }
+    if (column >= 0) {
+      lines[cursor_line][column].text.append(text, size);
+    }
+    return;
+  }
+  if (char_width < 0) {
+    return;
+  }
+  last_char.assign(text, size);
+
+  if (wrap_pending || cursor_column + char_width > width) {
+    cursor_column = 0;
+    line_feed();
+  }
+  line_t &line = lines[cursor_line];
+  // Overwriting half of a double width character clears the other half.
+  if (line[cursor_column].text.empty() && cursor_column > 0) {
+    line[cursor_column - 1] = blank();
+  }
+  if (cursor_column + char_width < width && line[cursor_column + char_width].text.empty()) {
+    line[cursor_column + char_width] = blank();
+  }
+  line[cursor_column].text.assign(text, size);
+  line[cursor_column].attr = char_attr;
+  if (char_width == 2) {
+    line[cursor_column + 1].text.clear();
+    line[cursor_column + 1].attr = char_attr;
+  }
+  if (cursor_column + char_width >= width) {
+    cursor_column = width - 1;
+    wrap_pending = true;
+  } else {
+    cursor_column += char_width;
+  }
+}
+
+void headless_terminal_t::implementation_t::set_size(int new_height, int new_width) {
+  for (std::vector<line_t> *screen : {&lines, &saved_lines}) {
+    if (screen->empty()) {
+      continue;
+    }
+    screen->resize(new_height, line_t(new_width));
+    for (line_t &line : *screen) {
+      line.resize(new_width);
+      if (line.back().text.empty()) {
+        line.back() = cell_t();
+      }
+    }
+  }
+  height = new_height;
+  width = new_width;
+  scroll_top = 0;
+  scroll_bottom = height - 1;
+  set_cursor(cursor_line, cursor_column);
+}
+
+void headless_terminal_t::update() {
+  char marker[64];
+  dialog_t::update_dialogs();
+  t3_term_update();
+
+  std::unique_lock<std::mutex> l(impl->lock);
+  unsigned sequence = ++impl->sync_sent;
+  l.unlock();
+  int length = snprintf(marker, sizeof(marker), "\033_%s%u\033\\", sync_marker, sequence);
+  nosig_write(impl->slave_fd, marker, length);
+  l.lock();
+  while (!impl->reader_done && static_cast<int>(impl->sync_received - sequence) < 0) {
+    impl->synced_cond.wait(l);
+  }
+}
+
+void headless_terminal_t::resize(int height, int width) {
+  struct winsize size;
+  height = std::max(height, 1);
+  width = std::max(width, 1);
+
+  memset(&size, 0, sizeof(size));
+  size.ws_row = height;
+  size.ws_col = width;
+  ioctl(impl->master_fd, TIOCSWINSZ, &size);
+  {
+    std::unique_lock<std::mutex> l(impl->lock);
+    impl->set_size(height, width);
+  }
+  insert_key(EKEY_RESIZE);
+}
+
+void headless_terminal_t::send_input(string_view data) {
+  nosig_write(impl->master_fd, data.data(), data.size());
+}
+
+void headless_terminal_t::send_key(key_t key) { insert_key(key); }
+
+void headless_terminal_t::send_text(string_view text) {
+  while (!text.empty()) {
+    size_t size = text.size();
+    key_t c = t3_utf8_get(text.data(), &size);
+    insert_key(c == '\n' ? EKEY_NL : c);
+    text.remove_prefix(size);
+  }
+}
+
+int headless_terminal_t::get_height() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->height;
+}
+
+int headless_terminal_t::get_width() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->width;
+}
+
+std::string headless_terminal_t::get_line(int line) const {
+  std::string result;
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (line < 0 || line >= impl->height) {
+    return result;
+  }
+  for (const implementation_t::cell_t &cell : impl->lines[line]) {
+    result += cell.text;
+  }
+  return result;
+}
+
+std::string headless_terminal_t::get_text(int line, int column) const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (line < 0 || line >= impl->height || column < 0 || column >= impl->width) {
+    return std::string();
+  }
+  return impl->lines[line][column].text;
+}
+
+t3_attr_t headless_terminal_t::get_attr(int line, int column) const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (line < 0 || line >= impl->height || column < 0 || column >= impl->width) {
+    return 0;
+  }
+  return impl->lines[line][column].attr;
+}
+
+void headless_terminal_t::get_cursor(int *line, int *column) const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (line != nullptr) {
+    *line = impl->cursor_line;
+  }
+  if (column != nullptr) {
+    *column = impl->cursor_column;
+  }
+}
+
+bool headless_terminal_t::is_cursor_visible() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->cursor_visible;
+}
+
+std::string headless_terminal_t::get_output() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->state == implementation_t::GROUND ? impl->output
+                                                 : impl->output.substr(0, impl->sequence_start);
+}
+
+size_t headless_terminal_t::get_output_size() const {
+  std::unique_lock<std::mutex> l(impl->lock);
+  return impl->state == implementation_t::GROUND ? impl->output.size() : impl->sequence_start;
+}
+
+void headless_terminal_t::clear_output() {
+  std::unique_lock<std::mutex> l(impl->lock);
+  if (impl->state == implementation_t::GROUND) {
+    impl->output.clear();
+  } else {
+    impl->output.erase(0, impl->sequence_start);
+  }
+  impl->sequence_start = 0;
+}
+
+int headless_terminal_t::get_terminal_fd() const { return impl->slave_fd; }
+
+}  // namespace t3widget
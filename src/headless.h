@@ -0,0 +1,113 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_HEADLESS_H
+#define T3_WIDGET_HEADLESS_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <t3widget/key.h>
+#include <t3widget/string_view.h>
+#include <t3widget/util.h>
+#include <t3widget/widget_api.h>
+#include <t3window/window.h>
+
+namespace t3widget {
+
+/** An in-memory terminal, for running the library without a user visible terminal.
+
+    The headless terminal interprets the output of the library as an xterm compatible terminal
+    would, and maintains the result as a grid of cells. All bytes sent to the terminal are also
+    recorded, such that the cost of screen updates can be measured. Input can be provided either
+    as raw bytes, which are decoded by the regular key handling code, or as key symbols, which
+    are queued directly.
+
+    To use a headless terminal, pass it to #init through init_parameters_t::headless_terminal.
+    Unless specified otherwise in the init_parameters_t, the terminal type used is @c xterm. The
+    headless terminal must remain alive until after #cleanup has been called. Queries sent by
+    the library to the terminal are not answered, such that the results do not depend on timing.
+
+    Note that libt3window requires a terminal device, so internally a pseudo-terminal is used
+    to connect to it. It is not necessary to run under a terminal (emulator) though.
+*/
+class T3_WIDGET_API headless_terminal_t {
+ public:
+  /** Create a new headless terminal.
+      @param height The number of lines of the terminal.
+      @param width The number of columns of the terminal.
+      @return A new headless terminal, or @c nullptr on failure, in which case @c errno is set.
+  */
+  static std::unique_ptr<headless_terminal_t> create(int height, int width);
+  ~headless_terminal_t();
+
+  /** Update the terminal with all pending changes, and wait until they have been processed.
+      Unlike #iterate, this does not wait for a key press. After this function returns, the
+      screen contents and the recorded output reflect all changes made before the call. */
+  void update();
+  /** Change the size of the terminal.
+      The size change is reported to the library as a key press, which is processed by the next
+      call to #iterate. */
+  void resize(int height, int width);
+
+  /** Send raw bytes as if typed by the user.
+      The bytes are decoded by the key handling code in a separate thread, so the resulting keys
+      become available asynchronously. Note that a lone escape character is only reported after
+      the key timeout expires. */
+  void send_input(string_view data);
+  /** Queue a key symbol directly, bypassing the key decoding. Only valid after #init. */
+  void send_key(key_t key);
+  /** Queue the characters of a UTF-8 string as separate key symbols. Only valid after #init. */
+  void send_text(string_view text);
+
+  /** Get the number of lines of the terminal. */
+  int get_height() const;
+  /** Get the number of columns of the terminal. */
+  int get_width() const;
+  /** Get the text displayed on a line of the terminal, as UTF-8.
+      Each cell contributes its contents, which means that double width characters appear once.
+      Trailing blanks are included. */
+  std::string get_line(int line) const;
+  /** Get the text displayed in a single cell, as UTF-8.
+      Returns an empty string for the second cell of a double width character. Combining
+      characters are included in the cell of the character they combine with. */
+  std::string get_text(int line, int column) const;
+  /** Get the attributes of a single cell.
+      Characters drawn from the alternate character set are returned as Unicode characters by
+      #get_text and have @c T3_ATTR_ACS set. Default colors are reported as no color at all. */
+  t3_attr_t get_attr(int line, int column) const;
+  /** Get the position of the cursor. */
+  void get_cursor(int *line, int *column) const;
+  /** Get whether the cursor is currently visible. */
+  bool is_cursor_visible() const;
+
+  /** Get all bytes sent to the terminal since creation or the last call to #clear_output. */
+  std::string get_output() const;
+  /** Get the number of bytes sent to the terminal since creation or the last call to
+      #clear_output. */
+  size_t get_output_size() const;
+  /** Discard the recorded output. */
+  void clear_output();
+
+  /** @internal Get the file descriptor to be used as the terminal by libt3window. */
+  int get_terminal_fd() const;
+
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+  pimpl_t<implementation_t> impl;
+
+  headless_terminal_t(int height, int width);
+};
+
+}  // namespace t3widget
+#endif
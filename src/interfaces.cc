@@ -11,11 +11,17 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+#include <cstdlib>
 #include <list>
 #include <map>
 #include <sys/time.h>
+#include <typeindex>
 #include <typeinfo>
 #include <utility>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
 
 #include "t3widget/dialogs/dialog.h"
 #include "t3widget/interfaces.h"
@@ -33,6 +39,66 @@ window_component_t::window_component_t() {}
 window_component_t::~window_component_t() {}
 const t3window::window_t *window_component_t::get_base_window() const { return &window; }
 
+static bool update_profiling;
+static std::map<std::type_index, update_profile_t> update_profile;
+/* Time spent in the profiled_update_contents calls of the children of the component currently
+   being updated. Used to compute the self time. */
+static std::chrono::nanoseconds update_child_time;
+
+void window_component_t::profiled_update_contents() {
+  if (!update_profiling) {
+    update_contents();
+    return;
+  }
+
+  std::chrono::nanoseconds saved_child_time = update_child_time;
+  update_child_time = std::chrono::nanoseconds(0);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  update_contents();
+  std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+  update_profile_t &entry = update_profile[std::type_index(typeid(*this))];
+  entry.calls++;
+  entry.total_time += elapsed;
+  entry.self_time += elapsed - update_child_time;
+  update_child_time = saved_child_time + elapsed;
+}
+
+void window_component_t::record_redraw(long cells) const {
+  if (!update_profiling) {
+    return;
+  }
+  update_profile_t &entry = update_profile[std::type_index(typeid(*this))];
+  entry.redraws++;
+  entry.cells += cells;
+}
+
+void window_component_t::set_update_profiling(bool enable) { update_profiling = enable; }
+
+std::vector<update_profile_t> window_component_t::get_update_profile() {
+  std::vector<update_profile_t> result;
+  for (const auto &entry : update_profile) {
+    result.push_back(entry.second);
+    const char *name = entry.first.name();
+#ifdef __GNUC__
+    int status;
+    char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (demangled != nullptr) {
+      result.back().type_name = demangled;
+      free(demangled);
+      continue;
+    }
+#endif
+    result.back().type_name = name;
+  }
+  std::sort(result.begin(), result.end(), [](const update_profile_t &a, const update_profile_t &b) {
+    return a.total_time > b.total_time;
+  });
+  return result;
+}
+
+void window_component_t::reset_update_profile() { update_profile.clear(); }
+
 bool container_t::set_widget_parent(window_component_t *widget) {
   return widget->get_base_window()->set_parent(&window);
 }
@@ -58,7 +124,8 @@ mouse_target_t::mouse_target_t(bool use_window) {
 
 void mouse_target_t::register_mouse_target(const t3window::window_t *target) {
   if (target == nullptr) {
-    lprintf("Registering mouse target for nullptr window in %s\n", typeid(*this).name());
+    llog(LOG_WARNING, MOUSE, "Registering mouse target for nullptr window in %s\n",
+         typeid(*this).name());
   } else {
     targets[target->get()] = this;
   }
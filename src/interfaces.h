@@ -14,9 +14,12 @@
 #ifndef T3_WIDGET_INTERFACES_H
 #define T3_WIDGET_INTERFACES_H
 
+#include <chrono>
 #include <cstring>
 #include <list>
 #include <map>
+#include <string>
+#include <vector>
 #include <t3widget/key.h>
 #include <t3widget/mouse.h>
 #include <t3widget/util.h>
@@ -24,12 +27,33 @@
 
 namespace t3widget {
 
+/** Statistics about the #window_component_t::update_contents calls for one type of component.
+    See window_component_t::set_update_profiling. */
+struct T3_WIDGET_API update_profile_t {
+  /** Name of the type of the component. */
+  std::string type_name;
+  /** Number of calls to update_contents. */
+  long calls = 0;
+  /** Number of calls to update_contents which actually redrew (part of) the component. */
+  long redraws = 0;
+  /** Number of cells redrawn. For most components this is the size of the component's window for
+      each redraw, but components that only redraw the changed parts report only those. */
+  long cells = 0;
+  /** Time spent in update_contents, including the updates of child components. */
+  std::chrono::nanoseconds total_time{0};
+  /** Time spent in update_contents, excluding the updates of child components. */
+  std::chrono::nanoseconds self_time{0};
+};
+
 /** Abstract base class for all items displayed on screen. */
 class T3_WIDGET_API window_component_t {
  protected:
   /** The t3_window_t used for presenting this item on screen (see libt3window). */
   t3window::window_t window;
 
+  /** Record a redraw of @p cells cells for the update profile, if profiling is enabled. */
+  void record_redraw(long cells) const;
+
  public:
   enum focus_t { FOCUS_OUT = 0, FOCUS_SET, FOCUS_IN_FWD, FOCUS_IN_BCK, FOCUS_REVERT };
 
@@ -76,6 +100,22 @@ class T3_WIDGET_API window_component_t {
   virtual void hide() = 0;
   /** Request that this window_component_t be completely redrawn. */
   virtual void force_redraw() = 0;
+
+  /** Call #update_contents, recording statistics if update profiling is enabled.
+      Containers should use this function to update their children, such that the time spent in
+      the children can be attributed to the correct component type. */
+  void profiled_update_contents();
+
+  /** Enable or disable profiling of the #update_contents calls.
+      When enabled, the number of calls, the number of actual redraws, the time spent and the
+      number of cells redrawn are aggregated per component type. Profiling is disabled by default,
+      in which case the overhead is a single test per call. */
+  static void set_update_profiling(bool enable);
+  /** Retrieve the statistics collected since profiling was enabled, or since the last call to
+      #reset_update_profile. The result is sorted by decreasing total time. */
+  static std::vector<update_profile_t> get_update_profile();
+  /** Discard the statistics collected so far. */
+  static void reset_update_profile();
 };
 
 class widget_t;
@@ -35,6 +35,7 @@
 #include <t3widget/main.h>
 #include <t3widget/signals.h>
 #include <t3widget/string_view.h>
+#include <t3widget/trace.h>
 #include <t3widget/util.h>
 #include <t3widget/widget_api.h>
 
@@ -100,6 +101,8 @@ T3_WIDGET_LOCAL void cleanup_keys();
 T3_WIDGET_LOCAL void deinit_keys();
 /** Switch back to best keypad mode after using #deinit_keys. */
 T3_WIDGET_LOCAL void reinit_keys();
+/** Insert a key to the queue, as if it was read from the terminal. */
+T3_WIDGET_LOCAL void insert_key(t3widget::key_t key);
 /** Insert a key to the queue, marked to ensure it is not interpreted by any widget except text
  * widgets. */
 T3_WIDGET_LOCAL void insert_protected_key(t3widget::key_t key);
@@ -131,6 +134,16 @@ T3_WIDGET_LOCAL void fd_set_mouse_fd(fd_set *readset, int *max_fd);
  */
 T3_WIDGET_LOCAL bool check_mouse_fd(fd_set *readset);
 
+/** Start monitoring cached directory listings for changes. */
+T3_WIDGET_LOCAL void init_directory_cache();
+/** Drop all cached directory listings and stop monitoring for changes. */
+T3_WIDGET_LOCAL void cleanup_directory_cache();
+/** Set bit(s) for the directory change notification fd. */
+T3_WIDGET_LOCAL void fd_set_directory_cache_fd(fd_set *readset, int *max_fd);
+/** Process directory change notifications, if appropriate bits in @p readset indicate available
+    data. Returns whether the main loop should apply the changes. */
+T3_WIDGET_LOCAL bool check_directory_cache_fd(fd_set *readset);
+
 enum { CLASS_WHITESPACE, CLASS_ALNUM, CLASS_GRAPH, CLASS_OTHER };
 
 /** Get the character class associated with the character at a specific position in a string. */
@@ -11,6 +11,7 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
 #include <cerrno>
 #include <csignal>
 #include <cstdint>
@@ -22,6 +23,7 @@
 #include <string>
 #include <sys/select.h>
 #include <t3key/key.h>
+#include <t3widget/headless.h>
 #include <t3widget/internal.h>
 #include <t3widget/key.h>
 #include <t3widget/keybuffer.h>
@@ -101,6 +103,8 @@ static std::string leave, enter;
 static int signal_pipe[2] = {-1, -1};
 
 static key_buffer_t key_buffer;
+/** File descriptor from which the key reading thread reads the terminal input. */
+static int input_fd = STDIN_FILENO;
 static std::thread read_key_thread;
 
 char char_buffer[128];
@@ -216,10 +220,10 @@ bool read_keychar(int timeout) {
       transcript_close_converter(conversion_handle);
       conversion_handle = new_conversion_handle;
     } else {
-      lprintf("Error opening new convertor '%s': %s\n", t3_term_get_codeset(),
-              transcript_strerror(transcript_error));
+      llog(LOG_ERROR, KEYS, "Error opening new convertor '%s': %s\n", t3_term_get_codeset(),
+           transcript_strerror(transcript_error));
     }
-    lprintf("New codeset: %s\n", t3_term_get_codeset());
+    llog(LOG_INFO, KEYS, "New codeset: %s\n", t3_term_get_codeset());
     key_buffer.push_back_unique(EKEY_UPDATE_TERMINAL);
   }
 
@@ -239,10 +243,11 @@ static void read_keys() {
 
   while (true) {
     FD_ZERO(&readset);
-    FD_SET(0, &readset);
+    FD_SET(input_fd, &readset);
     FD_SET(signal_pipe[0], &readset);
-    max_fd = signal_pipe[0];
+    max_fd = std::max(signal_pipe[0], input_fd);
     fd_set_mouse_fd(&readset, &max_fd);
+    fd_set_directory_cache_fd(&readset, &max_fd);
 
     retval = select(max_fd + 1, &readset, nullptr, nullptr, nullptr);
 
@@ -279,7 +284,11 @@ static void read_keys() {
       key_buffer.push_back(EKEY_MOUSE_EVENT);
     }
 
-    if (FD_ISSET(0, &readset)) {
+    if (check_directory_cache_fd(&readset)) {
+      key_buffer.push_back_unique(EKEY_EXTERNAL_UPDATE);
+    }
+
+    if (FD_ISSET(input_fd, &readset)) {
       read_keychar(-1);
     }
 
@@ -479,6 +488,12 @@ static key_t bracketed_paste_decode() {
   return -1;
 }
 
+void insert_key(key_t key) {
+  if (key >= 0) {
+    key_buffer.push_back(key);
+  }
+}
+
 void insert_protected_key(key_t key) {
   if (key >= 0) {
     key_buffer.push_back(key | EKEY_PROTECT);
@@ -542,6 +557,10 @@ complex_error_t init_keys(const optional<std::string> &term, bool separate_keypa
   transcript_error_t transcript_error;
   const char *shiftfn = nullptr;
 
+  input_fd = init_params->headless_terminal != nullptr
+                 ? init_params->headless_terminal->get_terminal_fd()
+                 : STDIN_FILENO;
+
   /* Start with things most likely to fail */
   if ((conversion_handle = transcript_open_converter(transcript_get_codeset(), TRANSCRIPT_UTF32, 0,
                                                      &transcript_error)) == nullptr) {
@@ -686,6 +705,7 @@ complex_error_t init_keys(const optional<std::string> &term, bool separate_keypa
     }
   }
 
+  init_directory_cache();
   read_key_thread = std::thread(read_keys);
 
 #ifdef DEBUG
@@ -737,6 +757,7 @@ void reinit_keys() {
 
 void cleanup_keys() {
   stop_keys();
+  cleanup_directory_cache();
   if (conversion_handle != nullptr) {
     transcript_close_converter(conversion_handle);
     conversion_handle = nullptr;
@@ -16,62 +16,365 @@
 #include <cstring>
 #include <stdio.h>
 
+#ifdef _T3_WIDGET_DEBUG
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#endif
+
 #include "t3widget/log.h"
 
 namespace t3widget {
 
 #ifdef _T3_WIDGET_DEBUG
+/* The log is written asynchronously: each thread formats its messages into its own ring buffer,
+   which is emptied into the log file by a background thread. Writing a message therefore does not
+   require any locking or system calls. If a ring buffer is full, the message is dropped, and the
+   number of dropped messages is reported in the log. */
+
+std::atomic<int> log_max_level{-1};
+std::atomic<int> log_categories{log_category_t::ALL};
+
+static const size_t ring_size = 65536;
+static const size_t max_message_size = 1024;
+
+struct record_header_t {
+  uint32_t size;
+  uint8_t level;
+  uint16_t category;
+  int64_t timestamp;
+};
+
+/** Single producer, single consumer ring buffer holding the log records of one thread. */
+struct log_ring_t {
+  char data[ring_size];
+  /* Both positions only increase. The producer only writes head, the consumer only writes tail. */
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  /** Set when the owning thread has exited, after which the flush thread may delete the ring. */
+  std::atomic<bool> finished{false};
+  /** Text of the current incomplete line, only used by the flush thread. */
+  std::string partial;
+};
+
 static FILE *log_file;
+static std::chrono::steady_clock::time_point log_start;
+static std::atomic<bool> log_active{false};
+static std::atomic<size_t> dropped_messages{0};
 
-static void close_log() { fclose(log_file); }
+static std::mutex rings_lock;
+static std::vector<log_ring_t *> rings;
 
-void init_log() {
-  if (log_file == nullptr) {
-    log_file = fopen("libt3widgetlog.txt", "a");
-    if (log_file) {
-      atexit(close_log);
+static std::thread flush_thread;
+static std::mutex flush_lock;
+static std::condition_variable flush_cond;
+static bool flush_stop;
+
+static thread_local log_ring_t *thread_ring;
+static thread_local bool thread_ring_released;
+
+/** Marks the ring buffer of a thread as finished when the thread exits. */
+struct ring_owner_t {
+  ~ring_owner_t() {
+    thread_ring_released = true;
+    if (thread_ring != nullptr) {
+      thread_ring->finished.store(true, std::memory_order_release);
+      thread_ring = nullptr;
+    }
+  }
+};
+static thread_local ring_owner_t ring_owner;
+
+static log_ring_t *get_thread_ring() {
+  if (thread_ring == nullptr && !thread_ring_released) {
+    log_ring_t *ring = new log_ring_t;
+    {
+      std::lock_guard<std::mutex> guard(rings_lock);
+      rings.push_back(ring);
     }
+    // Reference ring_owner to ensure it is constructed, such that its destructor runs.
+    (void)&ring_owner;
+    thread_ring = ring;
   }
+  return thread_ring;
 }
 
-void lprintf(const char *fmt, ...) {
-  if (log_file) {
-    va_list args;
+static void copy_in(log_ring_t *ring, size_t pos, const void *src, size_t size) {
+  size_t offset = pos & (ring_size - 1);
+  size_t first = std::min(size, ring_size - offset);
+  memcpy(ring->data + offset, src, first);
+  memcpy(ring->data, static_cast<const char *>(src) + first, size - first);
+}
+
+static void copy_out(const log_ring_t *ring, size_t pos, void *dest, size_t size) {
+  size_t offset = pos & (ring_size - 1);
+  size_t first = std::min(size, ring_size - offset);
+  memcpy(dest, ring->data + offset, first);
+  memcpy(static_cast<char *>(dest) + first, ring->data, size - first);
+}
+
+static void push_record(log_level_t level, int category, const char *text, size_t size) {
+  if (!log_active.load(std::memory_order_acquire) || size == 0) {
+    return;
+  }
+  log_ring_t *ring = get_thread_ring();
+  if (ring == nullptr) {
+    return;
+  }
+
+  record_header_t header;
+  header.size = size;
+  header.level = static_cast<uint8_t>(level);
+  header.category = static_cast<uint16_t>(category);
+  header.timestamp =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                            log_start)
+          .count();
+
+  size_t head = ring->head.load(std::memory_order_relaxed);
+  size_t tail = ring->tail.load(std::memory_order_acquire);
+  if (ring_size - (head - tail) < sizeof(header) + size) {
+    dropped_messages.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  copy_in(ring, head, &header, sizeof(header));
+  copy_in(ring, head + sizeof(header), text, size);
+  ring->head.store(head + sizeof(header) + size, std::memory_order_release);
+}
+
+static void vpush_record(log_level_t level, int category, const char *fmt, va_list args) {
+  char buffer[max_message_size];
+  int result = vsnprintf(buffer, sizeof(buffer), fmt, args);
+  if (result < 0) {
+    return;
+  }
+  push_record(level, category, buffer, std::min<size_t>(result, sizeof(buffer) - 1));
+}
+
+static const char *const level_names[] = {"error", "warning", "info", "debug"};
+static const char *const category_names[] = {"general", "keys", "mouse", "clipboard",
+                                             "undo",    "draw", "find"};
+
+static const char *category_name(int category) {
+  for (size_t i = 0; i < sizeof(category_names) / sizeof(category_names[0]); ++i) {
+    if (category & (1 << i)) {
+      return category_names[i];
+    }
+  }
+  return "?";
+}
+
+/** Write the records in @p ring to the log file. Returns whether any records were present. */
+static bool drain_ring(log_ring_t *ring) {
+  size_t tail = ring->tail.load(std::memory_order_relaxed);
+  size_t head = ring->head.load(std::memory_order_acquire);
+  if (tail == head) {
+    return false;
+  }
+
+  char text[max_message_size];
+  while (tail != head) {
+    record_header_t header;
+    copy_out(ring, tail, &header, sizeof(header));
+    copy_out(ring, tail + sizeof(header), text, header.size);
+    tail += sizeof(header) + header.size;
+
+    const char *ptr = text;
+    const char *end = text + header.size;
+    while (ptr < end) {
+      if (ring->partial.empty()) {
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "%lld.%06lld %s %s: ",
+                 static_cast<long long>(header.timestamp / 1000000),
+                 static_cast<long long>(header.timestamp % 1000000),
+                 level_names[std::min<int>(header.level, 3)], category_name(header.category));
+        ring->partial = prefix;
+      }
+      const char *newline = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+      if (newline == nullptr) {
+        ring->partial.append(ptr, end - ptr);
+        break;
+      }
+      ring->partial.append(ptr, newline + 1 - ptr);
+      fwrite(ring->partial.data(), 1, ring->partial.size(), log_file);
+      ring->partial.clear();
+      ptr = newline + 1;
+    }
+  }
+  ring->tail.store(tail, std::memory_order_release);
+  return true;
+}
 
-    va_start(args, fmt);
-    vfprintf(log_file, fmt, args);
+/** Write the contents of all ring buffers to the log file. If @p final is set, incomplete lines
+    are written as well. */
+static void drain_rings(bool final) {
+  bool written = false;
+  std::lock_guard<std::mutex> guard(rings_lock);
+  for (auto iter = rings.begin(); iter != rings.end();) {
+    log_ring_t *ring = *iter;
+    // Read the finished flag before draining, to ensure no records are missed.
+    bool finished = ring->finished.load(std::memory_order_acquire);
+    written |= drain_ring(ring);
+    if ((final || finished) && !ring->partial.empty()) {
+      ring->partial += '\n';
+      fwrite(ring->partial.data(), 1, ring->partial.size(), log_file);
+      ring->partial.clear();
+      written = true;
+    }
+    if (finished) {
+      delete ring;
+      iter = rings.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  size_t dropped = dropped_messages.exchange(0, std::memory_order_relaxed);
+  if (dropped != 0) {
+    fprintf(log_file, "[%zu messages dropped]\n", dropped);
+    written = true;
+  }
+  if (written) {
     fflush(log_file);
-    va_end(args);
   }
 }
 
+static void flush_loop() {
+  std::unique_lock<std::mutex> guard(flush_lock);
+  while (!flush_stop) {
+    flush_cond.wait_for(guard, std::chrono::milliseconds(20));
+    guard.unlock();
+    drain_rings(false);
+    guard.lock();
+  }
+}
+
+static void close_log() {
+  log_active.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> guard(flush_lock);
+    flush_stop = true;
+  }
+  flush_cond.notify_one();
+  flush_thread.join();
+  /* Other threads may still be writing to their ring buffers, so these are not deallocated. They
+     are however no longer drained after this point. */
+  drain_rings(true);
+  fclose(log_file);
+}
+
+/** Parse the value of the T3_WIDGET_LOG environment variable. */
+static void parse_log_filter(const char *spec) {
+  std::string value(spec);
+  std::string::size_type colon = value.find(':');
+  std::string level_name = value.substr(0, colon);
+  int level = static_cast<int>(log_level_t::LOG_INFO);
+  for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); ++i) {
+    if (level_name == level_names[i]) {
+      level = i;
+    }
+  }
+
+  int categories = log_category_t::ALL;
+  if (colon != std::string::npos) {
+    categories = 0;
+    std::string::size_type start = colon + 1;
+    while (start <= value.size()) {
+      std::string::size_type comma = std::min(value.find(',', start), value.size());
+      std::string name = value.substr(start, comma - start);
+      for (size_t i = 0; i < sizeof(category_names) / sizeof(category_names[0]); ++i) {
+        if (name == category_names[i] || name == "all") {
+          categories |= 1 << i;
+        }
+      }
+      start = comma + 1;
+    }
+  }
+  log_max_level.store(level, std::memory_order_relaxed);
+  log_categories.store(categories, std::memory_order_relaxed);
+}
+
+void init_log() {
+  const char *spec = getenv("T3_WIDGET_LOG");
+  if (log_file != nullptr || spec == nullptr) {
+    return;
+  }
+  log_file = fopen("libt3widgetlog.txt", "a");
+  if (log_file == nullptr) {
+    return;
+  }
+  parse_log_filter(spec);
+  log_start = std::chrono::steady_clock::now();
+  flush_thread = std::thread(flush_loop);
+  log_active.store(true, std::memory_order_release);
+  atexit(close_log);
+}
+
+void lprintf(const char *fmt, ...) {
+  if (!log_enabled(log_level_t::LOG_INFO, log_category_t::GENERAL)) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  vpush_record(log_level_t::LOG_INFO, log_category_t::GENERAL, fmt, args);
+  va_end(args);
+}
+
+void log_message(log_level_t level, int category, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vpush_record(level, category, fmt, args);
+  va_end(args);
+}
+
 void ldumpstr(const char *str, int length) {
+  if (!log_enabled(log_level_t::LOG_INFO, log_category_t::GENERAL)) {
+    return;
+  }
+  char buffer[max_message_size];
+  size_t fill = 0;
   for (; length > 0; length--, str++) {
-    if (static_cast<unsigned int>(*str) < 32) {
-      fprintf(log_file, "\\x%02X", *str);
+    if (fill > sizeof(buffer) - 5) {
+      push_record(log_level_t::LOG_INFO, log_category_t::GENERAL, buffer, fill);
+      fill = 0;
+    }
+    if (static_cast<unsigned char>(*str) < 32) {
+      fill += snprintf(buffer + fill, sizeof(buffer) - fill, "\\x%02X", *str);
     } else if (*str == '\\') {
-      fprintf(log_file, "\\\\");
+      buffer[fill++] = '\\';
+      buffer[fill++] = '\\';
     } else {
-      fputc(*str, log_file);
+      buffer[fill++] = *str;
     }
   }
-  fflush(log_file);
+  push_record(log_level_t::LOG_INFO, log_category_t::GENERAL, buffer, fill);
 }
 
 void logkeyseq(const char *keys) {
-  size_t i;
-
-  if (!log_file) {
+  if (!log_enabled(log_level_t::LOG_WARNING, log_category_t::KEYS)) {
     return;
   }
-
-  fprintf(log_file, "Unknown key sequence:");
-  for (i = 0; i < strlen(keys); i++) {
-    fprintf(log_file, " %d", keys[i]);
+  char buffer[max_message_size];
+  size_t fill = snprintf(buffer, sizeof(buffer), "Unknown key sequence:");
+  for (; *keys != 0 && fill < sizeof(buffer) - 6; ++keys) {
+    fill += snprintf(buffer + fill, sizeof(buffer) - fill, " %d", *keys);
   }
-  fprintf(log_file, "\n");
-  fflush(log_file);
+  buffer[fill++] = '\n';
+  push_record(log_level_t::LOG_WARNING, log_category_t::KEYS, buffer, fill);
+}
+
+void set_log_filter(log_level_t level, int categories) {
+  log_max_level.store(static_cast<int>(level), std::memory_order_relaxed);
+  log_categories.store(categories, std::memory_order_relaxed);
 }
+#else
+void set_log_filter(log_level_t, int) {}
 #endif
 
 }  // namespace t3widget
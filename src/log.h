@@ -19,10 +19,12 @@
 #endif
 
 #ifdef _T3_WIDGET_DEBUG
+#include <atomic>
 #include <typeinfo>
 #endif
 
 #include <stdio.h>
+#include <t3widget/util.h>
 #include <t3widget/widget_api.h>
 
 namespace t3widget {
@@ -31,7 +33,9 @@ namespace t3widget {
 
 T3_WIDGET_LOCAL void init_log();
 /* Note: these must be declared with T3_WIDGET_API such that they can be accessed
-   from the clipboard modules. */
+   from the clipboard modules. Messages written through lprintf and ldumpstr are logged at the
+   INFO level in the GENERAL category. Messages are collected per thread, and only end up in the
+   log file when a complete line has been written. */
 T3_WIDGET_API void lprintf(const char *fmt, ...)
 #ifdef __GNUC__
     __attribute__((format(printf, 1, 2)))
@@ -39,6 +43,31 @@ T3_WIDGET_API void lprintf(const char *fmt, ...)
     ;
 T3_WIDGET_API void ldumpstr(const char *str, int length);
 T3_WIDGET_API void logkeyseq(const char *keys);
+T3_WIDGET_API void log_message(log_level_t level, int category, const char *fmt, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+T3_WIDGET_LOCAL extern std::atomic<int> log_max_level;
+T3_WIDGET_LOCAL extern std::atomic<int> log_categories;
+
+/** Check whether messages of @p level in @p category are written to the log. */
+static inline bool log_enabled(log_level_t level, int category) {
+  return static_cast<int>(level) <= log_max_level.load(std::memory_order_relaxed) &&
+         (category & log_categories.load(std::memory_order_relaxed)) != 0;
+}
+
+/* The arguments are only evaluated if the message will actually be logged. Usage:
+   llog(LOG_DEBUG, KEYS, "format", args...); */
+#define llog(_level, _category, ...)                                                          \
+  do {                                                                                        \
+    if (::t3widget::log_enabled(::t3widget::log_level_t::_level,                              \
+                                ::t3widget::log_category_t::_category)) {                     \
+      ::t3widget::log_message(::t3widget::log_level_t::_level,                                \
+                              ::t3widget::log_category_t::_category, __VA_ARGS__);            \
+    }                                                                                         \
+  } while (0)
 
 #else
 
@@ -46,6 +75,7 @@ T3_WIDGET_API void logkeyseq(const char *keys);
 #define lprintf(fmt, ...)
 #define ldumpstr(str, length)
 #define logkeyseq(keys)
+#define llog(_level, _category, ...)
 
 #endif
 
@@ -35,6 +35,7 @@
 #include "t3widget/dialogs/dialog.h"
 #include "t3widget/dialogs/insertchardialog.h"
 #include "t3widget/dialogs/messagedialog.h"
+#include "t3widget/headless.h"
 #include "t3widget/interfaces.h"
 #include "t3widget/internal.h"
 #include "t3widget/key.h"
@@ -44,6 +45,7 @@
 #include "t3widget/signals.h"
 #include "t3widget/string_view.h"
 #include "t3widget/textline.h"
+#include "t3widget/trace.h"
 #include "t3widget/util.h"
 #include "t3window/terminal.h"
 
@@ -153,7 +155,7 @@ std::unique_ptr<init_parameters_t> init_parameters_t::create() {
 }
 
 init_parameters_t::init_parameters_t()
-    : separate_keypad(false), disable_external_clipboard(false) {}
+    : separate_keypad(false), disable_external_clipboard(false), headless_terminal(nullptr) {}
 
 connection_t connect_resize(std::function<void(int, int)> func) { return resize.connect(func); }
 
@@ -304,13 +306,18 @@ complex_error_t init(const init_parameters_t *params) {
     return result;
   }
 
+  init_log();
   text_line_t::init();
 
   if (init_params == nullptr) {
     init_params = init_parameters_t::create().release();
   }
 
-  if (params == nullptr || !params->term.is_valid()) {
+  if (params != nullptr && params->headless_terminal != nullptr && !params->term.is_valid()) {
+    /* The headless terminal emulates an xterm, and the results should not depend on the
+       environment. */
+    init_params->term = std::string("xterm");
+  } else if (params == nullptr || !params->term.is_valid()) {
     const char *term_env = getenv("TERM");
     /* If term_env == nullptr, t3_term_init will abort anyway, so we ignore
        that case. */
@@ -325,12 +332,19 @@ complex_error_t init(const init_parameters_t *params) {
     init_params->program_name =
         params->program_name.empty() ? std::string("This program") : params->program_name;
     init_params->separate_keypad = params->separate_keypad;
-    init_params->disable_external_clipboard = params->disable_external_clipboard;
+    init_params->disable_external_clipboard =
+        params->disable_external_clipboard || params->headless_terminal != nullptr;
+    init_params->headless_terminal = params->headless_terminal;
+    init_params->trace_file = params->trace_file;
   }
+  init_trace(init_params->trace_file);
 
   atexit(restore);
   if ((term_init_result = t3_term_init(
-           -1, init_params->term.is_valid() ? init_params->term.value().c_str() : nullptr)) !=
+           init_params->headless_terminal != nullptr
+               ? init_params->headless_terminal->get_terminal_fd()
+               : -1,
+           init_params->term.is_valid() ? init_params->term.value().c_str() : nullptr)) !=
       T3_ERR_SUCCESS) {
     int saved_errno = errno;
     restore();
@@ -383,21 +397,32 @@ void iterate() {
   key_t key;
   mouse_event_t mouse_event;
 
-  dialog_t::update_dialogs();
-  t3_term_update();
-  if (should_draw_mouse_cursor) {
-    draw_mouse_cursor(mouse_event);
+  {
+    trace_scope_t trace("update_dialogs");
+    dialog_t::update_dialogs();
   }
-  key = read_key();
+  {
+    trace_scope_t trace("t3_term_update");
+    t3_term_update();
+    if (should_draw_mouse_cursor) {
+      draw_mouse_cursor(mouse_event);
+    }
+  }
+  {
+    trace_scope_t trace("read_key");
+    key = read_key();
+  }
+
+  trace_scope_t trace("process_key");
   if (key == EKEY_MOUSE_EVENT) {
     should_draw_mouse_cursor = true;
     mouse_event = read_mouse_event();
-    lprintf("Got mouse event: x=%d, y=%d, button_state=%d, modifier_state=%d\n", mouse_event.x,
-            mouse_event.y, mouse_event.button_state, mouse_event.modifier_state);
+    llog(LOG_DEBUG, MOUSE, "Got mouse event: x=%d, y=%d, button_state=%d, modifier_state=%d\n",
+         mouse_event.x, mouse_event.y, mouse_event.button_state, mouse_event.modifier_state);
     mouse_target_t::handle_mouse_event(mouse_event);
   } else {
     should_draw_mouse_cursor = false;
-    lprintf("Got key %04X\n", key);
+    llog(LOG_DEBUG, KEYS, "Got key %04X\n", key);
     switch (key) {
       case EKEY_RESIZE:
         do_resize();
@@ -444,6 +469,7 @@ void cleanup() {
   insert_char_dialog = nullptr;
   restore();
   t3_term_deinit();
+  stop_trace();
 }
 
 // this is a 'wake' switch that we wait on after suspend
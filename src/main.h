@@ -60,6 +60,8 @@ class T3_WIDGET_API complex_error_t {
   std::string get_string();
 };
 
+class headless_terminal_t;
+
 /** Structure holding the parameters for initialization for libt3widget.
  */
 class T3_WIDGET_API init_parameters_t {
@@ -79,6 +81,18 @@ class T3_WIDGET_API init_parameters_t {
       we may be able to connect to it. For example, if it is connected over a
       slow link. */
   bool disable_external_clipboard;
+  /** Headless terminal to use instead of the controlling terminal.
+
+      If not @c nullptr, all output is sent to this terminal, and all input is read from it. The
+      external clipboard is disabled when using a headless terminal. */
+  headless_terminal_t *headless_terminal;
+  /** Name of a file to write trace events to.
+
+      If set, the time spent in the different phases of #iterate and in a number of potentially
+      expensive operations is written to this file in the Chrome trace event format. If not set,
+      the file named in the @c T3_WIDGET_TRACE environment variable is used, if any. Tracing stops
+      when #cleanup is called or the program exits. */
+  optional<std::string> trace_file;
 
   /** Construct a new init_parameters_t object. */
   static std::unique_ptr<init_parameters_t> create();
@@ -37,10 +37,14 @@
 
 #define PCRE2_NO_UTF_CHECK PCRE_NO_UTF8_CHECK
 #define PCRE2_CASELESS PCRE_CASELESS
+#define PCRE2_MULTILINE PCRE_MULTILINE
 #define PCRE2_NOTEOL PCRE_NOTEOL
 #define PCRE2_NOTBOL PCRE_NOTBOL
+#define PCRE2_PARTIAL_HARD PCRE_PARTIAL_HARD
 
 #define PCRE2_ERROR_BADOPTION PCRE_ERROR_BADOPTION
+#define PCRE2_ERROR_NOMATCH PCRE_ERROR_NOMATCH
+#define PCRE2_ERROR_PARTIAL PCRE_ERROR_PARTIAL
 
 typedef struct {
   pcre *regex;
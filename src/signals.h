@@ -15,45 +15,139 @@
 #ifndef DEFINE_SIGNAL_H
 #define DEFINE_SIGNAL_H
 
+#include <cstddef>
 #include <functional>
 #include <list>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <t3widget/widget_api.h>
 
 namespace t3widget {
 
 namespace internal {
-/* Base class for function wrappers. This provides the part of the functionality that is not
-   dependent on actual function argument types, and defines the generic functionality in terms of
-   abstract functions. Having this base class allows the connection_t class to be fully generic. */
-class func_ptr_base_t {
+/* State of a connected callback, shared between the signal and the connection_t objects. This
+   provides the part of the functionality that is not dependent on actual function argument types,
+   which allows the connection_t class to be fully generic. */
+class slot_state_t {
  public:
-  virtual ~func_ptr_base_t() = default;
-  virtual void disconnect() = 0;
-  virtual bool is_valid() const = 0;
+  void disconnect() { valid = false; }
+  bool is_valid() const { return valid; }
   // Blocked signals don't get called.
   bool is_blocked() const { return blocked; }
   void block() { blocked = true; }
-  void unblock() { blocked = true; }
+  void unblock() { blocked = false; }
 
  private:
+  bool valid = true;
   bool blocked = false;
 };
 
-/* Templated subclass of func_base_ptr which implements the actual call functionality and holds the
-   pointer to the actual std::function. */
+/* Type-erased callable, similar to std::function, which stores small callables inline. The
+   arguments are passed by reference, such that activating a signal does not copy them for each
+   callback. Callables that do not fit in the inline buffer, or that may throw when moved, are
+   allocated on the heap when they are stored, never when they are called. */
 template <typename... Args>
-class func_ptr_t : public func_ptr_base_t {
+class slot_function_t {
  public:
-  using F = std::function<void(Args...)>;
-  func_ptr_t(F f) : func(new F(f)) {}
-  void disconnect() override { func.reset(); }
-  bool is_valid() const override { return !!func; }
-  void call(Args... args) const { return (*func)(args...); }
+  template <typename F, typename D = typename std::decay<F>::type>
+  slot_function_t(F &&func) : ops(&ops_for<D>::ops) {
+    ops_for<D>::construct(&storage, std::forward<F>(func));
+  }
+  /* The moved-from object is left without a callable, such that its destructor does not destroy
+     the callable again. */
+  slot_function_t(slot_function_t &&other) noexcept : ops(other.ops) {
+    ops->move(&storage, &other.storage);
+    other.ops = &empty_ops_t::ops;
+  }
+  slot_function_t &operator=(slot_function_t &&other) noexcept {
+    if (this != &other) {
+      ops->destroy(&storage);
+      ops = other.ops;
+      ops->move(&storage, &other.storage);
+      other.ops = &empty_ops_t::ops;
+    }
+    return *this;
+  }
+  slot_function_t(const slot_function_t &) = delete;
+  slot_function_t &operator=(const slot_function_t &) = delete;
+  ~slot_function_t() { ops->destroy(&storage); }
+
+  void operator()(Args &... args) const { ops->call(&storage, args...); }
 
  private:
-  std::unique_ptr<F> func;
+  /* Large enough to hold a std::function, a std::bind of a member function and an object
+     pointer, or a lambda capturing a few pointers. */
+  using storage_t = typename std::aligned_storage<4 * sizeof(void *), alignof(void *)>::type;
+
+  struct ops_t {
+    void (*call)(const storage_t *storage, Args &... args);
+    // Move-construct the callable in dest from the callable in src, and destroy the latter.
+    void (*move)(storage_t *dest, storage_t *src);
+    void (*destroy)(storage_t *storage);
+  };
+
+  template <typename F, bool is_inline = sizeof(F) <= sizeof(storage_t) &&
+                                         alignof(F) <= alignof(storage_t) &&
+                                         std::is_nothrow_move_constructible<F>::value>
+  struct ops_for {
+    template <typename G>
+    static void construct(storage_t *storage, G &&func) {
+      new (storage) F(std::forward<G>(func));
+    }
+    static F *get(const storage_t *storage) {
+      return const_cast<F *>(reinterpret_cast<const F *>(storage));
+    }
+    static void call(const storage_t *storage, Args &... args) { (*get(storage))(args...); }
+    static void move(storage_t *dest, storage_t *src) {
+      new (dest) F(std::move(*get(src)));
+      get(src)->~F();
+    }
+    static void destroy(storage_t *storage) { get(storage)->~F(); }
+    static const ops_t ops;
+  };
+
+  template <typename F>
+  struct ops_for<F, false> {
+    template <typename G>
+    static void construct(storage_t *storage, G &&func) {
+      new (storage) F *(new F(std::forward<G>(func)));
+    }
+    static F *get(const storage_t *storage) { return *reinterpret_cast<F *const *>(storage); }
+    static void call(const storage_t *storage, Args &... args) { (*get(storage))(args...); }
+    static void move(storage_t *dest, storage_t *src) { new (dest) F *(get(src)); }
+    static void destroy(storage_t *storage) { delete get(storage); }
+    static const ops_t ops;
+  };
+
+  // Operations for a slot_function_t of which the callable has been moved out.
+  struct empty_ops_t {
+    static void call(const storage_t *, Args &...) {}
+    static void move(storage_t *, storage_t *) {}
+    static void destroy(storage_t *) {}
+    static const ops_t ops;
+  };
+
+  const ops_t *ops;
+  // Mutable because calling the stored callable may modify it, like calling a std::function.
+  mutable storage_t storage;
 };
+
+template <typename... Args>
+template <typename F, bool is_inline>
+const typename slot_function_t<Args...>::ops_t slot_function_t<Args...>::ops_for<F, is_inline>::ops =
+    {call, move, destroy};
+
+template <typename... Args>
+template <typename F>
+const typename slot_function_t<Args...>::ops_t slot_function_t<Args...>::ops_for<F, false>::ops = {
+    call, move, destroy};
+
+template <typename... Args>
+const typename slot_function_t<Args...>::ops_t slot_function_t<Args...>::empty_ops_t::ops = {
+    call, move, destroy};
 }  // namespace internal
 
 /** A connection_t is the handle for a callback that is associated with a signal.
@@ -66,7 +160,7 @@ class func_ptr_t : public func_ptr_base_t {
 class T3_WIDGET_API connection_t {
  public:
   connection_t() = default;
-  connection_t(std::shared_ptr<internal::func_ptr_base_t> f) : func(f) {}
+  connection_t(std::shared_ptr<internal::slot_state_t> f) : func(f) {}
   connection_t(const connection_t &other) : func(other.func) {}
 
   connection_t &operator=(const connection_t &other) {
@@ -91,7 +185,7 @@ class T3_WIDGET_API connection_t {
   }
 
  private:
-  std::shared_ptr<internal::func_ptr_base_t> func;
+  std::shared_ptr<internal::slot_state_t> func;
 };
 
 /** A signal object allows a set of callbacks to be called on activation.
@@ -99,41 +193,50 @@ class T3_WIDGET_API connection_t {
     The signal object holds zero or more callbacks, which get called when operator() is called. The
     purpose of this is to allow an object to provide a callback interface, which may be hooked into
     by multiple other objects. Through the returned @c connection_t object, registered callbacks can
-    be controlled or removed. Note that actual removal of the callback object (std::function) only
-    happens on activation of the signal.
+    be controlled or removed. Note that actual removal of the callback object only happens when a
+    new callback is connected.
+
+    The callbacks are stored in a contiguous array, and activation does not allocate memory.
+    Callbacks connected during an activation are only called from the next activation onwards.
 */
 template <typename... Args>
 class T3_WIDGET_API signal_t {
  public:
   /// Add a callback to be called on activation.
-  connection_t connect(std::function<void(Args...)> func) {
-    /* Only remove elements from the list if this is not called from within an activation. Doing so
+  template <typename F>
+  connection_t connect(F &&func) {
+    std::shared_ptr<internal::slot_state_t> state = std::make_shared<internal::slot_state_t>();
+    /* Only modify the list of callbacks if this is not called from within an activation. Doing so
        within an activation will mean that we modify a list that is being iterated over, causing
        invalid results. */
-    if (!in_activation_) {
-      for (auto iter = funcs.begin(); iter != funcs.end();) {
-        if (!(*iter)->is_valid()) {
-          // Remove functions that no longer exist.
-          iter = funcs.erase(iter);
-        } else {
-          ++iter;
-        }
-      }
+    if (in_activation_) {
+      pending_slots_.emplace_back(std::forward<F>(func), state);
+    } else {
+      remove_disconnected();
+      slots_.emplace_back(std::forward<F>(func), state);
     }
-    funcs.emplace_back(new internal::func_ptr_t<Args...>(func));
-    return connection_t(funcs.back());
+    return connection_t(state);
   }
 
   /// Activate the signal, i.e. call all the registered active callbacks.
   void operator()(Args... args) const {
+    if (slots_.empty()) {
+      return;
+    }
     bool in_activation = in_activation_;
     in_activation_ = true;
-    for (const std::shared_ptr<internal::func_ptr_base_t> &func : funcs) {
-      if (func->is_valid() && !func->is_blocked()) {
-        static_cast<internal::func_ptr_t<Args...> *>(func.get())->call(args...);
+    for (const slot_t &slot : slots_) {
+      if (slot.state->is_valid() && !slot.state->is_blocked()) {
+        slot.func(args...);
       }
     }
     in_activation_ = in_activation;
+    if (!in_activation_ && !pending_slots_.empty()) {
+      for (slot_t &slot : pending_slots_) {
+        slots_.push_back(std::move(slot));
+      }
+      pending_slots_.clear();
+    }
   }
 
   /** Get a callback which, when called, activates the signal.
@@ -145,8 +248,32 @@ class T3_WIDGET_API signal_t {
   }
 
  private:
+  struct slot_t {
+    template <typename F>
+    slot_t(F &&_func, std::shared_ptr<internal::slot_state_t> _state)
+        : func(std::forward<F>(_func)), state(std::move(_state)) {}
+    internal::slot_function_t<Args...> func;
+    std::shared_ptr<internal::slot_state_t> state;
+  };
+
+  void remove_disconnected() {
+    size_t j = 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].state->is_valid()) {
+        if (i != j) {
+          slots_[j] = std::move(slots_[i]);
+        }
+        ++j;
+      }
+    }
+    slots_.erase(slots_.begin() + j, slots_.end());
+  }
+
   mutable bool in_activation_ = false;
-  std::list<std::shared_ptr<internal::func_ptr_base_t>> funcs;
+  /* The callbacks connected during an activation are stored separately, and moved to slots_ when
+     the outermost activation ends, as modifying slots_ could move the callback that is running. */
+  mutable std::vector<slot_t> slots_;
+  mutable std::vector<slot_t> pending_slots_;
 };
 
 }  // namespace t3widget
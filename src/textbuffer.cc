@@ -32,6 +32,7 @@
 #include "t3widget/textbuffer_impl.h"
 #include "t3widget/textline.h"
 #include "t3widget/tinystring.h"
+#include "t3widget/trace.h"
 #include "t3widget/undo.h"
 #include "t3widget/util.h"
 
@@ -165,6 +166,7 @@ void text_buffer_t::set_selection_from_find(const find_result_t &result) {
 }
 
 bool text_buffer_t::find(finder_t *finder, find_result_t *result, bool reverse) const {
+  trace_scope_t trace("text_buffer_t::find");
   return impl->find(finder, result, reverse);
 }
 
@@ -207,6 +209,22 @@ void text_buffer_t::start_undo_block() { impl->start_undo_block(); }
 
 void text_buffer_t::end_undo_block() { impl->end_undo_block(); }
 
+void text_buffer_t::start_edit_transaction() { impl->start_edit_transaction(); }
+
+void text_buffer_t::end_edit_transaction() { impl->end_edit_transaction(); }
+
+void text_buffer_t::set_undo_memory_limit(size_t limit) { impl->undo_list.set_memory_limit(limit); }
+
+size_t text_buffer_t::get_undo_memory_usage() const { return impl->undo_list.get_memory_usage(); }
+
+size_t text_buffer_t::get_undo_memory_discarded() const {
+  return impl->undo_list.get_memory_discarded();
+}
+
+void text_buffer_t::set_undo_journal_threshold(size_t threshold) {
+  impl->undo_list.set_journal_threshold(threshold);
+}
+
 void text_buffer_t::goto_pos(text_pos_t line, text_pos_t pos) { impl->goto_pos(line, pos); }
 
 text_coordinate_t text_buffer_t::get_cursor() const { return impl->cursor; }
@@ -229,7 +247,7 @@ bool text_buffer_t::implementation_t::insert_char(key_t c) {
     return false;
   }
 
-  rewrap_required(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
 
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 1);
   last_undo_position = cursor;
@@ -242,7 +260,7 @@ bool text_buffer_t::implementation_t::overwrite_char(key_t c) {
     return false;
   }
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
-  rewrap_required(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
 
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 1);
   last_undo_position = cursor;
@@ -255,7 +273,7 @@ bool text_buffer_t::implementation_t::delete_char() {
     return false;
   }
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
-  rewrap_required(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
   return true;
 }
 
@@ -269,7 +287,7 @@ bool text_buffer_t::implementation_t::backspace_char() {
   cursor.pos = newpos;
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
 
-  rewrap_required(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
 
   last_undo_position = cursor;
   return true;
@@ -288,7 +306,7 @@ bool text_buffer_t::implementation_t::backspace_word() {
   cursor.pos = newpos;
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
 
-  rewrap_required(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE_LOCAL, cursor.line, cursor.pos);
 
   last_undo_position = cursor;
   return true;
@@ -299,8 +317,8 @@ bool text_buffer_t::implementation_t::merge_internal(text_pos_t line) {
   cursor.pos = lines[line]->size();
   lines[line]->merge(std::move(lines[line + 1]));
   lines.erase(lines.begin() + line + 1);
-  rewrap_required(rewrap_type_t::DELETE_LINES, line + 1, line + 2);
-  rewrap_required(rewrap_type_t::REWRAP_LINE, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::DELETE_LINES, line + 1, line + 2);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE, cursor.line, cursor.pos);
   return true;
 }
 
@@ -314,19 +332,19 @@ bool text_buffer_t::implementation_t::insert_block_internal(text_coordinate_t in
   }
 
   lines[insert_at.line]->merge(block->break_on_nl(&next_start));
-  rewrap_required(rewrap_type_t::REWRAP_LINE, insert_at.line, insert_at.pos);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE, insert_at.line, insert_at.pos);
 
   while (next_start > 0) {
     insert_at.line++;
     lines.insert(lines.begin() + insert_at.line, block->break_on_nl(&next_start));
-    rewrap_required(rewrap_type_t::INSERT_LINES, insert_at.line, insert_at.line + 1);
+    notify_rewrap(rewrap_type_t::INSERT_LINES, insert_at.line, insert_at.line + 1);
   }
 
   cursor.pos = lines[insert_at.line]->size();
 
   if (second_half != nullptr) {
     lines[insert_at.line]->merge(std::move(second_half));
-    rewrap_required(rewrap_type_t::REWRAP_LINE, insert_at.line, cursor.pos);
+    notify_rewrap(rewrap_type_t::REWRAP_LINE, insert_at.line, cursor.pos);
   }
 
   cursor.line = insert_at.line;
@@ -358,7 +376,7 @@ void text_buffer_t::implementation_t::delete_block_internal(text_coordinate_t st
       undo->get_text()->append(selected_text->get_data());
     }
     cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
-    rewrap_required(rewrap_type_t::REWRAP_LINE, start.line, start.pos);
+    notify_rewrap(rewrap_type_t::REWRAP_LINE, start.line, start.pos);
     return;
   }
 
@@ -431,18 +449,18 @@ void text_buffer_t::implementation_t::delete_block_internal(text_coordinate_t st
   lines.erase(lines.begin() + start.line, lines.begin() + end.line);
   cursor.pos = lines[cursor.line]->adjust_position(cursor.pos, 0);
 
-  rewrap_required(rewrap_type_t::DELETE_LINES, start.line, end.line);
-  rewrap_required(rewrap_type_t::REWRAP_LINE, start.line - 1, start.pos);
+  notify_rewrap(rewrap_type_t::DELETE_LINES, start.line, end.line);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE, start.line - 1, start.pos);
   if (static_cast<size_t>(start.line) < lines.size()) {
-    rewrap_required(rewrap_type_t::REWRAP_LINE, start.line, 0);
+    notify_rewrap(rewrap_type_t::REWRAP_LINE, start.line, 0);
   }
 }
 
 bool text_buffer_t::implementation_t::break_line_internal(const std::string &indent) {
   std::unique_ptr<text_line_t> insert = lines[cursor.line]->break_line(cursor.pos);
   lines.insert(lines.begin() + cursor.line + 1, std::move(insert));
-  rewrap_required(rewrap_type_t::REWRAP_LINE, cursor.line, cursor.pos);
-  rewrap_required(rewrap_type_t::INSERT_LINES, cursor.line + 1, cursor.line + 2);
+  notify_rewrap(rewrap_type_t::REWRAP_LINE, cursor.line, cursor.pos);
+  notify_rewrap(rewrap_type_t::INSERT_LINES, cursor.line + 1, cursor.line + 2);
   cursor.line++;
   if (indent.empty()) {
     cursor.pos = 0;
@@ -699,13 +717,13 @@ void text_buffer_t::implementation_t::apply_undo_redo(undo_type_t type, undo_t *
   switch (type) {
     case UNDO_ADD: {
       end = start = current->get_start();
-      size_t newline = current->get_text()->find_last_of('\n');
-      if (newline == std::string::npos) {
-        end.pos += current->get_text()->size();
+      string_view text = current->get_data();
+      size_t newline = text.rfind('\n');
+      if (newline == string_view::npos) {
+        end.pos += text.size();
       } else {
-        end.pos = current->get_text()->size() - newline - 1;
-        tiny_string_t::iterator begin = current->get_text()->begin();
-        end.line += std::count(begin, begin + newline, '\n') + 1;
+        end.pos = text.size() - newline - 1;
+        end.line += std::count(text.begin(), text.begin() + newline, '\n') + 1;
       }
       delete_block_internal(start, end, nullptr);
       break;
@@ -713,23 +731,23 @@ void text_buffer_t::implementation_t::apply_undo_redo(undo_type_t type, undo_t *
     case UNDO_ADD_REDO:
     case UNDO_DELETE:
       start = current->get_start();
-      insert_block_internal(start, line_factory->new_text_line_t(*current->get_text()));
+      insert_block_internal(start, line_factory->new_text_line_t(current->get_data()));
       if (type == UNDO_DELETE) {
         cursor = start;
       }
       break;
     case UNDO_BACKSPACE:
       start = current->get_start();
-      start.pos -= current->get_text()->size();
-      insert_block_internal(start, line_factory->new_text_line_t(*current->get_text()));
+      start.pos -= current->get_data().size();
+      insert_block_internal(start, line_factory->new_text_line_t(current->get_data()));
       break;
     case UNDO_BACKSPACE_REDO:
       end = start = current->get_start();
-      start.pos -= current->get_text()->size();
+      start.pos -= current->get_data().size();
       delete_block_internal(start, end, nullptr);
       break;
     case UNDO_OVERWRITE: {
-      double_string_adapter_t undo_adapter(current->get_text());
+      const_double_string_adapter_t undo_adapter(current->get_data());
       end = start = current->get_start();
       end.pos += undo_adapter.second().size();
       delete_block_internal(start, end, nullptr);
@@ -738,7 +756,7 @@ void text_buffer_t::implementation_t::apply_undo_redo(undo_type_t type, undo_t *
       break;
     }
     case UNDO_OVERWRITE_REDO: {
-      double_string_adapter_t undo_adapter(current->get_text());
+      const_double_string_adapter_t undo_adapter(current->get_data());
       end = start = current->get_start();
       end.pos += undo_adapter.first().size();
       delete_block_internal(start, end, nullptr);
@@ -754,18 +772,22 @@ void text_buffer_t::implementation_t::apply_undo_redo(undo_type_t type, undo_t *
       cursor = current->get_start();
       break;
     case UNDO_BLOCK_END:
+      start_edit_transaction();
       do {
         current = undo_list.back();
         apply_undo_redo(current->get_type(), current);
       } while (current != nullptr && current->get_type() != UNDO_BLOCK_START);
       ASSERT(current != nullptr);
+      end_edit_transaction();
       break;
     case UNDO_BLOCK_START_REDO:
+      start_edit_transaction();
       do {
         current = undo_list.forward();
         apply_undo_redo(current->get_redo_type(), current);
       } while (current != nullptr && current->get_redo_type() != UNDO_BLOCK_END_REDO);
       ASSERT(current != nullptr);
+      end_edit_transaction();
       break;
     default:
       ASSERT(false);
@@ -774,6 +796,96 @@ void text_buffer_t::implementation_t::apply_undo_redo(undo_type_t type, undo_t *
   last_undo_type = UNDO_NONE;
 }
 
+void text_buffer_t::implementation_t::end_edit_transaction() {
+  ASSERT(edit_transaction_depth > 0);
+  if (--edit_transaction_depth > 0) {
+    return;
+  }
+
+  /* The ranges are reported from the top of the text downwards. The positions of the ranges
+     already reported are then correct for the listeners, while the ranges below the one being
+     reported don't influence its position. */
+  std::vector<changed_lines_t> changes;
+  changes.swap(changed_lines);
+  for (const changed_lines_t &change : changes) {
+    if (change.new_count > change.old_count) {
+      rewrap_required(rewrap_type_t::INSERT_LINES, change.start + change.old_count,
+                      change.start + change.new_count);
+    } else if (change.new_count < change.old_count) {
+      rewrap_required(rewrap_type_t::DELETE_LINES, change.start + change.new_count,
+                      change.start + change.old_count);
+    }
+    for (text_pos_t i = 0; i < std::min(change.new_count, change.old_count); ++i) {
+      rewrap_required(rewrap_type_t::REWRAP_LINE, change.start + i, 0);
+    }
+  }
+  if (rewrap_all_required) {
+    rewrap_all_required = false;
+    rewrap_required(rewrap_type_t::REWRAP_ALL, 0, 0);
+  }
+}
+
+void text_buffer_t::implementation_t::notify_rewrap(rewrap_type_t type, text_pos_t a,
+                                                    text_pos_t b) {
+  if (edit_transaction_depth == 0) {
+    rewrap_required(type, a, b);
+    return;
+  }
+
+  switch (type) {
+    case rewrap_type_t::REWRAP_ALL:
+      rewrap_all_required = true;
+      break;
+    case rewrap_type_t::REWRAP_LINE:
+    case rewrap_type_t::REWRAP_LINE_LOCAL:
+      record_changed_lines(a, 1, 1);
+      break;
+    case rewrap_type_t::INSERT_LINES:
+      record_changed_lines(a, 0, b - a);
+      break;
+    case rewrap_type_t::DELETE_LINES:
+      record_changed_lines(a, b - a, 0);
+      break;
+    default:
+      ASSERT(false);
+  }
+}
+
+void text_buffer_t::implementation_t::record_changed_lines(text_pos_t first, text_pos_t removed,
+                                                           text_pos_t inserted) {
+  const text_pos_t last = first + removed;
+  // Find the first range that overlaps with, or is adjacent to, the changed lines.
+  std::vector<changed_lines_t>::iterator begin =
+      std::lower_bound(changed_lines.begin(), changed_lines.end(), first,
+                       [](const changed_lines_t &range, text_pos_t line) {
+                         return range.start + range.new_count < line;
+                       });
+  std::vector<changed_lines_t>::iterator end = begin;
+
+  /* Merge the changed lines and all ranges it touches into a single range. Lines in the merged
+     range that were not in any of the ranges are unchanged lines, and hence count as old lines as
+     well. */
+  changed_lines_t merged{first, 0, 0};
+  text_pos_t merged_end = last;
+  text_pos_t tracked_lines = 0;
+  for (; end != changed_lines.end() && end->start <= last; ++end) {
+    merged.start = std::min(merged.start, end->start);
+    merged_end = std::max(merged_end, end->start + end->new_count);
+    merged.old_count += end->old_count;
+    tracked_lines += end->new_count;
+  }
+  merged.old_count += merged_end - merged.start - tracked_lines;
+  merged.new_count = merged_end - merged.start - removed + inserted;
+
+  for (std::vector<changed_lines_t>::iterator iter = end; iter != changed_lines.end(); ++iter) {
+    iter->start += inserted - removed;
+  }
+  begin = changed_lines.erase(begin, end);
+  if (merged.new_count != 0 || merged.old_count != 0) {
+    changed_lines.insert(begin, merged);
+  }
+}
+
 void text_buffer_t::implementation_t::set_selection_from_find(const find_result_t &result) {
   selection_start = result.start;
 
@@ -784,10 +896,25 @@ void text_buffer_t::implementation_t::set_selection_from_find(const find_result_
   set_primary(convert_block(selection_start, selection_end));
 }
 
+/** Adapter providing the lines of a text_buffer_t to finder_t::match_lines. */
+class T3_WIDGET_LOCAL buffer_line_source_t : public finder_t::line_source_t {
+ public:
+  buffer_line_source_t(const std::vector<std::unique_ptr<text_line_t>> &lines) : lines_(lines) {}
+  text_pos_t size() const override { return lines_.size(); }
+  const std::string &get_line(text_pos_t idx) const override { return lines_[idx]->get_data(); }
+
+ private:
+  const std::vector<std::unique_ptr<text_line_t>> &lines_;
+};
+
 bool text_buffer_t::implementation_t::find(finder_t *finder, find_result_t *result,
                                            bool reverse) const {
   text_pos_t start, idx;
 
+  if (finder->get_flags() & find_flags_t::MULTI_LINE) {
+    return find_multi_line(finder, result, reverse);
+  }
+
   /* Note: the value of result->start.line and result->end.line are ignored after the
      search has started. The finder->match function does not take those values into
      account. */
@@ -855,11 +982,57 @@ bool text_buffer_t::implementation_t::find(finder_t *finder, find_result_t *resu
   return false;
 }
 
+bool text_buffer_t::implementation_t::find_multi_line(finder_t *finder, find_result_t *result,
+                                                      bool reverse) const {
+  buffer_line_source_t line_source(lines);
+  const text_coordinate_t end_of_text(lines.size(), -1);
+
+  /* Unlike the single line search, the finder handles the complete range in one call. The line
+     numbers in result are therefore significant. */
+  if (((finder->get_flags() & find_flags_t::BACKWARD) != 0) ^ reverse) {
+    const text_coordinate_t start = result->start;
+    result->start = text_coordinate_t(0, -1);
+    result->end = start;
+    if (finder->match_lines(line_source, result, true)) {
+      return true;
+    }
+
+    if (!(finder->get_flags() & find_flags_t::WRAP)) {
+      return false;
+    }
+
+    result->start = start;
+    result->end = end_of_text;
+    return finder->match_lines(line_source, result, true);
+  } else {
+    result->start = cursor;
+    result->end = end_of_text;
+    if (finder->match_lines(line_source, result, false)) {
+      return true;
+    }
+
+    if (!(finder->get_flags() & find_flags_t::WRAP)) {
+      return false;
+    }
+
+    result->start = text_coordinate_t(0, -1);
+    result->end = cursor;
+    return finder->match_lines(line_source, result, false);
+  }
+}
+
 bool text_buffer_t::implementation_t::find_limited(finder_t *finder, text_coordinate_t start,
                                                    text_coordinate_t end,
                                                    find_result_t *result) const {
   text_pos_t idx;
 
+  if (finder->get_flags() & find_flags_t::MULTI_LINE) {
+    buffer_line_source_t line_source(lines);
+    result->start = start;
+    result->end = end;
+    return finder->match_lines(line_source, result, false);
+  }
+
   /* Note: the finder->match function does not take value of result->start.line
      and result->end.line into account. */
   result->start = start;
@@ -891,6 +1064,7 @@ bool text_buffer_t::implementation_t::indent_block(text_coordinate_t &start, tex
   undo_t *undo;
 
   start_undo_block();
+  start_edit_transaction();
   undo = get_undo(UNDO_INDENT, std::min(start, end));
 
   if (tab_spaces) {
@@ -928,6 +1102,7 @@ bool text_buffer_t::implementation_t::indent_block(text_coordinate_t &start, tex
     end.pos += tab_spaces ? tabsize : 1;
   }
   cursor.pos = end.pos;
+  end_edit_transaction();
   end_undo_block();
 
   return true;
@@ -947,13 +1122,13 @@ bool text_buffer_t::implementation_t::undo_indent_selection(undo_t *undo, undo_t
 
   first_line = undo->get_start().line;
 
-  tiny_string_t *undo_text = undo->get_text();
+  string_view undo_text = undo->get_data();
   bool last = false;
   for (; !last; first_line++) {
-    next_pos = undo_text->find('X', pos);
+    next_pos = undo_text.find('X', pos);
 
-    if (next_pos == std::string::npos) {
-      next_pos = undo_text->size();
+    if (next_pos == string_view::npos) {
+      next_pos = undo_text.size();
       last = true;
     }
 
@@ -967,7 +1142,7 @@ bool text_buffer_t::implementation_t::undo_indent_selection(undo_t *undo, undo_t
       text_coordinate_t insert_at(first_line, 0);
       if (next_pos != pos) {
         insert_block_internal(insert_at, line_factory->new_text_line_t(
-                                             string_view(undo_text->data() + pos, next_pos - pos)));
+                                             undo_text.substr(pos, next_pos - pos)));
       }
     }
     pos = next_pos + 1;
@@ -991,6 +1166,7 @@ bool text_buffer_t::implementation_t::unindent_block(text_coordinate_t &start,
   bool text_changed = false;
 
   start_undo_block();
+  start_edit_transaction();
   if (end.line < start.line) {
     delete_start.line = end.line;
     end_line = start.line;
@@ -1049,6 +1225,7 @@ bool text_buffer_t::implementation_t::unindent_block(text_coordinate_t &start,
     undo->get_text()->append(undo_text);
   }
   cursor.line = end.line;
+  end_edit_transaction();
   end_undo_block();
   return true;
 }
@@ -113,6 +113,29 @@ class T3_WIDGET_API text_buffer_t {
   void start_undo_block();
   void end_undo_block();
 
+  /** Start an edit transaction.
+      Until the matching end_edit_transaction call, the changes that would be reported through
+      rewrap_required are merged into ranges of changed lines. These are reported when the outermost
+      transaction ends, which makes large edits much cheaper for the listeners. Note that the
+      listeners, such as the line wrapping of an edit_window_t, are not up to date until then.
+      Transactions may be nested. */
+  void start_edit_transaction();
+  /** End an edit transaction started with start_edit_transaction. */
+  void end_edit_transaction();
+
+  /** Set the maximum number of bytes to use for the undo history.
+      When the limit is exceeded, the oldest undo information is discarded. A value of 0 (the
+      default) means no limit. */
+  void set_undo_memory_limit(size_t limit);
+  /** Retrieve the (estimated) number of bytes currently used by the undo history. */
+  size_t get_undo_memory_usage() const;
+  /** Retrieve the total number of bytes of undo history discarded because of the limit. */
+  size_t get_undo_memory_discarded() const;
+  /** Set the number of bytes of undo information to keep in memory.
+      Older undo information is moved to a (compressed) temporary file, and read back when it is
+      needed. A value of 0 (the default) keeps all undo information in memory. */
+  void set_undo_journal_threshold(size_t threshold);
+
   void goto_next_word_boundary();
   void goto_previous_word_boundary();
 
@@ -23,6 +23,14 @@
 
 namespace t3widget {
 
+/* A range of lines changed during an edit transaction. The lines [start, start + new_count) in the
+   current text replace old_count lines in the text as it was before the transaction. */
+struct changed_lines_t {
+  text_pos_t start;
+  text_pos_t new_count;
+  text_pos_t old_count;
+};
+
 struct text_buffer_t::implementation_t {
   std::vector<std::unique_ptr<text_line_t>> lines;
   text_coordinate_t selection_start;
@@ -38,6 +46,12 @@ struct text_buffer_t::implementation_t {
   signal_t<rewrap_type_t, text_pos_t, text_pos_t> rewrap_required;
   text_coordinate_t cursor;
 
+  int edit_transaction_depth = 0;
+  /** Changes accumulated in the current edit transaction. Sorted, and neither overlapping nor
+      adjacent. */
+  std::vector<changed_lines_t> changed_lines;
+  bool rewrap_all_required = false;
+
   implementation_t(text_line_factory_t *_line_factory)
       : selection_start(-1, 0),
         selection_end(-1, 0),
@@ -82,11 +96,18 @@ struct text_buffer_t::implementation_t {
   void start_undo_block() { get_undo(UNDO_BLOCK_START); }
   void end_undo_block() { get_undo(UNDO_BLOCK_END); }
   void set_undo_mark();
+  void start_edit_transaction() { ++edit_transaction_depth; }
+  void end_edit_transaction();
+  /** Emit rewrap_required, or record the change if an edit transaction is active. */
+  void notify_rewrap(rewrap_type_t type, text_pos_t a, text_pos_t b);
+  /** Record that the lines [first, first + removed) are replaced by @p inserted lines. */
+  void record_changed_lines(text_pos_t first, text_pos_t removed, text_pos_t inserted);
   void apply_undo_redo(undo_type_t type, undo_t *current);
   void set_selection_from_find(const find_result_t &result);
   bool find(finder_t *finder, find_result_t *result, bool reverse) const;
   bool find_limited(finder_t *finder, text_coordinate_t start, text_coordinate_t end,
                     find_result_t *result) const;
+  bool find_multi_line(finder_t *finder, find_result_t *result, bool reverse) const;
   bool indent_block(text_coordinate_t &start, text_coordinate_t &end, int tabsize, bool tab_spaces);
   bool indent_selection(int tabsize, bool tab_spaces);
   bool undo_indent_selection(undo_t *undo, undo_type_t type);
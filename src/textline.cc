@@ -21,6 +21,7 @@
 #include <string>
 #include <t3window/utf8.h>
 #include <type_traits>
+#include <typeinfo>
 #include <unictype.h>
 
 #include "t3widget/colorscheme.h"
@@ -306,6 +307,30 @@ t3_attr_t text_line_t::get_draw_attrs(text_pos_t i, const text_line_t::paint_inf
   return retval;
 }
 
+t3_attr_t text_line_t::get_draw_attrs(text_pos_t i, const text_line_t::paint_info_t &info,
+                                      bool constant_base_attr, text_pos_t *attr_end) const {
+  const t3_attr_t result = get_draw_attrs(i, info);
+  const char *buffer_data = impl->buffer.data();
+  text_pos_t end = i + 1;
+
+  /* Printable ASCII characters are all drawn the same way, so if the base attribute doesn't vary
+     the attributes only change at the selection and cursor boundaries. */
+  if (constant_base_attr && buffer_data[i] >= 0x20 && buffer_data[i] < 0x7f) {
+    text_pos_t limit = std::min<text_pos_t>(impl->buffer.size(), info.max);
+    for (text_pos_t boundary :
+         {info.selection_start, info.selection_end, info.cursor, info.cursor + 1}) {
+      if (boundary > i && boundary < limit) {
+        limit = boundary;
+      }
+    }
+    while (end < limit && buffer_data[end] >= 0x20 && buffer_data[end] < 0x7f) {
+      ++end;
+    }
+  }
+  *attr_end = end;
+  return result;
+}
+
 void text_line_t::paint_line(t3window::window_t *win, const text_line_t::paint_info_t &info) const {
   int tabspaces, endchars = 0;
   bool _is_print, new_is_print;
@@ -332,12 +357,16 @@ void text_line_t::paint_line(t3window::window_t *win, const text_line_t::paint_i
 
   const size_t buffer_size = impl->buffer.size();
   const char *buffer_data = impl->buffer.data();
+  /* Subclasses may override get_base_attr, in which case the attributes have to be determined for
+     each character separately. */
+  const bool constant_base_attr = typeid(*this) == typeid(text_line_t);
+  text_pos_t attr_end = 0;
 
   text_pos_t i;
   for (i = info.start; static_cast<size_t>(i) < buffer_size && i < info.max && total < info.leftcol;
        i += byte_width_from_first(i)) {
-    if (width_at(i) != 0) {
-      selection_attr = get_draw_attrs(i, info);
+    if (i >= attr_end && width_at(i) != 0) {
+      selection_attr = get_draw_attrs(i, info, constant_base_attr, &attr_end);
     }
 
     if (buffer_data[i] == '\t' && !(flags & text_line_t::TAB_AS_CONTROL)) {
@@ -405,8 +434,8 @@ void text_line_t::paint_line(t3window::window_t *win, const text_line_t::paint_i
   new_selection_attr = selection_attr;
   for (; static_cast<size_t>(i) < buffer_size && i < info.max && total + accumulated < size;
        i += byte_width_from_first(i)) {
-    if (width_at(i) != 0) {
-      new_selection_attr = get_draw_attrs(i, info);
+    if (i >= attr_end && width_at(i) != 0) {
+      new_selection_attr = get_draw_attrs(i, info, constant_base_attr, &attr_end);
     }
 
     /* If selection changed between this char and the previous, print what
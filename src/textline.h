@@ -88,6 +88,10 @@ class T3_WIDGET_API text_line_t {
   static int width_at(string_view str, text_pos_t pos);
 
   t3_attr_t get_draw_attrs(text_pos_t i, const paint_info_t &info) const;
+  /* Get the attributes for the character at position i, and in attr_end the position up to which
+     the attributes are known to remain the same. */
+  t3_attr_t get_draw_attrs(text_pos_t i, const paint_info_t &info, bool constant_base_attr,
+                           text_pos_t *attr_end) const;
 
   void fill_line(string_view _buffer);
   bool check_boundaries(text_pos_t match_start, text_pos_t match_end) const;
@@ -295,6 +295,8 @@ void tiny_string_t::reserve(size_t reserved_size) {
   }
 }
 
+size_t tiny_string_t::capacity() const { return is_short() ? max_short_size() : ptr->allocated; }
+
 void tiny_string_t::shrink_to_fit() {
   if (!is_short()) {
     if (ptr->size <= max_short_size()) {
@@ -304,8 +306,9 @@ void tiny_string_t::shrink_to_fit() {
       std::free(ptr);
       mutable_signal_byte() = original_size * 2 + 1;
       memcpy(mutable_data(), data, original_size);
-    } else {
+    } else if (ptr->allocated != ptr->size) {
       realloc_ptr(ptr->size);
+      ptr->allocated = ptr->size;
     }
   }
 }
@@ -128,11 +128,12 @@ class T3_WIDGET_API tiny_string_t {
   bool empty() const;
 
   void reserve(size_t reserved_size);
+  size_t capacity() const;
 
   void shrink_to_fit();
 
   // FIXME: implement the following functions:
-  // front, back, max_size, capacity, erase, push_back, pop_back, starts_with, ends_with,
+  // front, back, max_size, erase, push_back, pop_back, starts_with, ends_with,
   // substr, copy, resize, swap, comparison operators, operator>>, operator<<
 
   static constexpr size_t npos = std::numeric_limits<size_t>::max();
@@ -0,0 +1,120 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cstdlib>
+#include <mutex>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "t3widget/log.h"
+#include "t3widget/trace.h"
+
+namespace t3widget {
+
+/* Trace events are collected in memory, and written to the trace file in batches, using the JSON
+   array format of the Chrome trace event format. The resulting file can be loaded in
+   chrome://tracing or https://ui.perfetto.dev. */
+
+std::atomic<bool> trace_enabled{false};
+
+struct trace_event_t {
+  const char *name;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
+  int thread;
+};
+
+static const size_t trace_batch_size = 4096;
+
+static std::mutex trace_lock;
+static FILE *trace_file;
+static std::chrono::steady_clock::time_point trace_start;
+static std::vector<trace_event_t> trace_events;
+static bool trace_first_event;
+static std::atomic<int> trace_next_thread{1};
+
+static int trace_thread_id() {
+  static thread_local int id = trace_next_thread.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+/* Must be called with trace_lock held. */
+static void write_trace_events() {
+  int pid = getpid();
+  for (const trace_event_t &event : trace_events) {
+    double ts = std::chrono::duration<double, std::micro>(event.start - trace_start).count();
+    double dur = std::chrono::duration<double, std::micro>(event.end - event.start).count();
+    fprintf(trace_file,
+            "%s{\"name\":\"%s\",\"cat\":\"t3widget\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":%d,\"tid\":%d}",
+            trace_first_event ? "\n" : ",\n", event.name, ts, dur, pid, event.thread);
+    trace_first_event = false;
+  }
+  trace_events.clear();
+  fflush(trace_file);
+}
+
+void init_trace(const optional<std::string> &file_name) {
+  static bool atexit_registered;
+  const char *name = file_name.is_valid() ? file_name.value().c_str() : getenv("T3_WIDGET_TRACE");
+  if (name == nullptr || *name == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(trace_lock);
+  if (trace_file != nullptr) {
+    return;
+  }
+  if ((trace_file = fopen(name, "w")) == nullptr) {
+    llog(LOG_WARNING, GENERAL, "Could not open trace file %s\n", name);
+    return;
+  }
+  fputc('[', trace_file);
+  trace_first_event = true;
+  trace_start = std::chrono::steady_clock::now();
+  trace_events.reserve(trace_batch_size);
+  if (!atexit_registered) {
+    atexit(stop_trace);
+    atexit_registered = true;
+  }
+  trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+void stop_trace() {
+  std::lock_guard<std::mutex> guard(trace_lock);
+  trace_enabled.store(false, std::memory_order_relaxed);
+  if (trace_file == nullptr) {
+    return;
+  }
+  write_trace_events();
+  fputs("\n]\n", trace_file);
+  fclose(trace_file);
+  trace_file = nullptr;
+}
+
+void add_trace_event(const char *name, std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end) {
+  int thread = trace_thread_id();
+  std::lock_guard<std::mutex> guard(trace_lock);
+  // Tracing may have been stopped while this scope was active.
+  if (trace_file == nullptr) {
+    return;
+  }
+  trace_events.push_back(trace_event_t{name, start, end, thread});
+  if (trace_events.size() >= trace_batch_size) {
+    write_trace_events();
+  }
+}
+
+}  // namespace t3widget
@@ -0,0 +1,65 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_TRACE_H
+#define T3_WIDGET_TRACE_H
+
+#ifndef _T3_WIDGET_INTERNAL
+#error This header file is for internal use _only_!!
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <t3widget/util.h>
+#include <t3widget/widget_api.h>
+
+namespace t3widget {
+
+T3_WIDGET_LOCAL extern std::atomic<bool> trace_enabled;
+
+/** Start writing trace events to @p file_name, or to the file named in the @c T3_WIDGET_TRACE
+    environment variable if @p file_name is not set. Does nothing if neither is set. */
+T3_WIDGET_LOCAL void init_trace(const optional<std::string> &file_name);
+/** Stop tracing, and write all remaining trace events to the trace file. */
+T3_WIDGET_LOCAL void stop_trace();
+T3_WIDGET_LOCAL void add_trace_event(const char *name, std::chrono::steady_clock::time_point start,
+                                     std::chrono::steady_clock::time_point end);
+
+/** Records the time spent in a scope as a trace event, if tracing is enabled.
+
+    The @p name passed to the constructor must be a string literal, which is written to the
+    trace file without escaping. When tracing is disabled, the only cost is checking a flag. */
+class T3_WIDGET_LOCAL trace_scope_t {
+ public:
+  explicit trace_scope_t(const char *_name)
+      : name(trace_enabled.load(std::memory_order_relaxed) ? _name : nullptr) {
+    if (name != nullptr) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+  ~trace_scope_t() {
+    if (name != nullptr) {
+      add_trace_event(name, start, std::chrono::steady_clock::now());
+    }
+  }
+  trace_scope_t(const trace_scope_t &) = delete;
+  trace_scope_t &operator=(const trace_scope_t &) = delete;
+
+ private:
+  const char *name;
+  std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace t3widget
+#endif
@@ -11,25 +11,94 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <deque>
+#include <memory>
+#include <sys/types.h>
 #include <type_traits>
+#include <unistd.h>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
 
+#include "t3widget/internal.h"
+#include "t3widget/log.h"
+#include "t3widget/string_view.h"
 #include "t3widget/tinystring.h"
 #include "t3widget/undo.h"
 #include "t3widget/util.h"
 
 namespace t3widget {
 struct undo_list_t::implementation_t {
+  /** A chunk of memory in the undo log. */
+  struct chunk_t {
+    /** The contents of the chunk, or @c nullptr if the chunk has been moved to the journal. */
+    std::unique_ptr<char[]> data;
+    size_t size;
+    size_t used;
+    /** Offset of the chunk in the journal. */
+    off_t journal_offset;
+    /** Number of bytes used by the chunk in the journal. */
+    size_t journal_size;
+    /** Whether the chunk has been compressed before writing it to the journal. */
+    bool compressed;
+  };
+  /** Default size of the chunks in the undo log. Larger texts get a chunk of their own. */
+  static constexpr size_t chunk_size = 64 * 1024;
+  /** Initial capacity of the text buffer for entries which have not been finalized yet. */
+  static constexpr size_t initial_open_text_size = 256;
+
   std::deque<undo_t> list;
   std::deque<undo_t>::iterator current = list.end(), mark = list.end();
   bool mark_is_valid = true;
   bool mark_beyond_current = false;
 
+  /** The chunks of the undo log. Chunks are numbered consecutively, starting at first_chunk. */
+  std::deque<chunk_t> chunks;
+  uint32_t first_chunk = 0;
+  /** Number of bytes allocated for the chunks of the undo log which are held in memory. */
+  size_t log_memory = 0;
+
+  /* Old chunks of the log can be moved to the journal: a temporary file, to which chunks are
+     appended (compressed, if zlib is available). The chunks in the journal always form a prefix of
+     the log, because only the oldest chunks in memory are moved to the journal, and only the chunk
+     at the end of the log is read back permanently. */
+  /** Number of bytes of the log to keep in memory, or 0 to keep all of it in memory. */
+  size_t journal_threshold = 0;
+  std::FILE *journal = nullptr;
+  off_t journal_end = 0;
+  /** Number of the first chunk which is held in memory. */
+  uint32_t first_resident_chunk = 0;
+  /** Copy of the chunk from the journal most recently accessed through get_data. */
+  std::unique_ptr<char[]> loaded_data;
+  size_t loaded_size = 0;
+  uint32_t loaded_chunk = 0;
+  bool loaded_valid = false;
+
+  /** The most recently added entry, if it has not been finalized yet. */
+  undo_t *open_entry = nullptr;
+  /** The text of #open_entry. */
+  tiny_string_t open_text;
+
+  size_t memory_limit = 0;
+  size_t memory_discarded = 0;
+
+  implementation_t() { open_text.reserve(initial_open_text_size); }
+  ~implementation_t() {
+    if (journal != nullptr) {
+      std::fclose(journal);
+    }
+  }
+
   undo_t *add(undo_type_t type, text_coordinate_t coord) {
+    finalize();
     if (list.empty()) {
-      mark = list.emplace(list.end(), type, coord);
+      mark = list.emplace(list.end(), this, type, coord);
       current = list.end();
-      return &*mark;
+      open_entry = &*mark;
+      return open_entry;
     }
 
     // Everything beyond current will be deleted, so mark will be invalid afterwards.
@@ -39,20 +108,25 @@ struct undo_list_t::implementation_t {
 
     const bool mark_at_current = mark_is_valid && current == mark;
     if (current != list.end()) {
+      // The text of the deleted entries is at the end of the log, so it can be reclaimed.
+      truncate_log(*current);
       list.erase(current, list.end());
     }
-    auto iter = list.emplace(list.end(), type, coord);
+    auto iter = list.emplace(list.end(), this, type, coord);
     current = list.end();
     if (mark_at_current) {
       mark = iter;
     }
-    return &*iter;
+    open_entry = &*iter;
+    enforce_memory_limit();
+    return open_entry;
   }
 
   undo_t *back() {
     if (current == list.begin()) {
       return nullptr;
     }
+    finalize();
 
     if (mark_is_valid && current == mark) {
       mark_beyond_current = true;
@@ -81,8 +155,262 @@ struct undo_list_t::implementation_t {
   }
 
   bool is_at_mark() const { return mark_is_valid && mark == current; }
+
+  /** Append the text of #open_entry to the log. */
+  void finalize() {
+    if (open_entry == nullptr) {
+      return;
+    }
+    append_to_log(open_entry, open_text);
+    open_entry = nullptr;
+    if (open_text.capacity() > chunk_size) {
+      // Don't hold on to the memory used for exceptionally large entries.
+      open_text = tiny_string_t();
+      open_text.reserve(initial_open_text_size);
+    } else {
+      open_text.clear();
+    }
+  }
+
+  void append_to_log(undo_t *entry, string_view text) {
+    if (!text.empty() && (chunks.empty() || !chunks.back().data ||
+                          chunks.back().size - chunks.back().used < text.size())) {
+      const size_t size = std::max(chunk_size, text.size());
+      chunks.push_back(chunk_t{std::unique_ptr<char[]>(new char[size]), size, 0, 0, 0, false});
+      log_memory += size;
+      move_to_journal();
+    }
+    /* Entries without text still get a position in the log, such that truncate_log can use it.
+       If there are no chunks, the position refers to the chunk that will be allocated next. */
+    entry->chunk = first_chunk + chunks.size() - (chunks.empty() ? 0 : 1);
+    entry->chunk_offset = chunks.empty() ? 0 : chunks.back().used;
+    entry->text_size = text.size();
+    if (!text.empty()) {
+      chunk_t &tail = chunks.back();
+      std::memcpy(tail.data.get() + tail.used, text.data(), text.size());
+      tail.used += text.size();
+    }
+  }
+
+  /** Remove the text of @p entry, and everything after it, from the log. */
+  void truncate_log(const undo_t &entry) {
+    while (!chunks.empty() && first_chunk + chunks.size() > entry.chunk + 1) {
+      pop_back_chunk();
+    }
+    if (!chunks.empty() && first_chunk + chunks.size() == entry.chunk + 1) {
+      chunk_t &tail = chunks.back();
+      if (!tail.data) {
+        // New text will be appended to this chunk, so it has to be in memory again.
+        std::unique_ptr<char[]> data(new char[tail.size]);
+        if (entry.chunk_offset > 0 && !read_from_journal(tail, data.get())) {
+          /* The text in this chunk is still needed by the entries before entry. Without it, those
+             entries can't be undone correctly anymore, so start a new chunk instead. */
+          llog(LOG_WARNING, UNDO, "Could not read undo journal, starting new chunk\n");
+          return;
+        }
+        tail.data = std::move(data);
+        log_memory += tail.size;
+        first_resident_chunk = first_chunk + chunks.size() - 1;
+        journal_end = tail.journal_offset;
+      }
+      tail.used = entry.chunk_offset;
+    }
+  }
+
+  void pop_back_chunk() {
+    chunk_t &tail = chunks.back();
+    if (tail.data) {
+      log_memory -= tail.size;
+    } else {
+      journal_end = tail.journal_offset;
+      first_resident_chunk = first_chunk + chunks.size() - 1;
+    }
+    if (loaded_valid && loaded_chunk == first_chunk + chunks.size() - 1) {
+      loaded_valid = false;
+    }
+    chunks.pop_back();
+  }
+
+  /** Move the oldest chunks in memory to the journal, until the threshold is met. */
+  void move_to_journal() {
+    if (journal_threshold == 0) {
+      return;
+    }
+    // The last chunk is still being appended to, and always remains in memory.
+    while (log_memory > journal_threshold && first_resident_chunk + 1 < first_chunk + chunks.size()) {
+      chunk_t &chunk = chunks[first_resident_chunk - first_chunk];
+      if (!write_to_journal(&chunk)) {
+        llog(LOG_WARNING, UNDO,
+             "Could not write undo journal, keeping undo information in memory\n");
+        journal_threshold = 0;
+        return;
+      }
+      chunk.data.reset();
+      log_memory -= chunk.size;
+      ++first_resident_chunk;
+    }
+  }
+
+  bool write_to_journal(chunk_t *chunk) {
+    if (journal == nullptr) {
+      // tmpfile removes the file when it is closed, or when the program terminates.
+      journal = std::tmpfile();
+      if (journal == nullptr) {
+        return false;
+      }
+      journal_end = 0;
+    }
+
+    const char *data = chunk->data.get();
+    size_t size = chunk->used;
+    chunk->compressed = false;
+#ifdef HAS_ZLIB
+    uLongf compressed_size = compressBound(chunk->used);
+    std::unique_ptr<char[]> compressed(new char[compressed_size]);
+    if (compress2(reinterpret_cast<Bytef *>(compressed.get()), &compressed_size,
+                  reinterpret_cast<const Bytef *>(data), chunk->used, Z_BEST_SPEED) == Z_OK &&
+        compressed_size < chunk->used) {
+      data = compressed.get();
+      size = compressed_size;
+      chunk->compressed = true;
+    }
+#endif
+    const int fd = fileno(journal);
+    if (lseek(fd, journal_end, SEEK_SET) != journal_end ||
+        nosig_write(fd, data, size) != static_cast<ssize_t>(size)) {
+      return false;
+    }
+    chunk->journal_offset = journal_end;
+    chunk->journal_size = size;
+    journal_end += size;
+    return true;
+  }
+
+  /** Read the contents of @p chunk from the journal into @p data, which must hold chunk.used bytes. */
+  bool read_from_journal(const chunk_t &chunk, char *data) {
+    const int fd = fileno(journal);
+    if (lseek(fd, chunk.journal_offset, SEEK_SET) != chunk.journal_offset) {
+      return false;
+    }
+#ifdef HAS_ZLIB
+    if (chunk.compressed) {
+      std::unique_ptr<char[]> compressed(new char[chunk.journal_size]);
+      uLongf size = chunk.used;
+      return nosig_read(fd, compressed.get(), chunk.journal_size) ==
+                 static_cast<ssize_t>(chunk.journal_size) &&
+             uncompress(reinterpret_cast<Bytef *>(data), &size,
+                        reinterpret_cast<const Bytef *>(compressed.get()),
+                        chunk.journal_size) == Z_OK &&
+             size == chunk.used;
+    }
+#endif
+    return nosig_read(fd, data, chunk.used) == static_cast<ssize_t>(chunk.used);
+  }
+
+  /** Free the chunks at the start of the log, which are no longer referenced by any entry. */
+  void release_unused_chunks() {
+    const uint32_t first_needed =
+        list.empty() || &list.front() == open_entry ? first_chunk + chunks.size() : list.front().chunk;
+    while (!chunks.empty() && first_chunk < first_needed) {
+      if (chunks.front().data) {
+        log_memory -= chunks.front().size;
+      }
+      if (loaded_valid && loaded_chunk == first_chunk) {
+        loaded_valid = false;
+      }
+      chunks.pop_front();
+      ++first_chunk;
+    }
+    if (first_resident_chunk <= first_chunk) {
+      first_resident_chunk = first_chunk;
+      // Nothing in the journal is referenced anymore, so start from scratch.
+      if (journal_end > 0 && ftruncate(fileno(journal), 0) == 0) {
+        journal_end = 0;
+      }
+    }
+  }
+
+  string_view get_data(const undo_t *entry) {
+    if (entry == open_entry) {
+      return open_text;
+    }
+    if (entry->text_size == 0) {
+      return string_view();
+    }
+    const chunk_t &chunk = chunks[entry->chunk - first_chunk];
+    if (chunk.data) {
+      return string_view(chunk.data.get() + entry->chunk_offset, entry->text_size);
+    }
+
+    if (!loaded_valid || loaded_chunk != entry->chunk) {
+      if (loaded_size < chunk.used) {
+        loaded_data.reset(new char[chunk.used]);
+        loaded_size = chunk.used;
+      }
+      loaded_valid = read_from_journal(chunk, loaded_data.get());
+      if (!loaded_valid) {
+        llog(LOG_WARNING, UNDO, "Could not read undo journal\n");
+        return string_view();
+      }
+      loaded_chunk = entry->chunk;
+    }
+    return string_view(loaded_data.get() + entry->chunk_offset, entry->text_size);
+  }
+
+  size_t get_memory_usage() const {
+    return list.size() * sizeof(undo_t) + log_memory + open_text.capacity() + loaded_size;
+  }
+
+  /* Returns the iterator just past the oldest undo operation that may be discarded, or
+     list.begin() if it may not be discarded. An operation is either a single entry, or a complete
+     block including any nested blocks. */
+  std::deque<undo_t>::iterator end_of_oldest_operation() {
+    auto iter = list.begin();
+    int depth = 0;
+    do {
+      if (iter == current || iter + 1 == list.end()) {
+        return list.begin();
+      }
+      if (iter->get_type() == UNDO_BLOCK_START) {
+        ++depth;
+      } else if (iter->get_type() == UNDO_BLOCK_END) {
+        --depth;
+      }
+      ++iter;
+    } while (depth > 0);
+    return iter;
+  }
+
+  void enforce_memory_limit() {
+    if (memory_limit == 0) {
+      return;
+    }
+    /* Memory is only returned when a complete chunk of the log is no longer used. However, each
+       discarded entry also frees its record, so this loop always terminates. */
+    while (get_memory_usage() > memory_limit) {
+      auto end = end_of_oldest_operation();
+      if (end == list.begin()) {
+        return;
+      }
+      for (auto iter = list.begin(); iter != end; ++iter) {
+        // The state before the discarded operation can no longer be reached.
+        if (mark_is_valid && iter == mark) {
+          mark_is_valid = false;
+        }
+      }
+      const size_t memory_before = get_memory_usage();
+      /* Erasing at the front of a deque, without erasing the last element, only invalidates
+         iterators to the erased elements. Hence current and mark remain valid. */
+      list.erase(list.begin(), end);
+      release_unused_chunks();
+      memory_discarded += memory_before - get_memory_usage();
+    }
+  }
 };
 
+constexpr size_t undo_list_t::implementation_t::chunk_size;
+constexpr size_t undo_list_t::implementation_t::initial_open_text_size;
+
 undo_list_t::undo_list_t() : impl(new implementation_t) {}
 undo_list_t::~undo_list_t() {}
 
@@ -98,6 +426,24 @@ void undo_list_t::set_mark() { impl->set_mark(); }
 
 bool undo_list_t::is_at_mark() const { return impl->is_at_mark(); }
 
+void undo_list_t::set_memory_limit(size_t limit) {
+  impl->memory_limit = limit;
+  impl->enforce_memory_limit();
+}
+
+size_t undo_list_t::get_memory_limit() const { return impl->memory_limit; }
+
+size_t undo_list_t::get_memory_usage() const { return impl->get_memory_usage(); }
+
+size_t undo_list_t::get_memory_discarded() const { return impl->memory_discarded; }
+
+void undo_list_t::set_journal_threshold(size_t threshold) {
+  impl->journal_threshold = threshold;
+  impl->move_to_journal();
+}
+
+size_t undo_list_t::get_journal_threshold() const { return impl->journal_threshold; }
+
 #if 0
 #ifdef DEBUG
 #include "log.h"
@@ -153,8 +499,16 @@ undo_type_t undo_t::redo_map[] = {
 undo_type_t undo_t::get_type() const { return type; }
 undo_type_t undo_t::get_redo_type() const { return redo_map[type]; }
 text_coordinate_t undo_t::get_start() { return start; }
-void undo_t::add_newline() { text.append(1, '\n'); }
-tiny_string_t *undo_t::get_text() { return &text; }
-void undo_t::minimize() { text.shrink_to_fit(); }
+void undo_t::add_newline() { get_text()->append(1, '\n'); }
+tiny_string_t *undo_t::get_text() {
+  ASSERT(this == owner->open_entry);
+  return &owner->open_text;
+}
+string_view undo_t::get_data() const { return owner->get_data(this); }
+void undo_t::minimize() {
+  if (this == owner->open_entry) {
+    owner->finalize();
+  }
+}
 
 }  // namespace t3widget
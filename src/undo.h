@@ -14,7 +14,9 @@
 #ifndef T3_WIDGET_UNDO_H
 #define T3_WIDGET_UNDO_H
 
+#include <cstdint>
 #include <string>
+#include <t3widget/string_view.h>
 #include <t3widget/textline.h>
 #include <t3widget/tinystring.h>
 #include <t3widget/util.h>
@@ -47,8 +49,14 @@ enum undo_type_t {
   UNDO_BLOCK_END_REDO,
 };
 
+/* The undo list stores the text of all undo entries in a single append-only log, consisting of
+   large chunks of memory. Each undo_t is a small fixed-size record, pointing to its text in the
+   log. Only the most recently added entry, which can still be extended, stores its text in a
+   separate buffer, which is re-used for each new entry. It is appended to the log when the entry
+   is finalized. */
 class T3_WIDGET_API undo_list_t {
  private:
+  friend class undo_t;
   struct T3_WIDGET_LOCAL implementation_t;
   pimpl_t<implementation_t> impl;
 
@@ -61,6 +69,24 @@ class T3_WIDGET_API undo_list_t {
   void set_mark();
   bool is_at_mark() const;
 
+  /** Set the maximum number of bytes used by the undo history.
+      When the limit is exceeded, the oldest entries are discarded. Blocks of entries are always
+      discarded as a whole, and neither the most recent entry nor entries that can still be redone
+      are discarded. A value of 0 means no limit. */
+  void set_memory_limit(size_t limit);
+  size_t get_memory_limit() const;
+  /** Retrieve the (estimated) number of bytes used by the undo history. */
+  size_t get_memory_usage() const;
+  /** Retrieve the total number of bytes discarded to stay within the memory limit. */
+  size_t get_memory_discarded() const;
+
+  /** Set the number of bytes of undo text to keep in memory.
+      Older text is moved to a temporary file, and read back when required. Text in the temporary
+      file does not count towards the memory limit. A value of 0 (the default) keeps all text in
+      memory. */
+  void set_journal_threshold(size_t threshold);
+  size_t get_journal_threshold() const;
+
 #ifdef DEBUG
   void dump();
 #endif
@@ -68,19 +94,34 @@ class T3_WIDGET_API undo_list_t {
 
 class T3_WIDGET_API undo_t {
  private:
+  friend struct undo_list_t::implementation_t;
   static undo_type_t redo_map[];
 
-  tiny_string_t text;
+  undo_list_t::implementation_t *owner;
   text_coordinate_t start;
+  /** Size of the text in the log. Only valid if the entry has been finalized. */
+  size_t text_size;
+  /** Index of the log chunk holding the text. */
+  uint32_t chunk;
+  /** Offset of the text in the log chunk. */
+  uint32_t chunk_offset;
   undo_type_t type;
 
  public:
-  undo_t(undo_type_t _type, text_coordinate_t _start) : start(_start), type(_type) {}
+  undo_t(undo_list_t::implementation_t *_owner, undo_type_t _type, text_coordinate_t _start)
+      : owner(_owner), start(_start), text_size(0), chunk(0), chunk_offset(0), type(_type) {}
   undo_type_t get_type() const;
   undo_type_t get_redo_type() const;
   text_coordinate_t get_start();
   void add_newline();
+  /** Retrieve the text buffer of the entry, for extending it.
+      Only allowed for the most recently added entry, before it is finalized. */
   tiny_string_t *get_text();
+  /** Retrieve the text of the entry.
+      If the text has been moved to the journal, the returned value is only valid until the next
+      call to get_data. */
+  string_view get_data() const;
+  /** Finalize the entry, i.e. append its text to the log. */
   void minimize();
 };
 
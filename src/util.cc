@@ -294,7 +294,8 @@ std::string get_working_directory() {
     buffer = result;
     if ((result = getcwd(buffer, buffer_max)) == nullptr) {
       if (errno != ERANGE) {
-        lprintf("Could not get working directory (returning /): %s\n", strerror(errno));
+        llog(LOG_WARNING, GENERAL, "Could not get working directory (returning /): %s\n",
+             strerror(errno));
         return "/";
       }
 
@@ -225,8 +225,8 @@ class propagate_const {
 
   propagate_const &operator=(const propagate_const &) = delete;
 
-  element_type *get() { t_.get(); }
-  const element_type *get() const { t_.get(); }
+  element_type *get() { return t_.get(); }
+  const element_type *get() const { return t_.get(); }
   explicit operator bool() const { return static_cast<bool>(t_); }
 
   element_type &operator*() { return *t_.get(); }
@@ -305,10 +305,42 @@ enum {
   ANCHOR_WORD_LEFT = (1 << 5),
   ANCHOR_WORD_RIGHT = (1 << 6),
   VALID = (1 << 7),
-  REPLACEMENT_VALID = (1 << 8)
+  REPLACEMENT_VALID = (1 << 8),
+  /** Allow regular expression matches to span multiple lines. */
+  MULTI_LINE = (1 << 9)
 };
 }  // namespace find_flags_t
 
+/** Severity levels of the debug log, in increasing verbosity. See #set_log_filter. */
+enum class log_level_t { LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_DEBUG };
+
+/** Categories of messages in the debug log. See #set_log_filter. */
+namespace log_category_t {
+enum {
+  GENERAL = (1 << 0),
+  KEYS = (1 << 1),
+  MOUSE = (1 << 2),
+  CLIPBOARD = (1 << 3),
+  UNDO = (1 << 4),
+  DRAW = (1 << 5),
+  FIND = (1 << 6),
+  ALL = (1 << 7) - 1
+};
+}  // namespace log_category_t
+
+/** Select the messages written to the debug log.
+    @param level The most verbose level of messages to write.
+    @param categories A logical or of the categories from log_category_t to write.
+
+    The debug log is only available when the library is compiled with debugging enabled. In other
+    builds this function does nothing. The log is written to @c libt3widgetlog.txt in the current
+    directory if the @c T3_WIDGET_LOG environment variable is set when calling #init. The variable
+    holds a level name, optionally followed by a colon and a comma separated list of category
+    names (e.g. @c debug:keys,mouse), to set the initial selection. If no categories are
+    specified, all categories are selected.
+*/
+T3_WIDGET_API void set_log_filter(log_level_t level, int categories);
+
 enum class find_action_t { FIND, SKIP, REPLACE, REPLACE_ALL, REPLACE_IN_SELECTION };
 
 /** Constants for indicating which attribute to change/retrieve. */
@@ -14,6 +14,7 @@
 #ifndef T3_WIDGET_H
 #define T3_WIDGET_H
 
+#include <t3widget/headless.h>
 #include <t3widget/key.h>
 #include <t3widget/main.h>
 #include <t3widget/signals.h>
@@ -48,6 +49,7 @@
 #include <t3widget/widgets/split.h>
 #include <t3widget/widgets/textfield.h>
 #include <t3widget/widgets/textwindow.h>
+#include <t3widget/widgets/virtuallist.h>
 #include <t3widget/widgets/widget.h>
 #include <t3widget/widgets/widgetgroup.h>
 
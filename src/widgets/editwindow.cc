@@ -19,7 +19,9 @@
 #include <stdio.h>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
 #include <utility>
+#include <vector>
 
 #include "t3widget/autocompleter.h"
 #include "t3widget/clipboard.h"
@@ -38,11 +40,13 @@
 #include "t3widget/key_binding.h"
 #include "t3widget/log.h"
 #include "t3widget/main.h"
+#include "t3widget/modified_xxhash.h"
 #include "t3widget/mouse.h"
 #include "t3widget/signals.h"
 #include "t3widget/string_view.h"
 #include "t3widget/textbuffer.h"
 #include "t3widget/textline.h"
+#include "t3widget/trace.h"
 #include "t3widget/util.h"
 #include "t3widget/widget_api.h"
 #include "t3widget/widgets/editwindow.h"
@@ -130,8 +134,19 @@ struct edit_window_t::implementation_t {
   std::unique_ptr<autocomplete_panel_t>
       autocomplete_panel; /**< Panel for showing autocomplete options. */
 
+  /** Cancel the pending request of an async_autocompleter_t, if any.
+      @return @c true if a request was pending. */
+  bool cancel_autocomplete() {
+    async_autocompleter_t *async_autocompleter =
+        dynamic_cast<async_autocompleter_t *>(autocompleter.get());
+    return async_autocompleter != nullptr && async_autocompleter->cancel_autocomplete();
+  }
+
   text_pos_t repaint_min = 0,                               /**< First line to repaint. */
       repaint_max = std::numeric_limits<text_pos_t>::max(); /**< Last line to repaint. */
+  /** Hash of what was last painted on each row of #edit_window, or 0 if unknown.
+      Rows in the repaint range of which the hash did not change are not repainted. */
+  std::vector<size_t> row_hashes;
 };
 
 struct edit_window_t::behavior_parameters_t::implementation_t {
@@ -174,6 +189,8 @@ void edit_window_t::init_instance() {
   /* Register the unbacked window for mouse events, such that we can get focus
      if the bottom line is clicked. */
   init_unbacked_window(11, 11, true);
+  // Only the rows that changed are repainted, which repaint_screen records.
+  set_records_redraws(true);
 
   impl->edit_window.alloc(&window, 10, 10, 0, 0, 0);
   impl->edit_window.show();
@@ -234,6 +251,7 @@ void edit_window_t::set_text(text_buffer_t *_text, const behavior_parameters_t *
     return;
   }
 
+  impl->cancel_autocomplete();
   text = _text;
   if (params != nullptr) {
     params->apply_parameters(this);
@@ -250,6 +268,36 @@ void edit_window_t::set_text(text_buffer_t *_text, const behavior_parameters_t *
   ensure_cursor_on_screen();
   draw_info_window();
   update_repaint_lines(0, std::numeric_limits<text_pos_t>::max());
+  impl->row_hashes.clear();
+}
+
+/** Lines longer than this are always repainted, to avoid hashing very long lines for every row. */
+static const size_t max_hashed_line_size = 4096;
+
+/** Calculate the hash of the row painted for @p line with @p info.
+    Returns 0 if the result of painting can not be predicted from the text of the line and the paint
+    parameters. This is the case for subclasses of text_line_t, which may for example implement
+    highlighting that depends on other lines. */
+static size_t calculate_row_hash(const text_line_t &line, const text_line_t::paint_info_t &info,
+                                 text_pos_t sub_line, t3_attr_t default_attrs) {
+  const std::string &data = line.get_data();
+  if (typeid(line) != typeid(text_line_t) || data.size() > max_hashed_line_size) {
+    return 0;
+  }
+  const text_pos_t parameters[] = {sub_line,
+                                   info.leftcol,
+                                   info.size,
+                                   info.tabsize,
+                                   info.flags,
+                                   info.selection_start,
+                                   info.selection_end,
+                                   info.cursor,
+                                   static_cast<text_pos_t>(info.normal_attr),
+                                   static_cast<text_pos_t>(info.selected_attr),
+                                   static_cast<text_pos_t>(default_attrs)};
+  size_t hash = ModifiedXXHash(parameters, sizeof(parameters), 0);
+  hash = ModifiedXXHash(data.data(), data.size(), hash);
+  return hash == 0 ? 1 : hash;
 }
 
 bool edit_window_t::set_size(optint height, optint width) {
@@ -263,6 +311,7 @@ bool edit_window_t::set_size(optint height, optint width) {
 
   if (width.value() != window.get_width() || height.value() > window.get_height()) {
     update_repaint_lines(0, std::numeric_limits<text_pos_t>::max());
+    impl->row_hashes.clear();
   }
 
   result &= window.resize(height.value(), width.value());
@@ -343,11 +392,14 @@ void edit_window_t::ensure_cursor_on_screen() {
 }
 
 void edit_window_t::repaint_screen() {
+  trace_scope_t trace("repaint_screen");
   text_coordinate_t current_start, current_end;
   text_line_t::paint_info_t info;
   int i;
+  int rows_painted = 0;
 
   impl->edit_window.set_default_attrs(attributes.text);
+  impl->row_hashes.resize(impl->edit_window.get_height(), 0);
 
   const text_coordinate_t cursor = text->get_cursor();
   update_repaint_lines(cursor.line);
@@ -392,6 +444,13 @@ void edit_window_t::repaint_screen() {
       }
 
       info.cursor = impl->top_left.line + i == cursor.line ? cursor.pos : -1;
+      size_t hash = calculate_row_hash(text->get_line_data(impl->top_left.line + i), info, 0,
+                                       attributes.text);
+      if (hash != 0 && impl->row_hashes[i] == hash) {
+        continue;
+      }
+      impl->row_hashes[i] = hash;
+      ++rows_painted;
       impl->edit_window.set_paint(i, 0);
       impl->edit_window.clrtoeol();
       text->paint_line(&impl->edit_window, impl->top_left.line + i, info);
@@ -419,9 +478,15 @@ void edit_window_t::repaint_screen() {
       }
 
       info.cursor = draw_line.line == cursor.line ? cursor.pos : -1;
-      impl->edit_window.set_paint(i, 0);
-      impl->edit_window.clrtoeol();
-      impl->wrap_info->paint_line(&impl->edit_window, draw_line, info);
+      size_t hash = calculate_row_hash(text->get_line_data(draw_line.line), info, draw_line.pos,
+                                       attributes.text);
+      if (hash == 0 || impl->row_hashes[i] != hash) {
+        impl->row_hashes[i] = hash;
+        ++rows_painted;
+        impl->edit_window.set_paint(i, 0);
+        impl->edit_window.clrtoeol();
+        impl->wrap_info->paint_line(&impl->edit_window, draw_line, info);
+      }
 
       if (draw_line.line == end_coord.line && draw_line.pos == end_coord.pos) {
         /* Increase i, to make sure this line is not erased. */
@@ -433,6 +498,9 @@ void edit_window_t::repaint_screen() {
   /* Clear the bottom part of the window (if applicable). */
   impl->edit_window.set_paint(i, 0);
   impl->edit_window.clrtobot();
+  std::fill(impl->row_hashes.begin() + std::min<size_t>(i, impl->row_hashes.size()),
+            impl->row_hashes.end(), 0);
+  record_redraw(static_cast<long>(rows_painted) * impl->edit_window.get_width());
 
   impl->repaint_min = cursor.line;
   impl->repaint_max = cursor.line;
@@ -829,19 +897,21 @@ void edit_window_t::find_activated(std::shared_ptr<finder_t> _finder, find_actio
 
       for (replacements = 0; text->find_limited(local_finder, start, eof, &result);
            replacements++) {
-        lprintf("Find result: %ld %ld\n", result.start.line, result.start.pos);
+        llog(LOG_DEBUG, FIND, "Find result: %ld %ld\n", result.start.line, result.start.pos);
         if (replacements == 0) {
           text->start_undo_block();
+          text->start_edit_transaction();
         }
         text->replace(*local_finder, result);
         start = text->get_cursor();
-        lprintf("New start: %ld %ld\n", start.line, start.pos);
+        llog(LOG_DEBUG, FIND, "New start: %ld %ld\n", start.line, start.pos);
       }
 
       if (replacements == 0) {
         goto not_found;
       }
 
+      text->end_edit_transaction();
       text->end_undo_block();
       reset_selection();
       ensure_cursor_on_screen();
@@ -858,6 +928,7 @@ void edit_window_t::find_activated(std::shared_ptr<finder_t> _finder, find_actio
       text_coordinate_t saved_start;
       int replacements;
       text_pos_t end_line_length;
+      text_pos_t text_size = text->size();
       bool reverse_selection = false;
 
       if (end < start) {
@@ -872,9 +943,13 @@ void edit_window_t::find_activated(std::shared_ptr<finder_t> _finder, find_actio
            replacements++) {
         if (replacements == 0) {
           text->start_undo_block();
+          text->start_edit_transaction();
         }
         text->replace(*local_finder, result);
         start = text->get_cursor();
+        // Multi-line matches and replacements change the number of lines before the end.
+        end.line += text->size() - text_size;
+        text_size = text->size();
         end.pos -= end_line_length - text->get_line_size(end.line);
         end_line_length = text->get_line_size(end.line);
       }
@@ -883,6 +958,7 @@ void edit_window_t::find_activated(std::shared_ptr<finder_t> _finder, find_actio
         goto not_found;
       }
 
+      text->end_edit_transaction();
       text->end_undo_block();
 
       text->set_selection_mode(selection_mode_t::NONE);
@@ -916,6 +992,10 @@ not_found:
 
 // FIXME: make every action into a separate function for readability
 bool edit_window_t::process_key(key_t key) {
+  /* Any key may change the text or move the cursor, which makes a pending autocompletion request
+     obsolete. If the text is changed by typing, the request is restarted below. */
+  bool autocomplete_pending = impl->cancel_autocomplete();
+
   if (set_selection_mode(key)) {
     return true;
   }
@@ -1071,7 +1151,7 @@ bool edit_window_t::process_key(key_t key) {
       } else {
         delete_selection();
       }
-      if (impl->autocomplete_panel->is_shown()) {
+      if (impl->autocomplete_panel->is_shown() || autocomplete_pending) {
         activate_autocomplete(false);
       }
       break;
@@ -1094,7 +1174,7 @@ bool edit_window_t::process_key(key_t key) {
       } else {
         delete_selection();
       }
-      if (impl->autocomplete_panel->is_shown()) {
+      if (impl->autocomplete_panel->is_shown() || autocomplete_pending) {
         activate_autocomplete(false);
       }
       break;
@@ -1206,7 +1286,7 @@ bool edit_window_t::process_key(key_t key) {
       ensure_cursor_on_screen();
       update_repaint_lines(text->get_cursor().line);
       impl->last_set_pos = impl->screen_pos;
-      if (impl->autocomplete_panel->is_shown()) {
+      if (impl->autocomplete_panel->is_shown() || autocomplete_pending) {
         activate_autocomplete(false);
       }
       break;
@@ -1263,7 +1343,7 @@ void edit_window_t::update_contents() {
         std::max(impl->wrap_info->wrapped_size(), count + impl->edit_window.get_height()), count,
         impl->edit_window.get_height());
   }
-  impl->scrollbar->update_contents();
+  impl->scrollbar->profiled_update_contents();
 
   logical_cursor_pos = text->get_cursor();
   logical_cursor_pos.pos = text->calculate_screen_pos(impl->tabsize);
@@ -1286,6 +1366,7 @@ void edit_window_t::update_contents() {
 void edit_window_t::set_focus(focus_t _focus) {
   if (_focus != impl->focus) {
     impl->focus = _focus;
+    impl->cancel_autocomplete();
     impl->autocomplete_panel->hide();
     update_repaint_lines(text->get_cursor().line);
   }
@@ -1373,7 +1454,7 @@ void edit_window_t::paste(bool clipboard) {
 }
 
 void edit_window_t::right_click_menu_activated(int action) {
-  lprintf("right click menu activated: %d\n", action);
+  llog(LOG_DEBUG, MOUSE, "right click menu activated: %d\n", action);
   switch (action) {
     case ACTION_CUT:
       cut_copy(true);
@@ -1529,6 +1610,8 @@ void edit_window_t::set_use_local_finder(bool _use_local_finder) {
 
 void edit_window_t::force_redraw() {
   update_repaint_lines(0, std::numeric_limits<text_pos_t>::max());
+  // Called when the terminal or the attributes changed, so the rows must be painted again.
+  impl->row_hashes.clear();
   draw_info_window();
   ensure_cursor_on_screen();
 }
@@ -1556,6 +1639,7 @@ bool edit_window_t::is_child(const window_component_t *widget) const {
 }
 
 bool edit_window_t::process_mouse_event(mouse_event_t event) {
+  impl->cancel_autocomplete();
   if (event.window == impl->edit_window) {
     if (event.button_state & EMOUSE_TRIPLE_CLICKED_LEFT) {
       text->set_cursor_pos(0);
@@ -1692,6 +1776,7 @@ void edit_window_t::save_behavior_parameters(behavior_parameters_t *params) {
 void edit_window_t::draw_info_window() {}
 
 void edit_window_t::set_autocompleter(autocompleter_t *_autocompleter) {
+  impl->cancel_autocomplete();
   impl->autocomplete_panel->hide();
   impl->autocompleter.reset(_autocompleter);
 }
@@ -1703,10 +1788,24 @@ void edit_window_t::activate_autocomplete(bool autocomplete_single) {
     return;
   }
 
-  text_coordinate_t anchor(text->get_cursor());
+  async_autocompleter_t *async_autocompleter =
+      dynamic_cast<async_autocompleter_t *>(impl->autocompleter.get());
+  if (async_autocompleter != nullptr) {
+    async_autocompleter->request_autocomplete(
+        text, [this, autocomplete_single](string_list_base_t *list, text_pos_t position) {
+          show_autocomplete_list(list, position, autocomplete_single);
+        });
+    return;
+  }
+
+  text_pos_t position = text->get_cursor().pos;
   string_list_base_t *autocomplete_list =
-      impl->autocompleter->build_autocomplete_list(text, &anchor.pos);
+      impl->autocompleter->build_autocomplete_list(text, &position);
+  show_autocomplete_list(autocomplete_list, position, autocomplete_single);
+}
 
+void edit_window_t::show_autocomplete_list(string_list_base_t *autocomplete_list,
+                                           text_pos_t anchor_pos, bool autocomplete_single) {
   if (autocomplete_list != nullptr) {
     if (autocomplete_single && autocomplete_list->size() == 1) {
       impl->autocompleter->autocomplete(text, 0);
@@ -1717,6 +1816,7 @@ void edit_window_t::activate_autocomplete(bool autocomplete_single) {
 
     impl->autocomplete_panel->set_completions(autocomplete_list);
     const text_coordinate_t cursor = text->get_cursor();
+    const text_coordinate_t anchor(cursor.line, anchor_pos);
     if (impl->wrap_type == wrap_type_t::NONE) {
       text_pos_t position = text->calculate_screen_pos(anchor, impl->tabsize);
       impl->autocomplete_panel->set_position((cursor.line - impl->top_left.line + 1),
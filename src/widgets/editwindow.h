@@ -109,6 +109,11 @@ class T3_WIDGET_API edit_window_t : public widget_t,
   void scrollbar_clicked(scrollbar_t::step_t step);
   void scrollbar_dragged(text_pos_t start);
   void autocomplete_activated();
+  /** Show the autocomplete panel with the options in @p autocomplete_list, positioned at
+      @p anchor_pos in the line of the cursor. The panel is hidden if @p autocomplete_list is
+      @c nullptr. */
+  void show_autocomplete_list(string_list_base_t *autocomplete_list, text_pos_t anchor_pos,
+                              bool autocomplete_single);
   void mark_selection();
   /** Pastes either the selection, or the clipboard. */
   void paste(bool clipboard);
@@ -136,7 +141,9 @@ class T3_WIDGET_API edit_window_t : public widget_t,
       @param autocomplete_single Should the autocomplete be automatic if
           there is only one option.
 
-      The autocomplete panel activate, only if there is a possible autocompletion. */
+      The autocomplete panel activate, only if there is a possible autocompletion. For an
+      async_autocompleter_t, the panel is shown once the completions have been computed in the
+      background. */
   void activate_autocomplete(bool autocomplete_single);
 
   /** Convert coordinates relative to the edit window to a text_coordinate_t. */
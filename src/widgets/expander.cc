@@ -159,7 +159,7 @@ void expander_t::set_expanded(bool expanded) {
 }
 
 bool expander_t::process_key(key_t key) {
-  lprintf("Handling key %08x impl->focus: %d\n", key, impl->focus);
+  llog(LOG_DEBUG, KEYS, "Handling key %08x impl->focus: %d\n", key, impl->focus);
   if (impl->focus == FOCUS_SELF) {
     if (impl->is_expanded && impl->child != nullptr && (key == '\t' || key == EKEY_DOWN)) {
       if (impl->child->accepts_focus()) {
@@ -224,7 +224,7 @@ bool expander_t::process_key(key_t key) {
 
 void expander_t::update_contents() {
   if (impl->is_expanded && impl->child != nullptr) {
-    impl->child->update_contents();
+    impl->child->profiled_update_contents();
   }
   if (!reset_redraw()) {
     return;
@@ -77,8 +77,6 @@ struct file_pane_t::implementation_t {
         scrollbar_range(1) {}
 };
 
-// FIXME: we could use some optimization for update_column_widths. Current use is simple but calls
-// to often.
 /* FIXME: we should not distribute left-over space among shown columns, but show partial column
    instead
         this is more intuitive for the user. */
@@ -276,7 +274,7 @@ void file_pane_t::update_contents() {
   size_t max_idx, i;
   int height;
 
-  impl->search_panel->update_contents();
+  impl->search_panel->profiled_update_contents();
 
   if (!reset_redraw()) {
     return;
@@ -300,7 +298,7 @@ void file_pane_t::update_contents() {
 
   impl->scrollbar.set_parameters(impl->scrollbar_range, impl->top_idx,
                                  impl->columns_visible * height);
-  impl->scrollbar.update_contents();
+  impl->scrollbar.profiled_update_contents();
 }
 
 void file_pane_t::set_focus(focus_t _focus) {
@@ -388,11 +386,22 @@ void file_pane_t::set_file(const std::string &name) {
 
 void file_pane_t::update_column_width(int column, int start) {
   int height = window.get_height() - 1;
+  int widths[64];
+  const size_t max_widths = sizeof(widths) / sizeof(widths[0]);
+  size_t end = std::min<size_t>(start + std::max(height, 0), impl->file_list->size());
+
+  /* The widths are cached by file_list_t, so this only depends on the number of visible items. */
   impl->column_widths[column] = 0;
-  for (int i = 0; i < height && start + i < static_cast<int>(impl->file_list->size()); i++) {
-    const std::string &item = (*impl->file_list)[i + start];
-    impl->column_widths[column] =
-        std::max<int>(impl->column_widths[column], t3_term_strncwidth(item.data(), item.size()));
+  for (size_t idx = start; idx < end;) {
+    size_t count =
+        impl->file_list->get_display_widths(idx, std::min(end - idx, max_widths), widths);
+    if (count == 0) {
+      break;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      impl->column_widths[column] = std::max(impl->column_widths[column], widths[i]);
+    }
+    idx += count;
   }
 }
 
@@ -441,9 +450,18 @@ void file_pane_t::update_column_widths() {
 
 void file_pane_t::content_changed() {
   int height = window.get_height() - 1;
+  size_t size = impl->file_list->size();
 
-  impl->top_idx = 0;
+  /* The list grows while a directory is loaded in the background, so don't move the view back to
+     the start, but only make sure the cursor stays within the list. */
+  if (impl->current >= size) {
+    impl->current = size == 0 ? 0 : size - 1;
+  }
+  if (impl->top_idx > impl->current) {
+    impl->top_idx = 0;
+  }
   update_column_widths();
+  ensure_cursor_on_screen();
   impl->scrollbar_range = ((impl->file_list->size() + height - 1) / height) * height;
   force_redraw();
 }
@@ -55,7 +55,7 @@ bool frame_t::process_key(key_t key) {
 }
 void frame_t::update_contents() {
   if (impl->child != nullptr) {
-    impl->child->update_contents();
+    impl->child->profiled_update_contents();
   }
   if (!reset_redraw()) {
     return;
@@ -214,15 +214,15 @@ bool list_pane_t::set_size(optint height, optint width) {
 
 void list_pane_t::update_contents() {
   if (impl->indicator) {
-    impl->indicator_widget->update_contents();
+    impl->indicator_widget->profiled_update_contents();
     impl->indicator_widget->set_position(impl->current - impl->top_idx, 0);
   }
 
   impl->widgets_window.move(-impl->top_idx, 0);
   impl->scrollbar.set_parameters(impl->widgets.size(), impl->top_idx, window.get_height());
-  impl->scrollbar.update_contents();
+  impl->scrollbar.profiled_update_contents();
   for (const std::unique_ptr<widget_t> &widget : impl->widgets) {
-    widget->update_contents();
+    widget->profiled_update_contents();
   }
 }
 
@@ -206,7 +206,7 @@ void menu_bar_t::update_contents() {
   }
 
   if (impl->old_menu == impl->current_menu) {
-    impl->menus[impl->current_menu]->update_contents();
+    impl->menus[impl->current_menu]->profiled_update_contents();
     return;
   }
   impl->menus[impl->old_menu]->hide();
@@ -214,7 +214,7 @@ void menu_bar_t::update_contents() {
   draw_menu_name(*impl->menus[impl->old_menu], false);
   draw_menu_name(*impl->menus[impl->current_menu], true);
   impl->old_menu = impl->current_menu;
-  impl->menus[impl->current_menu]->update_contents();
+  impl->menus[impl->current_menu]->profiled_update_contents();
 }
 
 void menu_bar_t::set_focus(focus_t focus) { (void)focus; }
@@ -62,7 +62,7 @@ bool multi_widget_t::set_size(optint height, optint width) {
 
 void multi_widget_t::update_contents() {
   for (const item_t &widget : impl->widgets) {
-    widget.widget->update_contents();
+    widget.widget->profiled_update_contents();
   }
 }
 
@@ -114,7 +114,7 @@ bool split_t::set_size(optint height, optint width) {
 
 void split_t::update_contents() {
   for (const std::unique_ptr<widget_t> &widget : impl->widgets) {
-    widget->update_contents();
+    widget->profiled_update_contents();
   }
 }
 
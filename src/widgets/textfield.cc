@@ -38,10 +38,9 @@
 #include "t3widget/textline.h"
 #include "t3widget/util.h"
 #include "t3widget/widget_api.h"
-#include "t3widget/widgets/label.h"
-#include "t3widget/widgets/listpane.h"
 #include "t3widget/widgets/smartlabel.h"
 #include "t3widget/widgets/textfield.h"
+#include "t3widget/widgets/virtuallist.h"
 #include "t3widget/widgets/widget.h"
 #include "t3window/terminal.h"
 #include "t3window/window.h"
@@ -62,14 +61,29 @@ namespace t3widget {
 #include "t3widget/key_binding_def.h"
 
 /** Drop-down list implementation for text_field_t. */
-class T3_WIDGET_LOCAL text_field_t::drop_down_list_t : public popup_t {
+class T3_WIDGET_LOCAL text_field_t::drop_down_list_t : public popup_t, public list_model_t {
  private:
   text_field_t *field; /**< text_field_t this drop-down list is created for. */
 
   std::unique_ptr<filtered_string_list_base_t> completions; /**< List of possible selections. */
-  list_pane_t *list_pane;
-
-  void update_list_pane();
+  /** Text the completions are filtered on, or empty if the completions are not filtered. */
+  std::string filter_text;
+  /** Boolean indicating whether the completions are filtered using fuzzy matching. */
+  bool filter_fuzzy;
+  /** Pattern used for fuzzy matching. */
+  fuzzy_pattern_t fuzzy_pattern;
+  /** The list of autocompletion options if it is a file_index_t, or @c nullptr otherwise. */
+  file_index_t *index;
+  /** List showing the completions. Its rows are drawn on demand, such that changes of
+      #completions are cheap even if it holds many items. */
+  virtual_list_t *list;
+  /** Connection to the content_changed signal of #completions. */
+  connection_t completions_changed_connection;
+
+  /** Handle a change of #completions. */
+  void completions_changed();
+  /** Set the text of the field to the current item of the list, if it has one. */
+  void copy_current_item();
   void item_activated();
   void selection_changed();
 
@@ -91,6 +105,9 @@ class T3_WIDGET_LOCAL text_field_t::drop_down_list_t : public popup_t {
   void set_autocomplete(string_list_base_t *completions);
   /** Return whether the autocompletion list is empty. */
   bool empty();
+
+  size_t row_count() const override;
+  void paint_row(size_t idx, t3window::window_t *row_window, bool selected) override;
 };
 
 struct text_field_t::implementation_t {
@@ -119,6 +136,7 @@ struct text_field_t::implementation_t {
   size_t filter_keys_size;           /**< Size of #filter_keys. */
   bool filter_keys_accept; /**< Boolean indicating whether the keys in #filter_keys should be
                               accepted or rejected. */
+  bool fuzzy_autocomplete; /**< Boolean indicating whether to use fuzzy matching for completion. */
 
   smart_label_t *label; /**< Label associated with this text_field_t. */
 
@@ -139,6 +157,7 @@ struct text_field_t::implementation_t {
         filter_keys(nullptr),
         filter_keys_size(0),
         filter_keys_accept(true),
+        fuzzy_autocomplete(false),
         label(nullptr) {}
 };
 
@@ -486,7 +505,7 @@ void text_field_t::update_contents() {
   }
 
   if (impl->drop_down_list != nullptr && !impl->drop_down_list->empty()) {
-    impl->drop_down_list->update_contents();
+    impl->drop_down_list->profiled_update_contents();
   }
 
   if (!reset_redraw()) {
@@ -539,7 +558,7 @@ void text_field_t::update_contents() {
 }
 
 void text_field_t::set_focus(focus_t _focus) {
-  lprintf("set focus %d\n", _focus);
+  llog(LOG_DEBUG, GENERAL, "set focus %d\n", _focus);
   impl->focus = _focus;
   force_redraw();
   if (impl->focus) {
@@ -620,6 +639,13 @@ void text_field_t::set_autocomplete(string_list_base_t *completions) {
   impl->drop_down_list->set_autocomplete(completions);
 }
 
+void text_field_t::set_fuzzy_autocomplete(bool fuzzy) {
+  impl->fuzzy_autocomplete = fuzzy;
+  if (impl->drop_down_list != nullptr && impl->drop_down_list->is_shown()) {
+    impl->drop_down_list->update_view();
+  }
+}
+
 void text_field_t::set_label(smart_label_t *_label) { impl->label = _label; }
 
 bool text_field_t::is_hotkey(key_t key) const {
@@ -727,21 +753,26 @@ _T3_WIDGET_IMPL_SIGNAL(text_field_t, activate)
   == drop_down_list_t ==
   ======================*/
 #define DDL_HEIGHT 6
+/** Maximum number of completions shown when using fuzzy matching. Only the best matches are
+    useful, and limiting their number avoids sorting all matches of very large lists. */
+static const size_t max_fuzzy_completions = 1000;
 
 text_field_t::drop_down_list_t::drop_down_list_t(text_field_t *_field)
     : popup_t(DDL_HEIGHT, _field->get_base_window()->get_width(), false, false),
       field(_field),
-      list_pane(nullptr) {
+      filter_fuzzy(false),
+      index(nullptr),
+      list(nullptr) {
   window.set_anchor(field->get_base_window(),
                     T3_PARENT(T3_ANCHOR_TOPLEFT) | T3_CHILD(T3_ANCHOR_TOPLEFT));
   window.move(1, 0);
 
-  list_pane = emplace_back<list_pane_t>(false);
-  list_pane->set_size(DDL_HEIGHT - 1, window.get_width() - 1);
-  list_pane->set_position(0, 1);
-  list_pane->connect_activate([this] { item_activated(); });
-  list_pane->connect_selection_changed([this] { selection_changed(); });
-  list_pane->set_single_click_activate(true);
+  list = emplace_back<virtual_list_t>(this);
+  list->set_size(DDL_HEIGHT - 1, window.get_width() - 1);
+  list->set_position(0, 1);
+  list->connect_activate([this] { item_activated(); });
+  list->connect_selection_changed([this] { selection_changed(); });
+  list->set_single_click_activate(true);
 }
 
 bool text_field_t::drop_down_list_t::process_key(key_t key) {
@@ -755,8 +786,8 @@ bool text_field_t::drop_down_list_t::process_key(key_t key) {
 
   switch (key) {
     case EKEY_UP:
-      if (list_pane->get_current() == 0) {
-        list_pane->set_focus(FOCUS_OUT);
+      if (list->get_current() == 0) {
+        list->set_focus(FOCUS_OUT);
         field->impl->in_drop_down_list = false;
         field->force_redraw();
       }
@@ -773,7 +804,7 @@ bool text_field_t::drop_down_list_t::process_key(key_t key) {
       return false;
     default:
       if (key >= 32 && key < EKEY_FIRST_SPECIAL) {
-        list_pane->set_focus(FOCUS_OUT);
+        list->set_focus(FOCUS_OUT);
         // Make sure that the cursor will be visible, by forcing a redraw of the field
         field->force_redraw();
         field->impl->in_drop_down_list = false;
@@ -792,7 +823,7 @@ bool text_field_t::drop_down_list_t::set_size(optint height, optint width) {
   bool result;
   (void)height;
   result = popup_t::set_size(DDL_HEIGHT, width);
-  result &= list_pane->set_size(DDL_HEIGHT - 1, width.value() - 1);
+  result &= list->set_size(DDL_HEIGHT - 1, width.value() - 1);
   return result;
 }
 
@@ -821,7 +852,7 @@ void text_field_t::drop_down_list_t::update_contents() {
 
 void text_field_t::drop_down_list_t::set_focus(focus_t focus) {
   if (focus && field->impl->in_drop_down_list) {
-    field->set_text((*completions)[list_pane->get_current()]);
+    copy_current_item();
   }
   popup_t::set_focus(focus);
 }
@@ -835,30 +866,69 @@ void text_field_t::drop_down_list_t::hide() {
 void text_field_t::drop_down_list_t::show() {
   if (!is_shown()) {
     popup_t::show();
-    list_pane->set_focus(FOCUS_OUT);
+    list->set_focus(FOCUS_OUT);
   }
 }
 
 void text_field_t::drop_down_list_t::update_view() {
   if (completions != nullptr) {
-    if (field->impl->line->size() == 0) {
+    const std::string &text = field->impl->line->get_data();
+    bool fuzzy = field->impl->fuzzy_autocomplete;
+    /* Extending the text can only remove items, so only the current items need testing. */
+    bool narrow = !filter_text.empty() && fuzzy == filter_fuzzy &&
+                  text.size() > filter_text.size() &&
+                  text.compare(0, filter_text.size(), filter_text) == 0;
+    if (index != nullptr) {
+      // The index looks up the matching paths itself, which is much faster than filtering.
+      index->set_query(text);
+    } else if (text.empty()) {
       completions->reset_filter();
+    } else if (fuzzy) {
+      fuzzy_pattern.set_pattern(text);
+      if (narrow) {
+        completions->narrow_scored_filter(bind_front(fuzzy_filter, &fuzzy_pattern),
+                                          max_fuzzy_completions);
+      } else {
+        completions->set_scored_filter(bind_front(fuzzy_filter, &fuzzy_pattern),
+                                       max_fuzzy_completions);
+      }
+    } else if (narrow) {
+      completions->narrow_filter(bind_front(string_compare_filter, &text));
     } else {
-      completions->set_filter(bind_front(string_compare_filter, &field->impl->line->get_data()));
+      completions->set_filter(bind_front(string_compare_filter, &text));
     }
-    update_list_pane();
+    filter_text = text;
+    filter_fuzzy = fuzzy;
+    list->reset();
   }
 }
 
 void text_field_t::drop_down_list_t::set_autocomplete(string_list_base_t *_completions) {
   /* completions is a unique_ptr, thus it will be deleted if it is not nullptr. */
+  completions_changed_connection.disconnect();
+  index = dynamic_cast<file_index_t *>(_completions);
   file_list_base_t *file_list = dynamic_cast<file_list_base_t *>(_completions);
   if (file_list != nullptr) {
     completions = new_filtered_file_list(file_list);
   } else {
     completions = new_filtered_string_list(_completions);
   }
-  update_list_pane();
+  /* The filter functions used and the lookup in the lists provided by the library can be used
+     from multiple threads. */
+  if (dynamic_cast<file_list_t *>(_completions) != nullptr ||
+      dynamic_cast<string_list_t *>(_completions) != nullptr) {
+    completions->set_parallel_filter(true);
+  }
+  if (index != nullptr) {
+    // The results of the index are shown as they are, see update_view.
+    completions->reset_filter();
+  }
+  /* The list changes when the filter is updated, but also when the underlying list changes, for
+     example while it is loaded in the background. */
+  completions_changed_connection =
+      completions->connect_content_changed([this] { completions_changed(); });
+  filter_text.clear();
+  list->reset();
 }
 
 bool text_field_t::drop_down_list_t::empty() { return completions->size() == 0; }
@@ -872,23 +942,56 @@ bool text_field_t::drop_down_list_t::process_mouse_event(mouse_event_t event) {
   return true;
 }
 
-void text_field_t::drop_down_list_t::update_list_pane() {
-  while (!list_pane->empty()) {
-    list_pane->pop_back();
+size_t text_field_t::drop_down_list_t::row_count() const {
+  return completions == nullptr ? 0 : completions->size();
+}
+
+void text_field_t::drop_down_list_t::paint_row(size_t idx, t3window::window_t *row_window,
+                                               bool selected) {
+  (void)selected;
+  text_line_t line((*completions)[idx]);
+  text_line_t::paint_info_t paint_info;
+
+  paint_info.start = 0;
+  paint_info.leftcol = 0;
+  paint_info.size = row_window->get_width();
+  paint_info.max = std::numeric_limits<text_pos_t>::max();
+  paint_info.tabsize = 0;
+  paint_info.flags = text_line_t::TAB_AS_CONTROL;
+  paint_info.selection_start = -1;
+  paint_info.selection_end = -1;
+  paint_info.cursor = -1;
+  paint_info.normal_attr = 0;
+  paint_info.selected_attr = 0;
+  line.paint_line(row_window, paint_info);
+}
+
+void text_field_t::drop_down_list_t::completions_changed() {
+  list->model_changed();
+  /* Completions found in the background may arrive after the last edit of the text, in which
+     case the text field does not show or hide the drop-down list itself. */
+  if (!field->impl->focus) {
+    return;
   }
+  if (!empty() && field->impl->line->size() > 0) {
+    show();
+  } else if (is_shown()) {
+    hide();
+  }
+}
 
-  for (const std::string &str : *completions) {
-    list_pane->push_back(t3widget::make_unique<label_t>(str));
+void text_field_t::drop_down_list_t::copy_current_item() {
+  size_t current = list->get_current();
+  if (current < completions->size()) {
+    field->set_text((*completions)[current]);
   }
 }
 
 void text_field_t::drop_down_list_t::item_activated() {
-  field->set_text((*completions)[list_pane->get_current()]);
+  copy_current_item();
   hide();
 }
 
-void text_field_t::drop_down_list_t::selection_changed() {
-  field->set_text((*completions)[list_pane->get_current()]);
-}
+void text_field_t::drop_down_list_t::selection_changed() { copy_current_item(); }
 
 }  // namespace t3widget
@@ -70,8 +70,14 @@ class T3_WIDGET_API text_field_t : public widget_t,
   void hide() override;
   /** Set the text of the text_field_t. */
   void set_text(string_view text);
-  /** Set the autocompletion list. */
+  /** Set the autocompletion list.
+      If the list is a file_index_t, the prefix of the index is set to the text, and the resulting
+      list is shown unfiltered. */
   void set_autocomplete(string_list_base_t *_completions);
+  /** Set whether to use fuzzy matching for the autocompletion list.
+      By default, only the items starting with the text are shown. With fuzzy matching, items
+      containing the characters of the text in order are shown, best matching items first. */
+  void set_fuzzy_autocomplete(bool fuzzy);
   /** Set the list of keys to accept or reject.
       @param keys The list of keys to accept or reject.
       @param nr_of_keys The size of @p keys.
@@ -243,7 +243,7 @@ void text_window_t::update_contents() {
     impl->scrollbar->set_parameters(
         std::max(impl->wrap_info->wrapped_size(), count + window.get_height()), count,
         window.get_height());
-    impl->scrollbar->update_contents();
+    impl->scrollbar->profiled_update_contents();
   }
 }
 
@@ -0,0 +1,388 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "t3widget/widgets/virtuallist.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "t3widget/colorscheme.h"
+#include "t3widget/internal.h"
+#include "t3widget/util.h"
+#include "t3widget/widgets/scrollbar.h"
+#include "t3window/window.h"
+
+namespace t3widget {
+
+list_model_t::~list_model_t() {}
+
+int list_model_t::row_height(size_t idx) const {
+  (void)idx;
+  return 1;
+}
+
+struct virtual_list_t::implementation_t {
+  list_model_t *model;
+  size_t top_idx, /**< Index of the first row displayed. */
+      current;    /**< Index of the current row. */
+  bool has_focus;
+  bool single_click_activate;
+  scrollbar_t scrollbar;
+  /** Windows used to draw the visible rows. There are never more windows than lines in the list,
+      and they are reused for different rows on each redraw. */
+  std::vector<t3window::window_t> row_windows;
+  signal_t<> activate;
+  signal_t<> selection_changed;
+
+  implementation_t(list_model_t *_model)
+      : model(_model),
+        top_idx(0),
+        current(0),
+        has_focus(false),
+        single_click_activate(false),
+        scrollbar(true) {}
+
+  size_t row_count() const { return model == nullptr ? 0 : model->row_count(); }
+};
+
+virtual_list_t::virtual_list_t(list_model_t *model)
+    : widget_t(1, 4, true, impl_alloc<implementation_t>(0)),
+      impl(new_impl<implementation_t>(model)) {
+  container_t::set_widget_parent(&impl->scrollbar);
+  impl->scrollbar.set_anchor(this, T3_PARENT(T3_ANCHOR_TOPRIGHT) | T3_CHILD(T3_ANCHOR_TOPRIGHT));
+  impl->scrollbar.set_size(1, None);
+  impl->scrollbar.connect_clicked(bind_front(&virtual_list_t::scrollbar_clicked, this));
+  impl->scrollbar.connect_dragged(bind_front(&virtual_list_t::scrollbar_dragged, this));
+}
+
+virtual_list_t::~virtual_list_t() {}
+
+int virtual_list_t::get_row_height(size_t idx) const {
+  return std::max(1, std::min(impl->model->row_height(idx), window.get_height()));
+}
+
+size_t virtual_list_t::get_max_top_idx() const {
+  size_t count = impl->row_count();
+  if (count == 0) {
+    return 0;
+  }
+
+  int height = window.get_height();
+  size_t idx = count - 1;
+  int lines = get_row_height(idx);
+  while (idx > 0) {
+    int row_height = get_row_height(idx - 1);
+    if (lines + row_height > height) {
+      break;
+    }
+    lines += row_height;
+    --idx;
+  }
+  return idx;
+}
+
+size_t virtual_list_t::get_rows_visible() const {
+  size_t count = impl->row_count();
+  int height = window.get_height();
+  size_t idx;
+  int lines = 0;
+
+  for (idx = impl->top_idx; idx < count && lines < height; ++idx) {
+    lines += get_row_height(idx);
+  }
+  return idx - impl->top_idx;
+}
+
+void virtual_list_t::ensure_cursor_on_screen() {
+  size_t count = impl->row_count();
+  if (count == 0) {
+    impl->top_idx = 0;
+    impl->current = 0;
+    return;
+  }
+
+  if (impl->current < impl->top_idx) {
+    impl->top_idx = impl->current;
+    return;
+  }
+
+  /* Only the rows that fit on the screen need to be checked to determine whether the current row
+     is fully visible. */
+  int height = window.get_height();
+  int lines = 0;
+  for (size_t idx = impl->top_idx; idx <= impl->current; ++idx) {
+    lines += get_row_height(idx);
+    if (lines > height) {
+      break;
+    }
+  }
+  if (lines <= height) {
+    return;
+  }
+
+  // Make the current row the last fully visible row.
+  impl->top_idx = impl->current;
+  lines = get_row_height(impl->current);
+  while (impl->top_idx > 0) {
+    int row_height = get_row_height(impl->top_idx - 1);
+    if (lines + row_height > height) {
+      break;
+    }
+    lines += row_height;
+    --impl->top_idx;
+  }
+}
+
+void virtual_list_t::scroll(int change) {
+  size_t max_top_idx = get_max_top_idx();
+  if (change < 0) {
+    size_t back = static_cast<size_t>(-change);
+    impl->top_idx = impl->top_idx < back ? 0 : impl->top_idx - back;
+  } else {
+    impl->top_idx = std::min(impl->top_idx + change, max_top_idx);
+  }
+  force_redraw();
+}
+
+void virtual_list_t::move_cursor(size_t idx) {
+  if (idx == impl->current) {
+    return;
+  }
+  impl->current = idx;
+  ensure_cursor_on_screen();
+  force_redraw();
+  impl->selection_changed();
+}
+
+bool virtual_list_t::process_key(key_t key) {
+  size_t count = impl->row_count();
+  size_t page;
+
+  if (count == 0) {
+    return key == EKEY_DOWN || key == EKEY_UP || key == EKEY_END || key == EKEY_HOME ||
+           key == EKEY_PGDN || key == EKEY_PGUP;
+  }
+
+  switch (key) {
+    case EKEY_DOWN:
+      if (impl->current + 1 < count) {
+        move_cursor(impl->current + 1);
+      }
+      return true;
+    case EKEY_UP:
+      if (impl->current > 0) {
+        move_cursor(impl->current - 1);
+      }
+      return true;
+    case EKEY_END:
+      move_cursor(count - 1);
+      return true;
+    case EKEY_HOME:
+      move_cursor(0);
+      return true;
+    case EKEY_PGDN:
+      page = std::max<size_t>(get_rows_visible(), 2) - 1;
+      impl->top_idx = std::min(impl->top_idx + page, get_max_top_idx());
+      move_cursor(std::min(impl->current + page, count - 1));
+      force_redraw();
+      return true;
+    case EKEY_PGUP:
+      page = std::max<size_t>(get_rows_visible(), 2) - 1;
+      impl->top_idx = impl->top_idx < page ? 0 : impl->top_idx - page;
+      move_cursor(impl->current < page ? 0 : impl->current - page);
+      force_redraw();
+      return true;
+    case EKEY_NL:
+      impl->activate();
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool virtual_list_t::set_size(optint height, optint width) {
+  bool result;
+
+  if (!height.is_valid()) {
+    height = window.get_height();
+  }
+  if (!width.is_valid()) {
+    width = window.get_width();
+  }
+
+  result = window.resize(height.value(), width.value());
+  result &= impl->scrollbar.set_size(height, None);
+
+  if (impl->row_windows.size() > static_cast<size_t>(height.value())) {
+    impl->row_windows.resize(height.value());
+  }
+
+  ensure_cursor_on_screen();
+  force_redraw();
+  return result;
+}
+
+void virtual_list_t::update_contents() {
+  size_t count = impl->row_count();
+
+  impl->scrollbar.set_parameters(count, impl->top_idx, get_rows_visible());
+  impl->scrollbar.profiled_update_contents();
+
+  if (!reset_redraw()) {
+    return;
+  }
+
+  window.set_default_attrs(attributes.dialog);
+  window.set_paint(0, 0);
+  window.clrtobot();
+
+  int height = window.get_height();
+  int width = window.get_width() - 1;
+  int line = 0;
+  size_t used = 0;
+  for (size_t idx = impl->top_idx; idx < count && line < height; ++idx, ++used) {
+    int row_height = get_row_height(idx);
+    bool selected = impl->has_focus && idx == impl->current;
+
+    if (used == impl->row_windows.size()) {
+      impl->row_windows.emplace_back();
+      impl->row_windows.back().alloc(&window, row_height, width, line, 0, 0);
+    }
+    t3window::window_t &row_window = impl->row_windows[used];
+    row_window.resize(row_height, width);
+    row_window.move(line, 0);
+    row_window.set_default_attrs(selected ? attributes.dialog_selected : attributes.dialog);
+    row_window.set_paint(0, 0);
+    row_window.clrtobot();
+    impl->model->paint_row(idx, &row_window, selected);
+    row_window.show();
+    line += row_height;
+  }
+  for (; used < impl->row_windows.size(); ++used) {
+    impl->row_windows[used].hide();
+  }
+}
+
+void virtual_list_t::set_focus(focus_t focus) {
+  impl->has_focus = focus;
+  force_redraw();
+}
+
+void virtual_list_t::set_child_focus(window_component_t *target) {
+  (void)target;
+  set_focus(window_component_t::FOCUS_SET);
+}
+
+bool virtual_list_t::is_child(const window_component_t *widget) const {
+  return widget == &impl->scrollbar;
+}
+
+bool virtual_list_t::process_mouse_event(mouse_event_t event) {
+  if (event.type == EMOUSE_BUTTON_PRESS &&
+      (event.button_state & (EMOUSE_SCROLL_UP | EMOUSE_SCROLL_DOWN))) {
+    scroll((event.button_state & EMOUSE_SCROLL_UP) ? -3 : 3);
+    return true;
+  }
+  if (event.type != EMOUSE_BUTTON_RELEASE ||
+      (event.button_state & (EMOUSE_CLICKED_LEFT | EMOUSE_DOUBLE_CLICKED_LEFT)) == 0) {
+    return true;
+  }
+
+  // Find the row at the position of the click, by walking the visible rows only.
+  size_t count = impl->row_count();
+  size_t idx = impl->top_idx;
+  int line = 0;
+  while (idx < count && line < window.get_height()) {
+    line += get_row_height(idx);
+    if (event.y < line) {
+      break;
+    }
+    ++idx;
+  }
+  if (event.y < 0 || idx >= count || line <= event.y) {
+    return true;
+  }
+
+  if (event.button_state & EMOUSE_DOUBLE_CLICKED_LEFT) {
+    if (!impl->single_click_activate && idx == impl->current) {
+      impl->activate();
+    }
+  } else {
+    move_cursor(idx);
+    if (impl->single_click_activate) {
+      impl->activate();
+    }
+  }
+  return true;
+}
+
+void virtual_list_t::set_model(list_model_t *model) {
+  impl->model = model;
+  reset();
+}
+
+void virtual_list_t::model_changed() {
+  size_t count = impl->row_count();
+  if (impl->current >= count) {
+    impl->current = count == 0 ? 0 : count - 1;
+  }
+  impl->top_idx = std::min(impl->top_idx, get_max_top_idx());
+  ensure_cursor_on_screen();
+  force_redraw();
+}
+
+void virtual_list_t::reset() {
+  impl->top_idx = 0;
+  impl->current = 0;
+  force_redraw();
+}
+
+size_t virtual_list_t::get_current() const { return impl->current; }
+
+void virtual_list_t::set_current(size_t idx) {
+  if (idx >= impl->row_count()) {
+    return;
+  }
+  impl->current = idx;
+  ensure_cursor_on_screen();
+  force_redraw();
+}
+
+void virtual_list_t::set_single_click_activate(bool sca) { impl->single_click_activate = sca; }
+
+void virtual_list_t::scrollbar_clicked(scrollbar_t::step_t step) {
+  int height = window.get_height();
+  scroll(step == scrollbar_t::BACK_SMALL
+             ? -3
+             : step == scrollbar_t::BACK_MEDIUM
+                   ? -height / 2
+                   : step == scrollbar_t::BACK_PAGE
+                         ? -height
+                         : step == scrollbar_t::FWD_SMALL
+                               ? 3
+                               : step == scrollbar_t::FWD_MEDIUM
+                                     ? height / 2
+                                     : step == scrollbar_t::FWD_PAGE ? height : 0);
+}
+
+void virtual_list_t::scrollbar_dragged(text_pos_t start) {
+  if (start >= 0) {
+    impl->top_idx = std::min(static_cast<size_t>(start), get_max_top_idx());
+    force_redraw();
+  }
+}
+
+_T3_WIDGET_IMPL_SIGNAL(virtual_list_t, activate)
+_T3_WIDGET_IMPL_SIGNAL(virtual_list_t, selection_changed)
+
+}  // namespace t3widget
@@ -0,0 +1,114 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef T3_WIDGET_VIRTUALLIST_H
+#define T3_WIDGET_VIRTUALLIST_H
+
+#include <cstddef>
+#include <functional>
+#include <t3widget/interfaces.h>
+#include <t3widget/key.h>
+#include <t3widget/mouse.h>
+#include <t3widget/signals.h>
+#include <t3widget/util.h>
+#include <t3widget/widget_api.h>
+#include <t3widget/widgets/scrollbar.h>
+#include <t3widget/widgets/widget.h>
+#include <t3window/window.h>
+
+namespace t3widget {
+
+/** Interface through which a virtual_list_t retrieves and draws its rows. */
+class T3_WIDGET_API list_model_t {
+ public:
+  virtual ~list_model_t();
+  /** Retrieve the number of rows. */
+  virtual size_t row_count() const = 0;
+  /** Retrieve the height in lines of row @p idx.
+      The height is limited to the height of the list. The default implementation returns @c 1. */
+  virtual int row_height(size_t idx) const;
+  /** Draw row @p idx into @p window.
+      The window has the height of the row and the width available for rows. It has been cleared,
+      with its default attributes set to the selected attributes if @p selected is @c true, such
+      that plain text is highlighted automatically.
+      @param idx The index of the row to draw.
+      @param window The window to draw the row in.
+      @param selected Whether the row is the current row of a list which has the input focus.
+  */
+  virtual void paint_row(size_t idx, t3window::window_t *window, bool selected) = 0;
+};
+
+/** A list widget which displays the rows of a list_model_t.
+
+    Unlike list_pane_t, which requires a widget per item, the rows are drawn on demand by the
+    model. Only enough windows to fill the visible area are kept, and these are reused for
+    different rows when scrolling. The cost of scrolling, keyboard navigation and mouse handling
+    only depends on the number of visible rows, not on the total number of rows.
+*/
+class T3_WIDGET_API virtual_list_t : public widget_t, public container_t {
+ private:
+  struct T3_WIDGET_LOCAL implementation_t;
+
+  single_alloc_pimpl_t<implementation_t> impl;
+
+  /** Retrieve the height of row @p idx, limited to the range [1, height of the list]. */
+  int get_row_height(size_t idx) const;
+  /** Retrieve the smallest index that can be used as top row while still filling the list. */
+  size_t get_max_top_idx() const;
+  /** Retrieve the number of rows shown, starting at the top row. */
+  size_t get_rows_visible() const;
+  void ensure_cursor_on_screen();
+  void scroll(int change);
+  /** Change the current row to @p idx, and emit the @c selection_changed signal if it changed. */
+  void move_cursor(size_t idx);
+  void scrollbar_clicked(scrollbar_t::step_t step);
+  void scrollbar_dragged(text_pos_t start);
+
+ public:
+  /** Create a new virtual_list_t.
+      @param model The model providing the rows. The model is not owned by the virtual_list_t, and
+          may be @c nullptr, in which case the list is empty.
+  */
+  virtual_list_t(list_model_t *model = nullptr);
+  ~virtual_list_t() override;
+  bool process_key(key_t key) override;
+  bool set_size(optint height, optint width) override;
+  void update_contents() override;
+  void set_focus(focus_t focus) override;
+  void set_child_focus(window_component_t *target) override;
+  bool is_child(const window_component_t *widget) const override;
+  bool process_mouse_event(mouse_event_t event) override;
+
+  /** Set the model providing the rows. The model is not owned by the virtual_list_t. */
+  void set_model(list_model_t *model);
+  /** Notify the list that the rows of the model have changed.
+      This must be called whenever the number of rows, or the contents or height of a visible row
+      change. */
+  void model_changed();
+  /** Set the list to its initial position, i.e. the selected row is the first row. */
+  void reset();
+  /** Retrieve the index of the current row. */
+  size_t get_current() const;
+  /** Set the current row, scrolling it into view if necessary. */
+  void set_current(size_t idx);
+  /** Set whether a single click activates a row, rather than a double click. */
+  void set_single_click_activate(bool sca);
+
+  /** Connect a callback to be called when the current row is activated. */
+  T3_WIDGET_DECLARE_SIGNAL(activate);
+  /** Connect a callback to be called when the current row changes. */
+  T3_WIDGET_DECLARE_SIGNAL(selection_changed);
+};
+
+}  // namespace t3widget
+#endif
@@ -24,9 +24,10 @@
 namespace t3widget {
 
 struct widget_t::implementation_t {
-  bool redraw = true, /**< Widget requires redrawing on next #update_contents call. */
-      enabled = true, /**< Widget is enabled. */
-      shown = true;   /**< Widget is shown. */
+  bool redraw = true,          /**< Widget requires redrawing on next #update_contents call. */
+      enabled = true,          /**< Widget is enabled. */
+      shown = true,            /**< Widget is shown. */
+      records_redraws = false; /**< Widget calls #record_redraw itself. */
 };
 
 /* The default_parent must exist before any widgets are created. Thus using the #on_init method
@@ -36,9 +37,16 @@ t3window::window_t widget_t::default_parent(nullptr, 1, 1, 0, 0, 0, false);
 bool widget_t::reset_redraw() {
   bool result = impl->redraw;
   impl->redraw = false;
+  if (result && !impl->records_redraws) {
+    record_redraw(static_cast<long>(window.get_height()) * window.get_width());
+  }
   return result;
 }
 
+void widget_t::set_records_redraws(bool records_redraws) {
+  impl->records_redraws = records_redraws;
+}
+
 bool widget_t::is_hotkey(key_t key) const {
   (void)key;
   return false;
@@ -113,7 +121,8 @@ void widget_t::set_focus(focus_t focus) {
 }
 
 bool widget_t::process_mouse_event(mouse_event_t event) {
-  lprintf("Default mouse handling for %s (%d)\n", typeid(*this).name(), accepts_focus());
+  llog(LOG_DEBUG, MOUSE, "Default mouse handling for %s (%d)\n", typeid(*this).name(),
+       accepts_focus());
   return accepts_focus() && (event.button_state & EMOUSE_CLICK_BUTTONS);
 }
 
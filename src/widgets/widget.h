@@ -44,7 +44,13 @@ class T3_WIDGET_API widget_t : public virtual window_component_t,
   single_alloc_pimpl_t<implementation_t> impl;
 
  protected:
+  /** Clear the redraw flag, returning its previous value.
+      If profiling is enabled and the flag was set, this records a redraw of the whole window,
+      unless #set_records_redraws was called. */
   bool reset_redraw();
+  /** Indicate that this widget calls #record_redraw itself, because it only redraws part of its
+      window when the redraw flag is set. */
+  void set_records_redraws(bool records_redraws);
 
   /** Constructor which creates a default @c t3_window_t with @p height and @p width. */
   widget_t(int height, int width, bool register_as_mouse_target = true, size_t impl_size = 0);
@@ -116,7 +116,7 @@ bool widget_group_t::process_key(key_t key) {
 
 void widget_group_t::update_contents() {
   for (const std::unique_ptr<widget_t> &widget : impl->children) {
-    widget->update_contents();
+    widget->profiled_update_contents();
   }
 }
 
@@ -24,6 +24,7 @@
 #include "t3widget/log.h"
 #include "t3widget/textbuffer.h"
 #include "t3widget/textbuffer_impl.h"
+#include "t3widget/trace.h"
 #include "t3widget/util.h"
 
 namespace t3widget {
@@ -96,13 +97,14 @@ void wrap_info_t::rewrap_line(text_pos_t line, text_pos_t pos, bool local) {
 }
 
 void wrap_info_t::rewrap_all() {
+  trace_scope_t trace("rewrap_all");
   for (size_t i = 0; i < wrap_data.size(); i++) {
     rewrap_line(i, 0, false);
   }
 }
 
 void wrap_info_t::set_wrap_width(int width) {
-  lprintf("Setting wrap width: %d\n", width);
+  llog(LOG_DEBUG, DRAW, "Setting wrap width: %d\n", width);
   if (width == wrap_width) {
     return;
   }
@@ -0,0 +1,320 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measure the latency between a key press and the moment the resulting screen update has been
+// written to the terminal, for a number of scripted editing sessions on a generated file. The
+// library is run on a headless terminal, so no terminal (emulator) is required. The results are
+// written as JSON, with a fixed ordering of keys such that results for different versions of the
+// library can be compared with diff. Use runbench.sh to build and run.
+
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "clipboard.h"
+#include "widget.h"
+
+using namespace t3widget;
+
+// Only allocations made by the thread running the benchmark are counted. The headless terminal
+// interprets the output in a separate thread, which should not be attributed to the library.
+static thread_local size_t allocations;
+
+void *operator new(size_t size) {
+  ++allocations;
+  void *result = std::malloc(size == 0 ? 1 : size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+static const int screen_height = 50;
+static const int screen_width = 160;
+
+/** Deterministic generator for source code like text. */
+class text_generator_t {
+ public:
+  explicit text_generator_t(uint32_t seed) : state_(seed) {}
+
+  std::string generate(int lines) {
+    static const char *const words[] = {"int",    "return", "if",      "else",   "while",
+                                        "value",  "result", "buffer",  "size",   "index",
+                                        "line",   "window", "text",    "offset", "count",
+                                        "update", "widget", "process", "key",    "draw"};
+    static const char *const separators[] = {" ", " ", " ", ", ", " = ", " + ", "(", ") ", "; "};
+    std::string result;
+
+    for (int i = 0; i < lines; ++i) {
+      int indent = next(6) * 2;
+      result.append(indent, ' ');
+      int length = next(14);
+      for (int j = 0; j < length; ++j) {
+        // Plant some search targets at predictable density.
+        result += next(97) == 0 ? "needle" : words[next(sizeof(words) / sizeof(words[0]))];
+        result += separators[next(sizeof(separators) / sizeof(separators[0]))];
+      }
+      if (next(11) == 0) {
+        // Long lines exercise the horizontal scrolling code.
+        result.append(300 + next(300), '=');
+      }
+      result += '\n';
+    }
+    return result;
+  }
+
+ private:
+  uint32_t next(uint32_t range) {
+    state_ = state_ * 1664525 + 1013904223;
+    return (state_ >> 8) % range;
+  }
+
+  uint32_t state_;
+};
+
+class main_t : public main_window_base_t {
+ public:
+  main_t() { edit_ = emplace_back<edit_window_t>(); }
+
+  bool set_size(optint height, optint width) override {
+    edit_->set_size(height, width);
+    return true;
+  }
+
+  edit_window_t *get_edit_window() { return edit_; }
+
+ private:
+  edit_window_t *edit_;
+};
+
+struct result_t {
+  std::string name;
+  std::vector<int64_t> latencies;
+  int64_t cpu_ns = 0;
+  size_t allocations = 0;
+  size_t output_bytes = 0;
+};
+
+static int64_t thread_cpu_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/** Function that performs a single event, and measures the time until the screen is updated. */
+typedef std::function<void(std::function<void()>)> event_fn_t;
+
+class benchmark_t {
+ public:
+  benchmark_t(headless_terminal_t *terminal, int lines) : terminal_(terminal), lines_(lines) {}
+
+  /** Run a session on a fresh copy of the generated text. The @p session function is called
+      with a function that performs and measures a single event. */
+  result_t run(main_t *main_window, const std::string &name,
+               const std::function<void(const event_fn_t &)> &session) {
+    result_t result;
+    result.name = name;
+
+    std::unique_ptr<text_buffer_t> text(new text_buffer_t());
+    text->append_text(text_generator_t(12345).generate(lines_));
+    main_window->get_edit_window()->set_text(text.get());
+    // The previous text is no longer referenced, and can be released.
+    text_ = std::move(text);
+    terminal_->resize(screen_height, screen_width);
+    iterate();
+    terminal_->update();
+    terminal_->clear_output();
+
+    session([&](std::function<void()> event) {
+      size_t allocations_before = allocations;
+      int64_t cpu_before = thread_cpu_ns();
+      auto start = std::chrono::steady_clock::now();
+
+      event();
+      iterate();
+      terminal_->update();
+
+      auto end = std::chrono::steady_clock::now();
+      result.cpu_ns += thread_cpu_ns() - cpu_before;
+      result.allocations += allocations - allocations_before;
+      result.latencies.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    });
+    result.output_bytes = terminal_->get_output_size();
+    return result;
+  }
+
+ private:
+  headless_terminal_t *terminal_;
+  int lines_;
+  std::unique_ptr<text_buffer_t> text_;
+};
+
+static int64_t percentile(std::vector<int64_t> values, int pct) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t idx = (values.size() * pct + 99) / 100;
+  return values[idx == 0 ? 0 : idx - 1];
+}
+
+static void write_json(FILE *out, int lines, const std::vector<result_t> &results) {
+  fprintf(out, "{\n");
+  fprintf(out, "  \"version\": %ld,\n", get_version());
+  fprintf(out, "  \"libt3window_version\": %ld,\n", get_libt3window_version());
+  fprintf(out, "  \"lines\": %d,\n", lines);
+  fprintf(out, "  \"screen\": [%d, %d],\n", screen_height, screen_width);
+  fprintf(out, "  \"sessions\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const result_t &r = results[i];
+    size_t events = std::max<size_t>(r.latencies.size(), 1);
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", r.name.c_str());
+    fprintf(out, "      \"events\": %zu,\n", r.latencies.size());
+    fprintf(out, "      \"latency_p50_us\": %.1f,\n", percentile(r.latencies, 50) / 1000.0);
+    fprintf(out, "      \"latency_p99_us\": %.1f,\n", percentile(r.latencies, 99) / 1000.0);
+    fprintf(out, "      \"latency_max_us\": %.1f,\n", percentile(r.latencies, 100) / 1000.0);
+    fprintf(out, "      \"cpu_us_per_event\": %.1f,\n", r.cpu_ns / 1000.0 / events);
+    fprintf(out, "      \"allocations_per_event\": %.1f,\n",
+            static_cast<double>(r.allocations) / events);
+    fprintf(out, "      \"output_bytes_per_event\": %.1f\n",
+            static_cast<double>(r.output_bytes) / events);
+    fprintf(out, "    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  int lines = 100000;
+  const char *output_name = nullptr;
+  int c;
+
+  while ((c = getopt(argc, argv, "hl:o:")) != -1) {
+    switch (c) {
+      case 'h':
+        printf("Usage: latency_bench [<options>]\n");
+        printf("  -l <lines>  Number of lines in the generated file (default 100000)\n");
+        printf("  -o <file>   Write the JSON results to <file> instead of stdout\n");
+        exit(EXIT_SUCCESS);
+      case 'l':
+        lines = std::max(atoi(optarg), 100);
+        break;
+      case 'o':
+        output_name = optarg;
+        break;
+      default:
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  if (setlocale(LC_ALL, "C.UTF-8") == nullptr) {
+    setlocale(LC_ALL, "");
+  }
+
+  std::unique_ptr<headless_terminal_t> terminal =
+      headless_terminal_t::create(screen_height, screen_width);
+  if (terminal == nullptr) {
+    perror("Could not create headless terminal");
+    exit(EXIT_FAILURE);
+  }
+
+  complex_error_t error;
+  std::unique_ptr<init_parameters_t> params = init_parameters_t::create();
+  params->program_name = "latency_bench";
+  params->headless_terminal = terminal.get();
+  if (!(error = init(params.get())).get_success()) {
+    fprintf(stderr, "Error: %s\n", error.get_string().c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<result_t> results;
+  {
+    // The benchmark owns the text, which must outlive the main window.
+    benchmark_t benchmark(terminal.get(), lines);
+    main_t main_window;
+    main_window.show();
+    text_generator_t paste_generator(54321);
+
+    results.push_back(benchmark.run(&main_window, "typing", [&](const event_fn_t &event) {
+      std::string typed = text_generator_t(1).generate(40);
+      for (char ch : typed) {
+        event([&] { terminal->send_key(ch == '\n' ? static_cast<key_t>(EKEY_NL) : ch); });
+      }
+    }));
+    results.push_back(benchmark.run(&main_window, "scrolling", [&](const event_fn_t &event) {
+      for (int i = 0; i < 300; ++i) {
+        event([&] { terminal->send_key(EKEY_PGDN); });
+      }
+      for (int i = 0; i < 300; ++i) {
+        event([&] { terminal->send_key(EKEY_UP); });
+      }
+      for (int i = 0; i < 100; ++i) {
+        event([&] { terminal->send_key(EKEY_RIGHT | EKEY_CTRL); });
+      }
+    }));
+    results.push_back(benchmark.run(&main_window, "paste", [&](const event_fn_t &event) {
+      set_clipboard(std::unique_ptr<std::string>(new std::string(paste_generator.generate(200))));
+      for (int i = 0; i < 50; ++i) {
+        event([&] { terminal->send_key(EKEY_CTRL | 'v'); });
+      }
+      // Bracketed paste delivers the text as separate keys.
+      std::string pasted = paste_generator.generate(20);
+      event([&] { terminal->send_key(EKEY_PASTE_START); });
+      for (char ch : pasted) {
+        event([&] { terminal->send_key(ch == '\n' ? EKEY_NL : (EKEY_PROTECT | ch)); });
+      }
+      event([&] { terminal->send_key(EKEY_PASTE_END); });
+    }));
+    results.push_back(benchmark.run(&main_window, "search", [&](const event_fn_t &event) {
+      event([&] { terminal->send_key(EKEY_CTRL | 'f'); });
+      for (char ch : std::string("needle")) {
+        event([&] { terminal->send_key(ch); });
+      }
+      event([&] { terminal->send_key(EKEY_NL); });
+      for (int i = 0; i < 300; ++i) {
+        event([&] { terminal->send_key(EKEY_F3); });
+      }
+    }));
+    results.push_back(benchmark.run(&main_window, "resize", [&](const event_fn_t &event) {
+      for (int i = 0; i < 100; ++i) {
+        event([&] { terminal->resize(screen_height - (i % 10), screen_width - (i % 7) * 5); });
+      }
+    }));
+  }
+  cleanup();
+
+  FILE *out = stdout;
+  if (output_name != nullptr && (out = fopen(output_name, "w")) == nullptr) {
+    perror("Could not open output file");
+    exit(EXIT_FAILURE);
+  }
+  write_json(out, lines, results);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return EXIT_SUCCESS;
+}
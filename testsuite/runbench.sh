@@ -0,0 +1,23 @@
+#!/bin/bash
+
+DIR="`dirname \"$0\"`"
+. "$DIR"/_common.sh
+
+
+if [ $# -gt 1 ] ; then
+	fail "Usage: runbench.sh [<output file>]"
+fi
+
+if [ $# -eq 1 ] ; then
+	setup_TEST "$1"
+	OUTPUT="$TEST"
+fi
+
+setup_vars "$DIR"
+cd_workdir
+
+g++ -O2 -g -Wall -pthread -I../../src -I../../../t3shared/include ../latency_bench.cc \
+	-L../../src/.libs/ -lt3widget -L../../../t3window/src/.libs -lt3window -o latency_bench \
+	-Wl,-rpath=$PWD/../../src/.libs:$PWD/../../../t3window/src/.libs:$PWD/../../../t3key/src/.libs:$PWD/../../../t3config/src/.libs:$PWD/../../../transcript/src/.libs || fail "!! Could not compile benchmark"
+
+./latency_bench ${OUTPUT:+-o "$OUTPUT"} || fail "!! Benchmark failed"
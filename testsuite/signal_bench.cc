@@ -0,0 +1,71 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measure the cost of activating a signal_t with 0, 1 and 8 connected callbacks, and check that
+// activation does not allocate memory. The signal implementation is header only, so this only
+// needs the include path of the library headers (i.e. -I.. when the headers are in ../t3widget).
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <t3widget/signals.h>
+
+static size_t allocations;
+
+void *operator new(size_t size) {
+  ++allocations;
+  void *result = std::malloc(size == 0 ? 1 : size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+enum rewrap_type_t { REWRAP_ALL, REWRAP_LINE };
+
+static const int iterations = 10000000;
+
+static void run(int slots) {
+  t3widget::signal_t<rewrap_type_t, int64_t, int64_t> signal;
+  volatile int64_t sum = 0;
+  for (int i = 0; i < slots; ++i) {
+    signal.connect([&sum](rewrap_type_t type, int64_t line, int64_t pos) {
+      sum = sum + type + line + pos;
+    });
+  }
+
+  size_t allocations_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    signal(REWRAP_LINE, i, 0);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+  std::cout << slots << " slots: " << ns << " ns/emit, " << allocations - allocations_before
+            << " allocations\n";
+}
+
+int main(int, char **) {
+  run(0);
+  run(1);
+  run(8);
+  return 0;
+}
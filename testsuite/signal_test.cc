@@ -0,0 +1,120 @@
+/* Copyright (C) 2018 G.P. Halkes
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that signal_t destroys every stored callback exactly once, also when the callbacks are
+// moved because the array of callbacks grows or disconnected callbacks are removed. Both callbacks
+// stored inline and callbacks stored on the heap are tested. Best run with -fsanitize=address.
+// The signal implementation is header only, so this only needs the include path of the library
+// headers (i.e. -I.. when the headers are in ../t3widget).
+
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <t3widget/signals.h>
+
+static int live_objects;
+static int failures;
+
+/* Object captured by the callbacks, which keeps track of the number of live copies. The padding
+   determines whether the callbacks are stored inline or on the heap. */
+template <size_t padding>
+class tracker_t {
+ public:
+  tracker_t(int *_calls) : calls(_calls), alive(true) { ++live_objects; }
+  tracker_t(const tracker_t &other) : calls(other.calls), alive(true) {
+    check_alive(other);
+    ++live_objects;
+  }
+  tracker_t(tracker_t &&other) noexcept : calls(other.calls), alive(true) {
+    check_alive(other);
+    ++live_objects;
+  }
+  ~tracker_t() {
+    check_alive(*this);
+    alive = false;
+    --live_objects;
+  }
+  void call() const {
+    check_alive(*this);
+    ++*calls;
+  }
+
+ private:
+  static void check_alive(const tracker_t &tracker) {
+    if (!tracker.alive) {
+      std::cout << "Use of destroyed callback with padding " << padding << "\n";
+      ++failures;
+    }
+  }
+
+  int *calls;
+  bool alive;
+  char pad[padding];
+};
+
+static void check(int value, int expected, const char *what) {
+  if (value != expected) {
+    std::cout << what << ": " << value << " instead of " << expected << "\n";
+    ++failures;
+  }
+}
+
+template <size_t padding>
+static void run(bool wrap_in_function) {
+  static const int slots = 20;
+  std::vector<int> calls(slots, 0);
+  {
+    t3widget::signal_t<int> signal;
+    std::vector<t3widget::connection_t> connections;
+    for (int i = 0; i < slots; ++i) {
+      tracker_t<padding> tracker(&calls[i]);
+      if (wrap_in_function) {
+        std::function<void(int)> func = [tracker](int) { tracker.call(); };
+        connections.push_back(signal.connect(func));
+      } else {
+        connections.push_back(signal.connect([tracker](int) { tracker.call(); }));
+      }
+    }
+    signal(0);
+
+    // Connecting another callback removes the disconnected callbacks, moving the others.
+    for (int i = 0; i < slots; i += 3) {
+      connections[i].disconnect();
+    }
+    signal.connect([](int) {});
+    signal(1);
+
+    for (int i = 0; i < slots; ++i) {
+      check(calls[i], i % 3 == 0 ? 1 : 2, "Number of calls");
+    }
+  }
+  check(live_objects, 0, "Number of callbacks left after destroying the signal");
+  live_objects = 0;
+}
+
+int main(int, char **) {
+  run<1>(false);
+  run<1>(true);
+  run<128>(false);
+  run<128>(true);
+  if (failures != 0) {
+    std::cout << failures << " failures\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "All tests passed\n";
+  return EXIT_SUCCESS;
+}